@@ -236,14 +236,8 @@ void rank(int iteration) {
   on_all_cores([bl]{
     bucketlist = bl; // init bucketlist on all cores
     
-    // all nodes get total counts put into their counts array
-    allreduce_inplace<size_t,collective_add>(&counts[0], counts.size());
-    
-    // everyone computes prefix sum over buckets locally
-    bucket_ranks[0] = 0;
-    for (size_t i=1; i<nbuckets; i++) {
-      bucket_ranks[i] = bucket_ranks[i-1] + counts[i-1];
-    }
+    // all nodes get total counts put into their counts array, and the rank each bucket starts at
+    bucket_offsets<size_t>(&counts[0], nullptr, nbuckets, &counts[0], &bucket_ranks[0]);
     
     // Gonna try trusting Grappa's cyclic distribution to work on the Gaussian distribution...
     //
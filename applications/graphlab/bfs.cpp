@@ -54,7 +54,8 @@ template< typename G >
 inline VertexID choose_root(GlobalAddress<G> g) {
   VertexID root;
   do {
-    root = random() % g->nv;
+    // drawn from the original ids, so a partitioned graph gets the same roots
+    root = g->renamed(random() % g->nv_orig);
   } while (call(g->vs+root,[](typename G::Vertex& v){ return v.nadj; }) == 0);
   return root;
 }
@@ -101,7 +102,7 @@ int main(int argc, char* argv[]) {
     
     t = walltime();
     
-    auto g = G::create(tg); // undirected
+    auto g = G::partition_by_flag(G::create(tg)); // undirected
         
     tg.destroy();
     
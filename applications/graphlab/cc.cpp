@@ -96,6 +96,13 @@ struct LabelPropagation : public GraphlabVertexProgram<G,MinLabel> {
 
 Reducer<int64_t,ReducerType::Add> nc;
 
+/// Number of components: vertices that are their own component's label.
+int64_t count_components(GlobalAddress<G> g) {
+  nc = 0;
+  forall(g, [](VertexID i, G::Vertex& v){ if (static_cast<VertexID>(v->label) == i) nc++; });
+  return nc;
+}
+
 int main(int argc, char* argv[]) {
   init(&argc, &argv);
   run([]{
@@ -117,7 +124,7 @@ int main(int argc, char* argv[]) {
     LOG(INFO) << "constructing graph";
     t = walltime();
     
-    auto g = G::Undirected(tg);
+    auto g = G::partition_by_flag(G::Undirected(tg));
     
     construction_time = walltime()-t;
     LOG(INFO) << construction_time;
@@ -144,9 +151,33 @@ int main(int argc, char* argv[]) {
       });
     }
     
-    nc = 0;
-    forall(g, [](VertexID i, G::Vertex& v){ if (v->label == i) nc++; });
-    LOG(INFO) << "ncomponents: " << nc;
+    LOG(INFO) << "ncomponents: " << count_components(g);
+    
+    if (FLAGS_update_batches > 0) {
+      // insertions only merge components, so propagating from the new
+      // edges' endpoints (keeping the old labels) is enough
+      forall(g->vs, g->nv, [](int64_t i, G::Vertex& v){ if (!v.valid) v->label = i; });
+      for (int b = 0; b < FLAGS_update_batches; b++) {
+        auto batch = random_edge_batch(g->nv_orig, FLAGS_update_edges, 12345 + b);
+        g->relabel_edges(batch);
+        g->insert_edges(batch);
+        batch.destroy();
+        GRAPPA_TIME_REGION(incremental_time) {
+          activate_updated(g);
+          NaiveGraphlabEngine<G,LabelPropagation>::run_sync(g);
+        }
+      }
+      int64_t incremental = count_components(g);
+      
+      forall(g, [](VertexID i, G::Vertex& v){
+        v->label = i;
+        v->activate();
+      });
+      NaiveGraphlabEngine<G,LabelPropagation>::run_sync(g);
+      CHECK_EQ(incremental, count_components(g)) << "incremental result differs from recomputing";
+      LOG(INFO) << "ncomponents after " << FLAGS_update_batches << " batches: " << incremental;
+      LOG(INFO) << incremental_time;
+    }
     
     if (FLAGS_metrics) Metrics::merge_and_print();
     else { std::cerr << total_time << "\n" << iteration_time << "\n"; }
@@ -9,6 +9,9 @@
 #include "graphlab.hpp"
 
 GRAPPA_DEFINE_METRIC(SummarizingMetric<double>, iteration_time, 0);
+GRAPPA_DEFINE_METRIC(SummarizingMetric<double>, incremental_time, 0);
 GRAPPA_DEFINE_METRIC(SummarizingMetric<int>, core_set_size, 0);
 
 DEFINE_int32(max_iterations, 1024, "Stop after this many iterations, no matter what.");
+DEFINE_int32(update_batches, 0, "After the trials, insert this many batches of random edges, updating the result incrementally after each.");
+DEFINE_int64(update_edges, 1024, "Number of edges in each update batch.");
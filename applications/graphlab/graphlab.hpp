@@ -51,8 +51,11 @@ using delegate::call;
 static const Core INVALID = -1;
 
 GRAPPA_DECLARE_METRIC(SummarizingMetric<double>, iteration_time);
+GRAPPA_DECLARE_METRIC(SummarizingMetric<double>, incremental_time);
 
 DECLARE_int32(max_iterations);
+DECLARE_int32(update_batches);
+DECLARE_int64(update_edges);
 
 
 /////////////////////////////////////////////////////////
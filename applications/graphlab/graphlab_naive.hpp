@@ -58,6 +58,22 @@ void activate_all(GlobalAddress<Graph<V,E>> g) {
   forall(g, [](typename Graph<V,E>::Vertex& v){ v->activate(); });
 }
 
+/// Activate the endpoints of edges inserted or deleted since the last
+/// time (for NaiveGraphlabEngine), so that run_sync() picks up from the
+/// previous result rather than starting over.
+template< typename V, typename E >
+void activate_updated(GlobalAddress<Graph<V,E>> g) {
+  g->forall_updated([](typename Graph<V,E>::Vertex& v){ v->activate(); });
+  g->clear_updated();
+}
+
+/// Random edges between the first 2^floor(log2(nv)) vertices, for
+/// Graph::insert_edges.
+inline TupleGraph random_edge_batch(int64_t nv, int64_t nedge, uint64_t seed) {
+  int scale = 63 - __builtin_clzll(nv);
+  return TupleGraph::Kronecker(scale, nedge, seed, seed ^ 0x5bd1e995);
+}
+
 /// Activate a single vertex (for NaiveGraphlabEngine)
 template< typename V >
 void activate(GlobalAddress<V> v) {
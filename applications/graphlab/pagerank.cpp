@@ -104,7 +104,7 @@ int main(int argc, char* argv[]) {
     LOG(INFO) << "constructing graph";
     t = walltime();
     
-    auto g = G::create(tg, true);
+    auto g = G::partition_by_flag(G::create(tg, true));
     
     GRAPPA_TIME_REGION(init_time) {
       // TODO: random init
@@ -146,6 +146,32 @@ int main(int argc, char* argv[]) {
     }
     Metrics::stop_tracing();
     
+    // insert batches of edges, updating ranks from the previous ones: the
+    // endpoints are re-applied, and so are the sources' other neighbors,
+    // which gather a different share now that the out-degree changed
+    for (int b = 0; b < FLAGS_update_batches; b++) {
+      auto batch = random_edge_batch(g->nv_orig, FLAGS_update_edges, 12345 + b);
+      g->relabel_edges(batch);
+      g->insert_edges(batch, true);
+      batch.destroy();
+      GRAPPA_TIME_REGION(incremental_time) {
+        g->forall_updated([g](G::Vertex& v){
+          v->activate();
+          forall<async>(adj(g,v), [](G::Edge& e){
+            call<async>(e.ga, [](G::Vertex& u){ u->activate(); });
+          });
+        });
+        g->clear_updated();
+        NaiveGraphlabEngine<G,PagerankVertexProgram>::run_sync(g);
+      }
+    }
+    if (FLAGS_update_batches > 0) {
+      total_rank = 0;
+      forall(g, [](G::Vertex& v){ total_rank += v->rank; });
+      std::cerr << "total_rank after " << FLAGS_update_batches << " batches: " << total_rank << "\n";
+      std::cerr << incremental_time << "\n";
+    }
+    
     LOG(INFO) << "-- pagerank done";
     
     
@@ -130,6 +130,33 @@ BOOST_AUTO_TEST_CASE( test1 ) {
     BOOST_CHECK_EQUAL( expected.get(0), (*results.data.localize()).get(0) );
     BOOST_CHECK_EQUAL( expected.get(1), (*results.data.localize()).get(1) );
 
+    // text edges: the chunked scanner and the old istream reader agree; time both
+    std::string fn = "read_edges.tsv";
+    const int64_t n = 1 << 16;
+    {
+      std::ofstream out( fn );
+      for( int64_t i = 0; i < n; i++ ) out << i << "\t" << (i * 7919) % n << "\n";
+    }
+    double mb = static_cast<double>( fs::file_size( fn ) ) / (1L<<20);
+    
+    auto tuples = Grappa::global_alloc<Tuple>( n );
+    for( bool fast : { true, false } ) {
+      Grappa::call_on_all_cores([fast]{ FLAGS_tsv_fast_parse = fast; });
+      Grappa::memset( tuples, Tuple(), n );
+      double t = Grappa::walltime();
+      readEdges( fn, tuples, n );
+      t = Grappa::walltime() - t;
+      LOG(INFO) << "readEdges (" << (fast ? "scanner" : "istream") << "): "
+                << mb / t << " MB/s, " << n / t << " tuples/s";
+      
+      Grappa::forall( tuples, n, [n]( int64_t i, Tuple& e ) {
+        CHECK_EQ( e.columns[0], i );
+        CHECK_EQ( e.columns[1], (i * 7919) % n );
+      });
+    }
+    Grappa::call_on_all_cores([]{ FLAGS_tsv_fast_parse = true; });
+    Grappa::global_free( tuples );
+    unlink( fn.c_str() );
   });
   Grappa::finalize();
 }
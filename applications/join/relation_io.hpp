@@ -13,6 +13,7 @@ namespace fs = boost::filesystem;
 #include <Grappa.hpp>
 #include <Cache.hpp>
 #include <ParallelLoop.hpp>
+#include <TextParse.hpp>
 #include "Tuple.hpp"
 #include "relation.hpp"
 
@@ -20,6 +21,7 @@ namespace fs = boost::filesystem;
 
 DECLARE_string(relations);
 DECLARE_bool(bin);
+DECLARE_bool(tsv_fast_parse);
 
 
 std::vector<std::string> &split(const std::string &s, char delim, std::vector<std::string> &elems) {
@@ -37,36 +39,70 @@ std::vector<std::string> split(const std::string &s, char delim) {
   return split(s, delim, elems);
 }
 
+/// Parse the first `numTuples` lines of `fn` (two integers each) into
+/// consecutive elements `make(src, dst)` of `out`. Each core scans its own
+/// byte range of the file and writes its records out in bulk. With
+/// `--tsv_fast_parse=false`, the calling core instead reads the lines one
+/// at a time with istreams (the old reader, kept for comparison).
+template <typename T, typename F>
+void readIntPairs( std::string fn, GlobalAddress<T> out, int64_t numTuples, F make ) {
+  CHECK( fs::exists( fn ) ) << fn << " not found";
+  
+  if( !FLAGS_tsv_fast_parse ) {
+    std::ifstream in( fn );
+    CHECK( in.is_open() ) << "couldn't open " << fn;
+    std::string line;
+    for( int64_t i = 0; i < numTuples; i++ ) {
+      CHECK( std::getline( in, line ) ) << fn << " has only " << i << " tuples";
+      std::istringstream ss( line );
+      int64_t src, dst;
+      ss >> src >> dst;
+      Grappa::delegate::write<async>( out + i, make( src, dst ) );
+    }
+    Grappa::impl::local_gce.wait();
+    return;
+  }
+  
+  char fname[1024];
+  CHECK_LT( fn.size(), sizeof(fname) );
+  strncpy( fname, fn.c_str(), sizeof(fname) );
+
+  Grappa::on_all_cores([fname,out,numTuples,make] {
+    std::vector<T> local;
+    Grappa::parse_int_lines_local<2>( fname, [&local,make](const int64_t * v, int n) {
+      if (n == 2) local.push_back( make(v[0], v[1]) );
+    });
+
+    // keep file order: this core's records follow those of earlier cores
+    int64_t nlocal = local.size();
+    int64_t offset = Grappa::exclusive_scan<int64_t,collective_add>(nlocal);
+    int64_t total = Grappa::allreduce<int64_t,collective_add>(nlocal);
+    CHECK_GE( total, numTuples ) << fname << " has only " << total << " tuples";
+
+    int64_t n = std::max<int64_t>(0, std::min(nlocal, numTuples - offset));
+    if (n > 0) {
+      // (released straight from this buffer, so it must be in the locale heap)
+      T * buf = Grappa::locale_alloc<T>(n);
+      std::copy( local.begin(), local.begin() + n, buf );
+      {
+        typename Incoherent<T>::WO lr(out + offset, n, buf);
+      }
+      Grappa::locale_free(buf);
+    }
+  });
+}
+
 /// Read tuples of format
 /// src dst
 /// 
 /// create as array of Tuple
 void readEdges( std::string fn, GlobalAddress<Tuple> tuples, uint64_t numTuples ) {
-  std::ifstream testfile(fn);
-  CHECK( testfile.is_open() );
-
-  // shared by the local tasks reading the file
-  int fin = 0;
-
-  // synchronous IO with asynchronous write
-  Grappa::forall_here<1>(0, numTuples, [tuples,numTuples,&fin,&testfile](int64_t s, int64_t n) {
-    std::string line;
-    for (int ignore=s; ignore<s+n; ignore++) {
-      CHECK( testfile.good() );
-      std::getline( testfile, line );
-
-      int myindex = fin++;
-      Incoherent<Tuple>::WO lr(tuples+myindex, 1);
-
-      std::vector<std::string> tokens = split( line, '\t' );
-      VLOG(5) << tokens[0] << "->" << tokens[1];
-      (*lr).columns[0] = std::stoi(tokens[0]);
-      (*lr).columns[1] = std::stoi(tokens[1]);
-    }
+  readIntPairs( fn, tuples, numTuples, [](int64_t src, int64_t dst) {
+    Tuple t;
+    t.columns[0] = src;
+    t.columns[1] = dst;
+    return t;
   });
-
-  CHECK( fin == numTuples );
-  testfile.close();
 }
 
 
@@ -75,51 +111,14 @@ void readEdges( std::string fn, GlobalAddress<Tuple> tuples, uint64_t numTuples
 /// 
 /// create as tuple_graph
 tuple_graph readEdges( std::string fn, int64_t numTuples ) {
-  std::ifstream testfile(fn, std::ifstream::in);
-  CHECK( testfile.is_open() );
-
-  // shared by the local tasks reading the file
-  int64_t fin = 0;
-
   auto edges = Grappa::global_alloc<packed_edge>(numTuples);
- 
-  // token delimiter  
-//  std::regex rgx("\\s+");
-
-  // synchronous IO with asynchronous write
-  Grappa::forall_here<&Grappa::impl::local_gce, 1>(0, numTuples, [edges,numTuples,&fin,&testfile](int64_t s, int64_t n) {
-    std::string line;
-    for (int ignore=s; ignore<s+n; ignore++) {
-      CHECK( testfile.good() );
-      std::getline( testfile, line );
-
-      // parse and create the edge
-      // c++11 but NOT SUPPORTED/broken in gcc4.7.2
-//      std::regex_token_iterator<std::string::iterator> iter(line.begin(), line.end(),
-//                                     rgx, -1); // -1 = matches as splitters
-//      auto src = std::stoi(*iter); iter++;
-//      auto dst = std::stoi(*iter);
-      std::stringstream ss(line);
-      std::string buf;
-      ss >> buf; 
-      auto src = std::stoi(buf);
-      ss >> buf;
-      auto dst = std::stoi(buf);
-      
-      VLOG(5) << src << "->" << dst;
-      packed_edge pe;
-      write_edge(&pe, src, dst);
-
-      // write edge to location
-      int myindex = fin++;
-      Grappa::delegate::write<async>(edges+myindex, pe);
-    }
+  readIntPairs( fn, edges, numTuples, [](int64_t src, int64_t dst) {
+    VLOG(5) << src << "->" << dst;
+    packed_edge pe;
+    write_edge(&pe, src, dst);
+    return pe;
   });
 
-
-  CHECK( fin == numTuples );
-  testfile.close();
-
   tuple_graph tg { edges, numTuples };
   return tg;
 }
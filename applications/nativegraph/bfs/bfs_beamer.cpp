@@ -35,7 +35,9 @@
 /// BFS (http://dl.acm.org/citation.cfm?id=2389013), uses GlobalBag to
 /// implement the frontier, and supports the '--max_degree_source' flag
 /// (useful for comparing against other BFS implementations with 
-/// potentially different random root selection).
+/// potentially different random root selection). With --graph_in_edges,
+/// bottom-up steps look for parents among in-neighbors, checking those on
+/// the same core without messages.
 ////////////////////////////////////////////////////////////////////////
 
 #include "common.hpp"
@@ -66,6 +68,33 @@ GlobalCompletionEvent phaser;
 
 Reducer<int64_t,ReducerType::Add> edge_count;
 
+/// (bottom-up) Make `parent` the parent of unvisited vertex `v`.
+void claim(G::Vertex& v, VertexID parent) {
+  next->add(g->id(v));
+  v->level = current_depth;
+  v->parent = parent;
+  edge_count += v.nadj;
+}
+
+/// (bottom-up) Check whether candidate parent `pa` of `va` is in the
+/// frontier, and if so claim it.
+void check_parent(GlobalAddress<G::Vertex> va, GlobalAddress<G::Vertex> pa) {
+  phaser.enroll();
+  send_heap_message(pa.core(), [=]{
+    auto& pv = *pa.pointer();
+    if (pv->level != -1 && pv->level < current_depth) {
+      auto pid = g->id(pv);
+      send_heap_message(va.core(), [=]{
+        auto& v = *va.pointer();
+        if (v->level == -1) claim(v, pid);
+        phaser.complete();
+      });
+    } else {
+      phaser.send_completion(va.core());
+    }
+  });
+}
+
 void bfs(GlobalAddress<G> _g, int nbfs, TupleGraph tg) {
   bool verified = false;
   double t;
@@ -152,31 +181,30 @@ void bfs(GlobalAddress<G> _g, int nbfs, TupleGraph tg) {
         
         forall<&phaser>(g, [](G::Vertex& v){
           if (v->level != -1) return;
-          auto va = make_linear(&v);
-          forall<async,&phaser>(adj(g,v), [=,&v](G::Edge& e){
-            if (v->level != -1) return;
-            
-            phaser.enroll();
-            auto eva = e.ga;
-            send_heap_message(eva.core(), [=]{
-              auto& ev = *eva.pointer();
-              if (ev->level != -1 && ev->level < current_depth) {
-                auto eid = g->id(ev);
-                send_heap_message(va.core(), [=]{
-                  auto& v = *va.pointer();
-                  if (v->level == -1) {
-                    next->add(g->id(v));
-                    v->level = current_depth;
-                    v->parent = eid;
-                    edge_count += v.nadj;
-                  }
-                  phaser.complete();
-                });
-              } else {
-                phaser.send_completion(va.core());
+          auto va = make_linear(&v, g->vs.distribution());
+          if (g->has_in_edges()) {
+            // candidates on this core are read in place (most of them, on a
+            // partitioned graph); only the rest cost a message each
+            auto in = g->local_in_adj(v);
+            for (int64_t k = 0; k < g->in_degree(v); k++) {
+              auto pa = g->vs+in[k];
+              if (pa.core() != mycore()) continue;
+              auto& pv = *pa.pointer();
+              if (pv->level != -1 && pv->level < current_depth) {
+                claim(v, in[k]);
+                return;
               }
+            }
+            forall<async,&phaser>(in_adj(g,v), [=,&v](G::InEdge& e){
+              if (v->level != -1 || e.ga.core() == mycore()) return;
+              check_parent(va, e.ga);
             });
-          });
+          } else {
+            forall<async,&phaser>(adj(g,v), [=,&v](G::Edge& e){
+              if (v->level != -1) return;
+              check_parent(va, e.ga);
+            });
+          }
         });
       }
       
@@ -28,7 +28,8 @@ template< typename V, typename E >
 inline int64_t choose_root(GlobalAddress<Graph<V,E>> g) {
   int64_t root;
   do {
-    root = random() % g->nv;
+    // drawn from the original ids, so a partitioned graph gets the same roots
+    root = g->renamed(random() % g->nv_orig);
   } while (delegate::call(g->vs+root,[](typename G::Vertex& v){ return v.nadj; }) == 0);
   return root;
 }
@@ -74,6 +74,10 @@ int main(int argc, char* argv[]) {
     construction_time = (walltime()-t);
     LOG(INFO) << construction_time;
     
+    // the verifier reads tg, so it follows any relabeling
+    g = G::partition_by_flag(g);
+    g->relabel_edges(tg);
+    
     bfs(g, FLAGS_nbfs, tg);
     
     LOG(INFO) << "\n" << bfs_nedge << "\n" << total_time << "\n" << bfs_mteps;
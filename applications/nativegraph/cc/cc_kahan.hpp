@@ -1,6 +1,7 @@
 #include <Grappa.hpp>
 #include <GlobalHashSet.hpp>
 #include <graph/Graph.hpp>
+#include <unordered_set>
 
 using namespace Grappa;
 namespace d = Grappa::delegate;
@@ -154,7 +155,7 @@ void explore(int64_t root_index, color_t mycolor, GlobalAddress<CompletionEvent>
   
   forall<async,nullptr>(adj(g,rv), [=](G::Edge& e){
     delegate::call<async,nullptr>(e.ga, [mycolor,ce](G::Vertex& v){
-      auto j = make_linear(&v) - g->vs;
+      auto j = g->id(v);
       
       if (v->color < 0) { // unclaimed
         v->color = mycolor;
@@ -186,7 +187,7 @@ void propagate(int64_t v, color_t mycolor) {
     CHECK(e.id < g->nv && e.id >= 0) << "-- j: " << e.id << ", vj: " << e.ga << "\nvs: " << g->vs;
     Core origin = mycore();
     call<async,nullptr>(e.ga, [=](G::Vertex& v){
-      auto j = make_linear(&v) - g->vs;
+      auto j = g->id(v);
       if (!v->visited) {
         v->visited = true;
         v->color = mycolor;
@@ -249,10 +250,8 @@ size_t connected_components(GlobalAddress<G> _g) {
     // VLOG(0) << "total set size: " << ct;
     // phaser.enroll(ct);
     on_all_cores([=]{
-      for (const Edge& e : local_set) {
-        // comp_set->insert_async(e, []{ phaser.send_completion(0); });
-        comp_set->insert(e);
-      }
+      std::vector<Edge> edges(local_set.begin(), local_set.end());
+      comp_set->insert_batch(edges.data(), edges.size());
     });
     // comp_set->sync_all_cores();
     // phaser.wait();
@@ -85,6 +85,8 @@ int main(int argc, char* argv[]) {
     construction_time = walltime()-t;
     LOG(INFO) << construction_time;
     
+    g = G::partition_by_flag(g);
+    
     GRAPPA_TIME_REGION(total_time) {
       ncomponents = connected_components(g);
     }
@@ -103,11 +103,15 @@ int main(int argc, char* argv[]) {
     auto g = G::Undirected( tg );
     graph_create_time = (walltime()-t);
     
+    // the verifier reads tg, so it follows any relabeling
+    g = G::partition_by_flag(g);
+    g->relabel_edges(tg);
+    
     LOG(INFO) << "graph generated (#nodes = " << g->nv << "), " << graph_create_time;
       
     t = walltime();
 
-    auto root = FLAGS_root;
+    auto root = g->renamed(FLAGS_root);
     do_sssp(g, root);
 
     double this_sssp_time = walltime() - t;
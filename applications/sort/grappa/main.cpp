@@ -173,16 +173,8 @@ void bucket_sort(GlobalAddress<uint64_t> array, size_t nelems, size_t nbuckets)
   // { aggregate_counts f; fork_join_custom(&f); }
   on_all_cores([nbuckets]{
     CHECK_EQ(nbuckets, counts.size());
-    // all nodes get total counts put into their counts array
-    allreduce_inplace<size_t,collective_add>(&counts[0], counts.size());
-
-    VLOG(1) << "after allreduce_inplace (just in case)";
-
-    // everyone computes prefix sum over buckets locally
-    offsets[0] = 0;
-    for (size_t i=1; i<offsets.size(); i++) {
-      offsets[i] = offsets[i-1] + counts[i-1];
-    }
+    // all nodes get total counts put into their counts array, and where each bucket starts
+    bucket_offsets<size_t>(&counts[0], nullptr, nbuckets, &counts[0], &offsets[0]);
   });
   
   allreduce_time = Grappa::walltime() - t;
@@ -33,7 +33,8 @@
 ///
 /// 2D addresses are a PGAS-style tuple of ( core, address on core )
 ///
-/// Linear addresses are block cyclic across all the cores in the system.
+/// Linear addresses are block cyclic across all the cores in the system
+/// by default; see Distribution for the other layouts.
 ///
 /// TODO: update "core" to mean "core" in all the right places.  
 ///
@@ -42,6 +43,7 @@
 /// bits store core id and address on core encoded in a way that makes
 /// incrementing by blocks work.
 
+#include <algorithm>
 #include "Communicator.hpp"
 
 typedef int Pool;
@@ -51,6 +53,8 @@ typedef int Pool;
 namespace Grappa {
 namespace impl {
 extern void * global_memory_chunk_base;
+/// global heap chunk base of each core in this locale, by locale core index
+extern void ** locale_global_memory_chunk_bases;
 }
 }
 
@@ -83,6 +87,145 @@ static const intptr_t core_mask = (1L << core_bits) - 1;
 static const intptr_t pool_mask = (1L << pool_bits) - 1;
 static const intptr_t pointer_mask = (1L << pointer_bits) - 1;
 
+/// Linear addresses reuse the (otherwise unused) core bits to record
+/// how their allocation is distributed. A value of 0 means the default
+/// cyclic distribution with BLOCK_SIZE blocks.
+static const int dist_bits = 64 - pointer_bits - tag_bits;
+static const int dist_shift_val = pointer_bits;
+static const intptr_t dist_mask = (1L << dist_bits) - 1;
+
+/// @addtogroup Memory
+/// @{
+
+/// Distribution policy for a linear global allocation.
+///
+/// Linear addresses are laid out in blocks, which are dealt out to
+/// cores in rounds of `cores()` blocks. Within a core, blocks from
+/// successive rounds are contiguous, so `localize()` still works.
+///   - Cyclic: blocks of a chosen size are assigned round-robin
+///     (the default uses BLOCK_SIZE bytes).
+///   - Block: one contiguous chunk per core (a cyclic distribution
+///     whose block is ~1/cores() of the allocation).
+///   - Hashed: like Cyclic, but the core order within each round is
+///     rotated by a hash of the round, breaking up strided hot-spots.
+///
+/// The policy is encoded in 15 bits of each linear address: 2 bits of
+/// policy, and the block size as an 8-bit mantissa and 5-bit exponent.
+/// Not every block size is representable; use `round_up()` to find the
+/// next one that is.
+///
+/// @code
+///   auto a = global_alloc<double>(N, Distribution::block());
+///   auto b = global_alloc<Big>(N, Distribution::cyclic(4*sizeof(Big)));
+/// @endcode
+class Distribution {
+public:
+  enum class Policy { Default = 0, Cyclic = 1, Block = 2, Hashed = 3 };
+
+private:
+  static const int mantissa_bits = 8;
+  static const int exponent_bits = 5;
+  static const int policy_shift = mantissa_bits + exponent_bits;
+  static const intptr_t mantissa_mask = (1L << mantissa_bits) - 1;
+  static const intptr_t exponent_mask = (1L << exponent_bits) - 1;
+
+  Policy policy_;
+  size_t block_bytes_; // 0 for Block until it is sized for an allocation
+
+  Distribution( Policy p, size_t bytes ): policy_(p), block_bytes_(bytes) {}
+
+  /// encode block size as (mantissa, exponent); returns -1 if not representable
+  static intptr_t encode_size( size_t bytes ) {
+    if( bytes == 0 ) return -1;
+    intptr_t e = __builtin_ctzl( bytes );
+    intptr_t m = bytes >> e;
+    while( e > exponent_mask && m <= mantissa_mask ) { m <<= 1; e--; }
+    if( m > mantissa_mask || e > exponent_mask ) return -1;
+    return (m << exponent_bits) | e;
+  }
+
+public:
+  /// Default distribution: cyclic with BLOCK_SIZE-byte blocks.
+  Distribution(): policy_(Policy::Default), block_bytes_(BLOCK_SIZE) {}
+
+  /// Round-robin blocks of `block_bytes` across cores.
+  static Distribution cyclic( size_t block_bytes ) {
+    CHECK_GE( encode_size( block_bytes ), 0 ) << "block size " << block_bytes
+      << " not representable; try Distribution::round_up(" << block_bytes << ")";
+    return Distribution( Policy::Cyclic, block_bytes );
+  }
+
+  /// One contiguous chunk per core; sized when the allocation is made.
+  static Distribution block() { return Distribution( Policy::Block, 0 ); }
+
+  /// Blocks of `block_bytes` assigned to cores in hashed order.
+  static Distribution hashed( size_t block_bytes = BLOCK_SIZE ) {
+    CHECK_GE( encode_size( block_bytes ), 0 ) << "block size " << block_bytes
+      << " not representable; try Distribution::round_up(" << block_bytes << ")";
+    return Distribution( Policy::Hashed, block_bytes );
+  }
+
+  /// Smallest representable block size >= `bytes` that is a multiple of `elem_bytes`.
+  static size_t round_up( size_t bytes, size_t elem_bytes = 1 ) {
+    size_t elem_odd = elem_bytes >> __builtin_ctzl( elem_bytes );
+    size_t max_multiple = mantissa_mask / elem_odd;
+    CHECK_GT( max_multiple, 0 ) << "no representable block size for " << elem_bytes << "-byte elements";
+    size_t n = (bytes + elem_bytes - 1) / elem_bytes;
+    int shift = 0;
+    while( ((n + (1L << shift) - 1) >> shift) > max_multiple ) shift++;
+    return ((n + (1L << shift) - 1) >> shift << shift) * elem_bytes;
+  }
+
+  /// Decode distribution from the distribution bits of a linear address.
+  static Distribution from_bits( intptr_t bits ) {
+    if( bits == 0 ) return Distribution();
+    auto p = static_cast<Policy>( bits >> policy_shift );
+    size_t bytes = ((bits >> exponent_bits) & mantissa_mask) << (bits & exponent_mask);
+    return Distribution( p, bytes );
+  }
+
+  /// Distribution bits to store in a linear address.
+  intptr_t bits() const {
+    if( policy_ == Policy::Default ) return 0;
+    CHECK_GT( block_bytes_, 0 ) << "Distribution::block() must be sized before use";
+    return (static_cast<intptr_t>(policy_) << policy_shift) | encode_size( block_bytes_ );
+  }
+
+  /// Resolve this distribution for an allocation of `count` elements of
+  /// `elem_bytes` each (only changes Block distributions).
+  Distribution sized_for( size_t count, size_t elem_bytes ) const {
+    if( policy_ != Policy::Block ) return *this;
+    size_t ncores = global_communicator.cores;
+    size_t per_core = (count + ncores - 1) / ncores;
+    return Distribution( Policy::Block, round_up( std::max<size_t>(per_core,1) * elem_bytes, elem_bytes ) );
+  }
+
+  Policy policy() const { return policy_; }
+  size_t block_bytes() const { return block_bytes_; }
+  bool is_default() const { return policy_ == Policy::Default; }
+
+  /// Rotation applied to cores within a round of blocks.
+  static inline intptr_t round_rotation( Policy p, intptr_t round ) {
+    if( p != Policy::Hashed ) return 0;
+    uint64_t h = static_cast<uint64_t>( round ) * 0x9E3779B97F4A7C15UL;
+    return (h >> 32) % global_communicator.cores;
+  }
+
+  bool operator==( const Distribution& d ) const {
+    return policy_ == d.policy_ && block_bytes_ == d.block_bytes_;
+  }
+  bool operator!=( const Distribution& d ) const { return !(*this == d); }
+};
+
+/// output human-readable version of distribution
+inline std::ostream& operator<<( std::ostream& o, const Distribution& d ) {
+  static const char * names[] = { "default", "cyclic", "block", "hashed" };
+  return o << "<Distribution " << names[ static_cast<int>( d.policy() ) ]
+           << " " << d.block_bytes() << ">";
+}
+
+/// @}
+
 /// @addtogroup Memory
 /// @{
 
@@ -114,7 +257,9 @@ private:
                << " pointer " << static_cast<void *>( pointer() )
                << ">";
     } else {
-        return o << "<GA Linear " << (void*)storage_ 
+        o << "<GA Linear " << (void*)storage_;
+        if( dist_code() ) o << " " << distribution();
+        return o
 //                 << ": pool " << pool() 
                  << " core " << core()
                  << " pointer " << static_cast<void *>( pointer()  )
@@ -122,6 +267,16 @@ private:
     }
   }
 
+  /// distribution bits of a linear address (0 for the default distribution)
+  inline intptr_t dist_code() const {
+    return (storage_ >> dist_shift_val) & dist_mask;
+  }
+
+  /// byte offset of a linear address, without distribution bits
+  inline intptr_t linear_offset() const {
+    return storage_ & pointer_mask;
+  }
+
   // GlobalAddress( T * p, Core n = global_communicator.mycore )
   //   : storage_( ( 1L << tag_shift_val ) |
   //               ( ( n & core_mask) << core_shift_val ) |
@@ -175,6 +330,31 @@ public:
     return g;
   }
 
+  /// Construct a linear global address from a local pointer into an
+  /// allocation made with distribution `d`.
+  static GlobalAddress Linear( T * t, const Distribution& d )
+  {
+    if( d.is_default() ) return Linear( t );
+
+    intptr_t tt = reinterpret_cast< intptr_t >( t ) - 
+      reinterpret_cast< intptr_t >( Grappa::impl::global_memory_chunk_base );
+    intptr_t bs = d.block_bytes();
+    intptr_t round = tt / bs;
+    intptr_t offset = tt % bs;
+    intptr_t cores = global_communicator.cores;
+    intptr_t position = ( global_communicator.mycore + cores
+                          - Distribution::round_rotation( d.policy(), round ) ) % cores;
+
+    GlobalAddress g;
+    g.storage_ = ( ( d.bits() << dist_shift_val ) |
+                   ( ( round * cores + position ) * bs + offset ) );
+
+    DCHECK_EQ( g.core(), global_communicator.mycore ) << "converted linear address core doesn't match";
+    DCHECK_EQ( g.pointer(), t ) << "converted linear address local pointer doesn't match";
+
+    return g;
+  }
+
   /// Construct a global address from raw bits
   static GlobalAddress Raw( intptr_t t )
   {
@@ -192,13 +372,29 @@ public:
   inline Core core() const {
     if( is_2D() ) {
       return (storage_ >> core_shift_val) & core_mask;
-    } else {
+    } else if( dist_code() == 0 ) {
       intptr_t offset = storage_ % block_size;
       intptr_t core = (storage_ / block_size) % global_communicator.cores;
       intptr_t core_block = (storage_ / block_size) / global_communicator.cores;
       return core;
+    } else {
+      Distribution d = distribution();
+      intptr_t block = linear_offset() / d.block_bytes();
+      intptr_t core_block = block / global_communicator.cores;
+      intptr_t rotation = Distribution::round_rotation( d.policy(), core_block );
+      return (block + rotation) % global_communicator.cores;
     }
   }
+
+  /// Return the distribution of the allocation a linear address points into
+  inline Distribution distribution() const {
+    return is_2D() ? Distribution() : Distribution::from_bits( dist_code() );
+  }
+
+  /// Return the size of the block containing this address
+  inline intptr_t block_bytes() const {
+    return dist_code() == 0 || is_2D() ? block_size : distribution().block_bytes();
+  }
   
   /// Return the home core of a global address
   /// TODO: implement this.
@@ -212,7 +408,7 @@ public:
     if( is_2D() ) {
       intptr_t signextended = (storage_ << pointer_shift_val) >> pointer_shift_val;
       return reinterpret_cast< T * >( signextended ); 
-    } else {
+    } else if( dist_code() == 0 ) {
       intptr_t offset = storage_ % block_size;
       intptr_t block = (storage_ / block_size);
       intptr_t core = (storage_ / block_size) % global_communicator.cores;
@@ -220,9 +416,36 @@ public:
       intptr_t address = core_block * block_size + offset + 
         reinterpret_cast< intptr_t >( Grappa::impl::global_memory_chunk_base );
       return reinterpret_cast< T * >( address );
+    } else {
+      intptr_t bs = block_bytes();
+      intptr_t offset = linear_offset() % bs;
+      intptr_t core_block = (linear_offset() / bs) / global_communicator.cores;
+      intptr_t address = core_block * bs + offset + 
+        reinterpret_cast< intptr_t >( Grappa::impl::global_memory_chunk_base );
+      return reinterpret_cast< T * >( address );
     }
   }
 
+  /// Is the object at this address directly addressable from this
+  /// core? True for addresses on this core, and for linear addresses
+  /// owned by another core in this locale.
+  inline bool is_locale_shared() const {
+    return core() == global_communicator.mycore ||
+      ( is_linear() && global_communicator.locale_of( core() ) == global_communicator.mylocale );
+  }
+
+  /// Return a pointer to the object that is valid on this core. Only
+  /// meaningful when is_locale_shared() is true.
+  inline T * locale_pointer() const {
+    Core c = core();
+    if( c == global_communicator.mycore || is_2D() ) return pointer();
+    Core locale_index = c - ( global_communicator.mycore - global_communicator.locale_mycore );
+    intptr_t offset = reinterpret_cast< intptr_t >( pointer() ) -
+      reinterpret_cast< intptr_t >( Grappa::impl::global_memory_chunk_base );
+    return reinterpret_cast< T * >( offset +
+      reinterpret_cast< intptr_t >( Grappa::impl::locale_global_memory_chunk_bases[ locale_index ] ) );
+  }
+
   /// Find lowest local address of the object at this address.  Used
   /// for PGAS-style local iteration.
   inline T * localize(Core nid = -1) const {
@@ -230,11 +453,18 @@ public:
     
   	if (nid == -1) nid = global_communicator.mycore;
     T * local_base;
-    size_t block_elems = block_size / sizeof(T);
+    intptr_t bs = block_bytes();
     T * block_base = block_min().pointer();
-    if (nid < core()) {
-      local_base = block_base+block_elems;
-    } else if (nid > core()) {
+    // compare positions within this round of blocks (same as cores
+    // unless the distribution rotates rounds)
+    intptr_t cores = global_communicator.cores;
+    intptr_t rotation = Distribution::round_rotation( distribution().policy(),
+                                                      (linear_offset() / bs) / cores );
+    intptr_t nid_position = (nid + cores - rotation) % cores;
+    intptr_t my_position = (core() + cores - rotation) % cores;
+    if (nid_position < my_position) {
+      local_base = block_base + bs / sizeof(T);
+    } else if (nid_position > my_position) {
       local_base = block_base;
     } else {
       local_base = pointer();
@@ -258,12 +488,15 @@ public:
       //intptr_t signextended = (storage_ << pointer_shift_val) >> pointer_shift_val;
       //GlobalAddress< U > u = GlobalAddress< U >::Raw( storage_ );
       return GlobalAddress< T >::TwoDimensional( (T*) 0, core() );
-    } else {
+    } else if( dist_code() == 0 ) {
       intptr_t first_byte = storage_;
       intptr_t first_byte_offset = first_byte % block_size;
       intptr_t core = (first_byte / block_size) %   global_communicator.cores;
       intptr_t core_block = (first_byte / block_size) / global_communicator.cores;
       return GlobalAddress< T >::Raw( this->raw_bits() - first_byte_offset );
+    } else {
+      intptr_t first_byte_offset = linear_offset() % block_bytes();
+      return GlobalAddress< T >::Raw( this->raw_bits() - first_byte_offset );
     }
   }
 
@@ -283,7 +516,7 @@ public:
       intptr_t signextended = (storage_ << pointer_shift_val) >> pointer_shift_val;
       //return reinterpret_cast< T * >( -1 ); 
       return GlobalAddress< T >::TwoDimensional( (T*) 1, core() );
-    } else {
+    } else if( dist_code() == 0 ) {
       intptr_t first_byte = storage_;
       intptr_t first_byte_offset = first_byte % block_size;
       intptr_t last_byte = first_byte + sizeof(T) - 1;
@@ -291,6 +524,10 @@ public:
       intptr_t core = (last_byte / block_size) % global_communicator.cores;
       intptr_t core_block = (last_byte / block_size) / global_communicator.cores;
       return GlobalAddress< T >::Raw( this->raw_bits() + sizeof(T) + block_size - (last_byte_offset + 1) );
+    } else {
+      intptr_t bs = block_bytes();
+      intptr_t last_byte_offset = (linear_offset() + sizeof(T) - 1) % bs;
+      return GlobalAddress< T >::Raw( this->raw_bits() + sizeof(T) + bs - (last_byte_offset + 1) );
     }
   }
 
@@ -433,6 +670,13 @@ GlobalAddress< T > make_linear( T * t ) {
   return GlobalAddress< T >::Linear( t );
 }
 
+/// takes a local pointer into an allocation with the given
+/// distribution, and makes a linear global pointer pointing to that byte.
+template< typename T >
+GlobalAddress< T > make_linear( T * t, const Distribution& d ) {
+  return GlobalAddress< T >::Linear( t, d );
+}
+
 /// output human-readable version of global address
 template< typename T >
 std::ostream& operator<<( std::ostream& o, const GlobalAddress< T >& ga ) {
@@ -27,6 +27,7 @@
 
 #include "Grappa.hpp"
 #include "Addressing.hpp"
+#include "Cache.hpp"
 
 
 BOOST_AUTO_TEST_SUITE( Addressing_tests );
@@ -63,6 +64,48 @@ struct BrandonM64 {
 };
 
 
+struct Small {
+  int64_t index;
+  int64_t pad[3];
+};
+
+struct Big {
+  int64_t index;
+  int64_t pad[11];
+};
+
+/// check that every element of an allocation with distribution `d`
+/// lives where its address says, and is visited once by forall
+template< typename T >
+void check_distribution( Distribution d, size_t n ) {
+  BOOST_MESSAGE( "checking " << d << " with " << n << " elements of " << sizeof(T) << " bytes" );
+  auto xs = Grappa::global_alloc<T>( n, d );
+  BOOST_CHECK( xs.distribution().policy() == d.policy() );
+
+  Grappa::forall( xs, n, [xs]( int64_t i, T& x ) {
+    x.index = i;
+    auto a = make_linear( &x, xs.distribution() );
+    CHECK_EQ( a - xs, i );
+    CHECK_EQ( a.core(), Grappa::mycore() );
+  });
+
+  for( size_t i = 0; i < n; i++ ) {
+    auto a = xs + i;
+    auto idx = Grappa::delegate::call( a.core(), [a]{ return a.pointer()->index; } );
+    BOOST_CHECK_EQUAL( idx, i );
+  }
+
+  // read across block boundaries through the cache
+  size_t m = std::min<size_t>( n, 3 * xs.block_bytes() / sizeof(T) + 1 );
+  std::vector<T> buf( m );
+  typename Incoherent<T>::RO c( xs, m, &buf[0] );
+  for( size_t i = 0; i < m; i++ ) {
+    BOOST_CHECK_EQUAL( c[i].index, i );
+  }
+
+  Grappa::global_free( xs );
+}
+
 BOOST_AUTO_TEST_CASE( test1 ) {
   Grappa::init( GRAPPA_TEST_ARGS );
   Grappa::run([]{
@@ -340,6 +383,18 @@ BOOST_AUTO_TEST_CASE( test1 ) {
         BOOST_CHECK_EQUAL( brandonm2_byte_diff, 128 );
         BOOST_CHECK_EQUAL( brandonm2_block_diff, 2 );
       }
+
+      // representable block sizes
+      BOOST_CHECK_EQUAL( Distribution::round_up( 96 ), 96 );
+      BOOST_CHECK_EQUAL( Distribution::round_up( 1000, 24 ), 1008 );
+      BOOST_CHECK_EQUAL( Distribution::round_up( 100000, 24 ) % 24, 0 );
+      
+      check_distribution< Small >( Distribution(), 1000 );
+      check_distribution< Small >( Distribution::cyclic( 4 * sizeof(Small) ), 1000 );
+      check_distribution< Small >( Distribution::block(), 1000 );
+      check_distribution< Small >( Distribution::hashed( 256 ), 1000 );
+      check_distribution< Big >( Distribution::cyclic( sizeof(Big) ), 123 );
+      check_distribution< Big >( Distribution::block(), 7 );
     }
   });
   Grappa::finalize();
@@ -0,0 +1,66 @@
+////////////////////////////////////////////////////////////////////////
+// This file is part of Grappa, a system for scaling irregular
+// applications on commodity clusters. 
+
+// Copyright (C) 2010-2014 University of Washington and Battelle
+// Memorial Institute. University of Washington authorizes use of this
+// Grappa software.
+
+// Grappa is free software: you can redistribute it and/or modify it
+// under the terms of the Affero General Public License as published
+// by Affero, Inc., either version 1 of the License, or (at your
+// option) any later version.
+
+// Grappa is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero General Public License for more details.
+
+// You should have received a copy of the Affero General Public
+// License along with this program. If not, you may obtain one from
+// http://www.affero.org/oagpl.html.
+////////////////////////////////////////////////////////////////////////
+
+#include "AllToAll.hpp"
+
+DEFINE_int64( alltoallv_window_bytes, 1L << 20, "Bytes of staging buffers per core for outgoing alltoallv messages" );
+
+GRAPPA_DEFINE_METRIC(SimpleMetric<int64_t>, alltoallv_bytes_sent, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<int64_t>, alltoallv_messages, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<int64_t>, alltoallv_window_stalls, 0);
+
+namespace Grappa {
+  
+  namespace impl {
+    
+    struct CountExchange {
+      size_t * recv_counts;
+      Core received;
+      ConditionVariable cv;
+    };
+    static CountExchange count_exchange;
+    
+  } // namespace impl
+  
+  void alltoall_counts(const size_t * send_counts, size_t * recv_counts) {
+    auto& s = impl::count_exchange;
+    const Core me = mycore();
+    s.recv_counts = recv_counts;
+    s.received = 0;
+    recv_counts[me] = send_counts[me];
+    barrier();
+    
+    for (Core i = 1; i < cores(); i++) {
+      Core d = (me + i) % cores();
+      size_t n = send_counts[d];
+      send_heap_message(d, [me,n]{
+        auto& s = impl::count_exchange;
+        s.recv_counts[me] = n;
+        s.received++;
+        broadcast(&s.cv);
+      });
+    }
+    while (s.received < cores()-1) Grappa::wait(&s.cv);
+  }
+  
+} // namespace Grappa
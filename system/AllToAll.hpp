@@ -0,0 +1,195 @@
+////////////////////////////////////////////////////////////////////////
+// This file is part of Grappa, a system for scaling irregular
+// applications on commodity clusters. 
+
+// Copyright (C) 2010-2014 University of Washington and Battelle
+// Memorial Institute. University of Washington authorizes use of this
+// Grappa software.
+
+// Grappa is free software: you can redistribute it and/or modify it
+// under the terms of the Affero General Public License as published
+// by Affero, Inc., either version 1 of the License, or (at your
+// option) any later version.
+
+// Grappa is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero General Public License for more details.
+
+// You should have received a copy of the Affero General Public
+// License along with this program. If not, you may obtain one from
+// http://www.affero.org/oagpl.html.
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Collective.hpp"
+#include "ConditionVariable.hpp"
+#include "Metrics.hpp"
+#include <vector>
+#include <numeric>
+
+DECLARE_int64( alltoallv_window_bytes );
+
+GRAPPA_DECLARE_METRIC(SimpleMetric<int64_t>, alltoallv_bytes_sent);
+GRAPPA_DECLARE_METRIC(SimpleMetric<int64_t>, alltoallv_messages);
+GRAPPA_DECLARE_METRIC(SimpleMetric<int64_t>, alltoallv_window_stalls);
+
+namespace Grappa {
+  
+  namespace impl {
+    
+    /// Per-core state for alltoallv(), one per element type.
+    template< typename T >
+    struct AllToAll {
+      T * recv;
+      std::vector<size_t> recv_displ; ///< where each source's elements start in `recv`
+      size_t expected;
+      size_t received;
+      
+      LocaleBuffer<T> window;         ///< staging slots for outgoing messages
+      std::vector<size_t> free_slots;
+      ConditionVariable cv;
+    };
+    
+    template< typename T >
+    AllToAll<T>& alltoall_state() {
+      static AllToAll<T> s;
+      return s;
+    }
+    
+    /// Send `send_counts[d]` elements from `outgoing[d]` to each core `d`; see alltoallv().
+    template< typename T >
+    void alltoallv(const T * const * outgoing, const size_t * send_counts,
+                   T * recv, const size_t * recv_counts) {
+      auto& s = alltoall_state<T>();
+      const Core P = cores();
+      const Core me = mycore();
+      const size_t n_per_msg = MAX_MESSAGE_SIZE / sizeof(T);
+      CHECK_GT(n_per_msg, 0) << "elements too large for alltoallv";
+      
+      s.recv = recv;
+      s.recv_displ.resize(P);
+      size_t total = 0;
+      for (Core c = 0; c < P; c++) {
+        s.recv_displ[c] = total;
+        total += recv_counts[c];
+      }
+      s.expected = total - recv_counts[me];
+      s.received = 0;
+      
+      size_t nslots = std::max<size_t>(1, FLAGS_alltoallv_window_bytes / (n_per_msg * sizeof(T)));
+      s.window.resize(nslots * n_per_msg);
+      s.free_slots.resize(nslots);
+      std::iota(s.free_slots.begin(), s.free_slots.end(), 0);
+      
+      barrier(); // everyone must be set up before data starts arriving
+      
+      CHECK_EQ(send_counts[me], recv_counts[me]);
+      std::copy(outgoing[me], outgoing[me] + send_counts[me], recv + s.recv_displ[me]);
+      
+      // start with the next core over, so each core is a destination for one sender at a time
+      for (Core i = 1; i < P; i++) {
+        Core d = (me + i) % P;
+        for (size_t k = 0; k < send_counts[d]; k += n_per_msg) {
+          size_t n = std::min(n_per_msg, send_counts[d] - k);
+          
+          if (s.free_slots.empty()) {
+            alltoallv_window_stalls++;
+            while (s.free_slots.empty()) Grappa::wait(&s.cv);
+          }
+          size_t slot = s.free_slots.back();
+          s.free_slots.pop_back();
+          T * buf = &s.window[slot * n_per_msg];
+          std::copy(outgoing[d] + k, outgoing[d] + k + n, buf);
+          
+          send_heap_message(d, [me,k,slot](void * payload, size_t payload_size) {
+            auto& s = alltoall_state<T>();
+            auto in = static_cast<T*>(payload);
+            auto in_n = payload_size / sizeof(T);
+            std::copy(in, in + in_n, s.recv + s.recv_displ[me] + k);
+            s.received += in_n;
+            if (s.received == s.expected) broadcast(&s.cv);
+            
+            // the payload has been delivered, so its slot can be reused
+            send_heap_message(me, [slot]{
+              auto& s = alltoall_state<T>();
+              s.free_slots.push_back(slot);
+              broadcast(&s.cv);
+            });
+          }, buf, n * sizeof(T));
+          
+          alltoallv_messages++;
+          alltoallv_bytes_sent += n * sizeof(T);
+        }
+      }
+      
+      while (s.free_slots.size() < nslots || s.received < s.expected) {
+        Grappa::wait(&s.cv);
+      }
+    }
+    
+  } // namespace impl
+  
+  /// @addtogroup Collectives
+  /// @{
+  
+  /// Called from SPMD context: tell every core how many elements this core will send it.
+  /// `send_counts[d]` is the number for core `d`; afterwards `recv_counts[s]` is the number
+  /// core `s` will send to this one. Use it to size receive buffers for alltoallv().
+  void alltoall_counts(const size_t * send_counts, size_t * recv_counts);
+  
+  /// Called from SPMD context. Bulk all-to-all exchange (like MPI_Alltoallv): `send` holds
+  /// the elements for core 0, then those for core 1, and so on, `send_counts[d]` for each
+  /// core `d`. Elements arrive in `recv` grouped by source core in the same way, with
+  /// `recv_counts` as computed by alltoall_counts(). Blocks until everything to and from
+  /// this core has been delivered.
+  ///
+  /// Data moves in messages of up to MAX_MESSAGE_SIZE, staged through a window of
+  /// --alltoallv_window_bytes per core, so memory use doesn't grow with the amount
+  /// exchanged. This is much cheaper than a delegate or GlobalVector push per element for
+  /// shuffles (hash joins, bucket sorts, partitioning).
+  template< typename T >
+  void alltoallv(const T * send, const size_t * send_counts, T * recv, const size_t * recv_counts) {
+    std::vector<const T*> outgoing(cores());
+    size_t offset = 0;
+    for (Core d = 0; d < cores(); d++) {
+      outgoing[d] = send + offset;
+      offset += send_counts[d];
+    }
+    impl::alltoallv(&outgoing[0], send_counts, recv, recv_counts);
+  }
+  
+  /// Called from SPMD context. All-to-all exchange of per-destination buffers: `outgoing[d]`
+  /// is sent to core `d`, and everything sent to this core is returned, grouped by source
+  /// core. If given, `recv_counts` gets the number of elements from each core.
+  ///
+  /// @b Example:
+  /// @code
+  ///   Grappa::on_all_cores([]{
+  ///     std::vector<std::vector<Tuple>> out(Grappa::cores());
+  ///     for (auto& t : local_tuples) out[hash(t.key) % Grappa::cores()].push_back(t);
+  ///     auto mine = Grappa::alltoallv(out);  // all tuples hashing to this core
+  ///   });
+  /// @endcode
+  template< typename T >
+  std::vector<T> alltoallv(const std::vector<std::vector<T>>& outgoing,
+                           std::vector<size_t> * recv_counts = nullptr) {
+    CHECK_EQ(outgoing.size(), cores());
+    std::vector<const T*> ptrs(cores());
+    std::vector<size_t> send_counts(cores()), counts(cores());
+    for (Core d = 0; d < cores(); d++) {
+      ptrs[d] = outgoing[d].data();
+      send_counts[d] = outgoing[d].size();
+    }
+    alltoall_counts(&send_counts[0], &counts[0]);
+    
+    std::vector<T> recv( std::accumulate(counts.begin(), counts.end(), size_t(0)) );
+    impl::alltoallv(&ptrs[0], &send_counts[0], recv.data(), &counts[0]);
+    if (recv_counts) *recv_counts = counts;
+    return recv;
+  }
+  
+  /// @}
+  
+} // namespace Grappa
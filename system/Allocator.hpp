@@ -205,6 +205,16 @@ public:
     try_merge_buddy_recursive( block_to_free_iterator );
   }
 
+  /// Free the previously-allocated chunk containing an address.
+  void free_containing( void * void_address ) {
+    intptr_t address = reinterpret_cast< intptr_t >( void_address ) - base_;
+    ChunkMap::iterator it = chunks_.upper_bound( address );
+    assert( it != chunks_.begin() );
+    --it;
+    assert( address < it->second.address + (intptr_t) it->second.size );
+    free( reinterpret_cast< void * >( it->second.address + base_ ) );
+  }
+
   /// Allocate size bytes
   void * malloc( size_t size ) {
     int64_t allocation_size = next_largest_power_of_2( size );
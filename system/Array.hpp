@@ -75,7 +75,7 @@ namespace impl {
     int64_t nlastcore = src_end - src_end.block_min();
     int64_t nmiddle = nelem - nfirstcore - nlastcore;
     
-    const size_t nblock = block_size / sizeof(T);
+    const size_t nblock = src.block_bytes() / sizeof(T);
     
     CHECK_EQ(nmiddle % nblock, 0);
 
@@ -105,7 +105,7 @@ namespace impl {
     size_t nlocalblocks = nlocal_trimmed/nblock;
     Writeback * ws = locale_alloc<Writeback>(nlocalblocks);
     for (size_t i=0; i<nlocalblocks; i++) {
-      size_t j = make_linear(local_base+(i*nblock))-src;
+      size_t j = make_linear(local_base+(i*nblock), src.distribution())-src;
       new (ws+i) Writeback(dst+j, nblock, local_base+(i*nblock));
       ws[i].start_release();
     }
@@ -152,11 +152,115 @@ void memcpy_async(GlobalAddress<T> dst, GlobalAddress<T> src, size_t nelem) {
   });
 }
 
-/// not implemented yet
+namespace impl {
+  
+  /// Per-core state for prefix_sum(). The array is cut into chunks at distribution
+  /// block boundaries (so each chunk is contiguous both globally and locally). Chunk sums
+  /// are collected in chunk order, split evenly across cores, scanned there, and the
+  /// resulting offsets sent back to the cores holding each chunk.
+  template< typename T >
+  struct PrefixSumState {
+    std::vector<int64_t> my_chunks; ///< chunks held by this core, in local (and global) order
+    std::vector<T> chunk_offset;    ///< sum of everything before each of my_chunks
+    int64_t owned_begin;            ///< first chunk whose sum this core collects
+    std::vector<T> owned;           ///< sums of chunks [owned_begin, owned_begin+owned.size()), then their offsets
+    size_t sums_in, offsets_in;
+    ConditionVariable cv;
+  };
+  
+  template< typename T >
+  PrefixSumState<T>& prefix_sum_state() {
+    static PrefixSumState<T> s;
+    return s;
+  }
+  
+} // namespace impl
+
+/// Exclusive prefix sum of a global array, in place: afterwards `array[i]` holds the sum of
+/// the original `array[0..i)`. Called from a single task; blocks until done. Works for any
+/// Distribution, with each core doing the work for the elements it holds.
+///
+/// @warning Only one prefix_sum on a given element type may run at a time.
 template< typename T >
 void prefix_sum(GlobalAddress<T> array, size_t nelem) {
-  // not implemented
-  CHECK(false) << "prefix_sum is currently unimplemented!";
+  if (nelem == 0) return;
+  CHECK(array.block_bytes() % sizeof(T) == 0) << "elements must not straddle distribution blocks";
+  
+  on_all_cores([array,nelem]{
+    auto& s = impl::prefix_sum_state<T>();
+    const auto dist = array.distribution();
+    const int64_t block_elems = array.block_bytes() / sizeof(T);
+    const int64_t first_skip = array - array.block_min();
+    const int64_t nchunks = (nelem + first_skip + block_elems - 1) / block_elems;
+    const int64_t per_core = (nchunks + cores() - 1) / cores();
+    
+    auto owner = [per_core](int64_t k) -> Core { return k / per_core; };
+    auto chunk_core = [array,block_elems,first_skip](int64_t k) {
+      return (k == 0) ? array.core() : (array + (k*block_elems - first_skip)).core();
+    };
+    
+    T * local_base = array.localize();
+    T * local_end = (array+nelem).localize();
+    
+    // find this core's chunks (each ends at a block boundary or the end of the array)
+    std::vector<std::pair<T*,int64_t>> runs;
+    s.my_chunks.clear();
+    for (T * p = local_base; p < local_end; ) {
+      int64_t i = make_linear(p, dist) - array;
+      int64_t k = (i + first_skip) / block_elems;
+      int64_t n = std::min<int64_t>( (k+1)*block_elems - first_skip - i, local_end - p );
+      s.my_chunks.push_back(k);
+      runs.push_back(std::make_pair(p, n));
+      p += n;
+    }
+    s.chunk_offset.assign(s.my_chunks.size(), T());
+    s.owned_begin = std::min(nchunks, mycore()*per_core);
+    s.owned.assign(std::min(nchunks, s.owned_begin+per_core) - s.owned_begin, T());
+    s.sums_in = s.offsets_in = 0;
+    barrier();
+    
+    // sum each chunk and send the sum to the core collecting it
+    for (size_t j=0; j<runs.size(); j++) {
+      T sum = T();
+      for (int64_t i=0; i<runs[j].second; i++) sum += runs[j].first[i];
+      int64_t k = s.my_chunks[j];
+      send_heap_message(owner(k), [k,sum]{
+        auto& s = impl::prefix_sum_state<T>();
+        s.owned[k - s.owned_begin] = sum;
+        s.sums_in++;
+        broadcast(&s.cv);
+      });
+    }
+    while (s.sums_in < s.owned.size()) Grappa::wait(&s.cv);
+    
+    // scan the collected sums, then across cores (which collect chunks in order)
+    T total = T();
+    for (auto& x : s.owned) { T t = x; x = total; total += t; }
+    T before = exclusive_scan<T,collective_add>(total);
+    
+    for (size_t j=0; j<s.owned.size(); j++) {
+      int64_t k = s.owned_begin + j;
+      T offset = before + s.owned[j];
+      send_heap_message(chunk_core(k), [k,offset]{
+        auto& s = impl::prefix_sum_state<T>();
+        auto it = std::lower_bound(s.my_chunks.begin(), s.my_chunks.end(), k);
+        s.chunk_offset[it - s.my_chunks.begin()] = offset;
+        s.offsets_in++;
+        broadcast(&s.cv);
+      });
+    }
+    while (s.offsets_in < s.my_chunks.size()) Grappa::wait(&s.cv);
+    
+    // finally, scan within each chunk
+    for (size_t j=0; j<runs.size(); j++) {
+      T acc = s.chunk_offset[j];
+      for (int64_t i=0; i<runs[j].second; i++) {
+        T t = runs[j].first[i];
+        runs[j].first[i] = acc;
+        acc += t;
+      }
+    }
+  });
 }
 
 namespace util {
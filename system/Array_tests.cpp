@@ -114,6 +114,23 @@ void test_prefix_sum() {
     BOOST_CHECK_EQUAL(v, i);
   });
   Grappa::global_free(xs);
+  
+  // other distributions, and a start that isn't block-aligned
+  auto ys = Grappa::global_alloc<int64_t>(N, Distribution::block());
+  Grappa::forall(ys, N, [](int64_t i, int64_t& v){ v = i; });
+  Grappa::prefix_sum(ys, N);
+  Grappa::forall(ys, N, [](int64_t i, int64_t& v){
+    BOOST_CHECK_EQUAL(v, i*(i-1)/2);
+  });
+  Grappa::global_free(ys);
+  
+  auto zs = Grappa::global_alloc<int64_t>(N, Distribution::hashed());
+  Grappa::memset(zs, 1, N);
+  Grappa::prefix_sum(zs+3, N-3);
+  Grappa::forall(zs+3, N-3, [](int64_t i, int64_t& v){
+    BOOST_CHECK_EQUAL(v, i);
+  });
+  Grappa::global_free(zs);
 }
 
 PushBuffer<int64_t> pusher;
@@ -152,7 +169,7 @@ BOOST_AUTO_TEST_CASE( test1 ) {
     test_memset_memcpy<int64_t,7>(true); // test async
     // test_memset_memcpy<double,7.0>();
     test_complex();
-    // test_prefix_sum(); // (not implemented yet)
+    test_prefix_sum();
     test_push_buffer();
     
     BOOST_MESSAGE("Testing memcpy on 2D addresses");
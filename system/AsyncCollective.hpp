@@ -0,0 +1,160 @@
+////////////////////////////////////////////////////////////////////////
+// This file is part of Grappa, a system for scaling irregular
+// applications on commodity clusters. 
+
+// Copyright (C) 2010-2014 University of Washington and Battelle
+// Memorial Institute. University of Washington authorizes use of this
+// Grappa software.
+
+// Grappa is free software: you can redistribute it and/or modify it
+// under the terms of the Affero General Public License as published
+// by Affero, Inc., either version 1 of the License, or (at your
+// option) any later version.
+
+// Grappa is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero General Public License for more details.
+
+// You should have received a copy of the Affero General Public
+// License along with this program. If not, you may obtain one from
+// http://www.affero.org/oagpl.html.
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Collective.hpp"
+#include "GlobalCompletionEvent.hpp"
+#include "FullEmptyLocal.hpp"
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace Grappa {
+  
+  namespace impl {
+    
+    template< typename T >
+    struct AsyncCollectiveState {
+      FullEmpty<T> result;
+      GlobalCompletionEvent * gce;
+      
+      /// called (in a message handler) when the collective's result arrives
+      void fill(const T& val) {
+        result.writeXF(val);
+        if (gce) gce->complete();
+      }
+    };
+    
+    /// Per-core bookkeeping for allreduce_async. Operations are matched up across
+    /// cores by sequence number, so any number can be in flight as long as every
+    /// core issues them in the same order.
+    template< typename T, T (*ReduceOp)(const T&, const T&), typename Tag >
+    struct AsyncReduction {
+      struct Pending {
+        T total;
+        Core cores_in;
+        std::vector< GlobalAddress< AsyncCollectiveState<T> > > states;
+      };
+      
+      /// sequence number of the next operation issued from this core
+      static int64_t next_seq;
+      
+      /// partial results of in-flight operations (HOME_CORE only)
+      static std::unordered_map< int64_t, Pending > pending;
+      
+      static void contribute(int64_t seq, const T& val, GlobalAddress< AsyncCollectiveState<T> > s) {
+        DCHECK(mycore() == HOME_CORE);
+        auto& p = pending[seq];
+        p.total = (p.cores_in == 0) ? val : ReduceOp(p.total, val);
+        p.cores_in++;
+        p.states.push_back(s);
+        
+        if (p.cores_in == cores()) {
+          T total = p.total;
+          for (auto s : p.states) {
+            send_heap_message(s.core(), [s,total]{ s.pointer()->fill(total); });
+          }
+          pending.erase(seq);
+        }
+      }
+    };
+    template< typename T, T (*ReduceOp)(const T&, const T&), typename Tag >
+    int64_t AsyncReduction<T,ReduceOp,Tag>::next_seq = 0;
+    template< typename T, T (*ReduceOp)(const T&, const T&), typename Tag >
+    std::unordered_map< int64_t, typename AsyncReduction<T,ReduceOp,Tag>::Pending > AsyncReduction<T,ReduceOp,Tag>::pending;
+    
+    struct BarrierTag {};
+    
+  } // namespace impl
+  
+  /// @addtogroup Collectives
+  /// @{
+  
+  /// Handle to the result of a non-blocking collective (see allreduce_async() and
+  /// barrier_async()). Must be kept alive until the collective has completed; the
+  /// destructor waits for it if necessary.
+  template< typename T >
+  class CollectiveFuture {
+    std::unique_ptr< impl::AsyncCollectiveState<T> > s;
+  public:
+    CollectiveFuture(GlobalCompletionEvent * gce = nullptr): s(new impl::AsyncCollectiveState<T>()) {
+      s->gce = gce;
+    }
+    CollectiveFuture(CollectiveFuture&& f) = default;
+    CollectiveFuture& operator=(CollectiveFuture&& f) = default;
+    ~CollectiveFuture() { if (s) wait(); }
+    
+    impl::AsyncCollectiveState<T> * state() { return s.get(); }
+    
+    /// True once the result has arrived (never blocks).
+    bool ready() const { return s->result.full(); }
+    
+    /// Block the calling task until the collective is complete.
+    void wait() { s->result.readFF(); }
+    
+    /// Block until the collective is complete and return its result.
+    T get() { return s->result.readFF(); }
+  };
+  
+  /// Non-blocking version of allreduce(). Called from SPMD context: contributes `myval`
+  /// and returns immediately with a handle for the total, so local work can overlap
+  /// the reduction. Any number may be in flight, as long as all cores issue them in
+  /// the same order.
+  ///
+  /// If a GlobalCompletionEvent is given, the reduction is enrolled in it (on the
+  /// calling core), so waiting on the GCE at the end of the next phase also waits for
+  /// the reduction and `get()` won't block afterwards.
+  ///
+  /// @b Example:
+  /// @code
+  ///   // convergence check that overlaps the next iteration
+  ///   auto changed = allreduce_async<bool,collective_or>(local_changed, &gce);
+  ///   forall<async,&gce>(...);   // next iteration
+  ///   gce.wait();
+  ///   if (!changed.get()) break;
+  /// @endcode
+  template< typename T, T (*ReduceOp)(const T&, const T&), typename Tag = void >
+  CollectiveFuture<T> allreduce_async(T myval, GlobalCompletionEvent * gce = nullptr) {
+    using R = impl::AsyncReduction<T,ReduceOp,Tag>;
+    CollectiveFuture<T> f(gce);
+    if (gce) gce->enroll();
+    
+    int64_t seq = R::next_seq++;
+    auto s = make_global(f.state());
+    send_heap_message(impl::HOME_CORE, [seq,myval,s]{
+      R::contribute(seq, myval, s);
+    });
+    return f;
+  }
+  
+  /// Non-blocking SPMD barrier: returns immediately with a handle that becomes ready
+  /// once every core has entered the barrier. Composes with a GlobalCompletionEvent
+  /// the same way as allreduce_async().
+  inline CollectiveFuture<bool> barrier_async(GlobalCompletionEvent * gce = nullptr) {
+    return allreduce_async<bool,collective_and,impl::BarrierTag>(true, gce);
+  }
+  
+  /// @}
+  
+} // namespace Grappa
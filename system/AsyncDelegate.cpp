@@ -26,3 +26,4 @@
 GRAPPA_DEFINE_METRIC(SimpleMetric<int64_t>, delegate_async_ops, 0);
 GRAPPA_DEFINE_METRIC(SimpleMetric<int64_t>, delegate_async_writes, 0);
 GRAPPA_DEFINE_METRIC(SimpleMetric<int64_t>, delegate_async_increments, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<int64_t>, delegate_async_reads, 0);
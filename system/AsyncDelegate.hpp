@@ -28,11 +28,16 @@
 #include "GlobalCompletionEvent.hpp"
 // #include "ParallelLoop.hpp"
 #include <type_traits>
+#include <memory>
+#include <array>
 #include "Metrics.hpp"
 
 GRAPPA_DECLARE_METRIC(SimpleMetric<int64_t>, delegate_async_ops);
 GRAPPA_DECLARE_METRIC(SimpleMetric<int64_t>, delegate_async_writes);
 GRAPPA_DECLARE_METRIC(SimpleMetric<int64_t>, delegate_async_increments);
+GRAPPA_DECLARE_METRIC(SimpleMetric<int64_t>, delegate_async_reads);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, delegate_reads);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, delegate_read_targets);
 GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, delegate_short_circuits);
 
 namespace Grappa {
@@ -65,12 +70,19 @@ namespace Grappa {
       int64_t network_time;
       
     public:
-      Promise(): _result(), network_time(0), start_time(0) {}
+      Promise(): _result(), start_time(0), network_time(0) {}
       
       inline void fill(const R& r) {
         _result.writeXF(r);
       }
       
+      /// True once the result has arrived (never blocks).
+      inline bool ready() const { return _result.full(); }
+      
+      /// Block until the result has arrived, without consuming it. Wakeup latency
+      /// is only recorded by get(), so waiting first doesn't count it twice.
+      inline void wait() { _result.readFF(); }
+      
       /// Block on result being returned.
       inline const R get() {
         // ... and wait for the result
@@ -109,8 +121,104 @@ namespace Grappa {
           }); // send message
         }
       }
+      
+      /// Issue a read of `target` (which must be of type R), returning immediately.
+      /// @warning Target object must lie on a single node (not span blocks in global address space).
+      void read_async(GlobalAddress<R> target) {
+        delegate_reads++;
+        delegate_async_reads++;
+        call_async(target.core(), [target]() -> R {
+          delegate_read_targets++;
+          return *target.pointer();
+        });
+      }
     };
     
+    /// Handle to the result of an async delegate operation, as returned by delegate::read_async()
+    /// and delegate::call_async(). Unlike Promise, a Future can be returned and moved around
+    /// freely because the result storage lives on the heap of the issuing core (so the message
+    /// replying with the result has a stable place to write it).
+    ///
+    /// @b Example:
+    /// @code
+    ///   auto x = delegate::read_async(xa);
+    ///   auto y = delegate::read_async(ya);
+    ///   // ...other work while both reads are in flight...
+    ///   total = x.get() + y.get();
+    /// @endcode
+    template<typename R>
+    class Future {
+      std::unique_ptr<Promise<R>> p;
+    public:
+      Future(): p(new Promise<R>()) {}
+      Future(Future&& f) = default;
+      Future& operator=(Future&& f) = default;
+      
+      Promise<R>& promise() { return *p; }
+      
+      /// True once the result has arrived (never blocks).
+      bool ready() const { return p->ready(); }
+      
+      /// Block the calling task until the result has arrived.
+      void wait() { p->wait(); }
+      
+      /// Block until the result has arrived and return it.
+      const R get() { return p->get(); }
+    };
+    
+    /// Call `func` on core `dest`, returning immediately with a Future for its result.
+    template <typename F>
+    auto call_async(Core dest, F func) -> Future<decltype(func())> {
+      Future<decltype(func())> f;
+      f.promise().call_async(dest, func);
+      return f;
+    }
+    
+    /// Read the value (potentially remote) at the given GlobalAddress, returning immediately
+    /// with a Future that can be waited on when the value is actually needed.
+    /// @warning Target object must lie on a single node (not span blocks in global address space).
+    template <typename T>
+    Future<T> read_async(GlobalAddress<T> target) {
+      Future<T> f;
+      f.promise().read_async(target);
+      return f;
+    }
+    
+    /// Pipeline reads of `n` (potentially remote) addresses from a single task, keeping up to
+    /// `K` reads in flight at once. `addr(i)` gives the address of the i-th element, and
+    /// `f(i, value)` is called with each result, in order, as soon as it arrives.
+    /// The window lives on the calling task's stack, so no tasks or heap storage are created.
+    ///
+    /// @b Example:
+    /// @code
+    ///   // sum an arbitrary permutation of an array with 16 reads in flight
+    ///   int64_t total = 0;
+    ///   delegate::prefetch_window<16>(n,
+    ///     [=](int64_t i){ return A + perm[i]; },
+    ///     [&](int64_t i, int64_t v){ total += v; });
+    /// @endcode
+    template< size_t K, typename AddrFn, typename F >
+    void prefetch_window(int64_t n, AddrFn addr, F f) {
+      static_assert(K > 0, "prefetch window must hold at least one read");
+      using T = typename std::remove_reference<decltype(*addr(0).pointer())>::type;
+      std::array<Promise<T>,K> window;
+      
+      int64_t issued = 0;
+      for (; issued < n && issued < (int64_t)K; issued++) {
+        window[issued].read_async(addr(issued));
+      }
+      for (int64_t i = 0; i < n; i++) {
+        auto& slot = window[i % K];
+        T v = slot.get();
+        // refill the slot before handing the value off so the window stays full
+        if (issued < n) {
+          slot.read_async(addr(issued));
+          issued++;
+        }
+        f(i, v);
+      }
+    }
+    
     /// @}
   } // namespace delegate
 
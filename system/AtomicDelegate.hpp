@@ -0,0 +1,266 @@
+////////////////////////////////////////////////////////////////////////
+// This file is part of Grappa, a system for scaling irregular
+// applications on commodity clusters. 
+
+// Copyright (C) 2010-2014 University of Washington and Battelle
+// Memorial Institute. University of Washington authorizes use of this
+// Grappa software.
+
+// Grappa is free software: you can redistribute it and/or modify it
+// under the terms of the Affero General Public License as published
+// by Affero, Inc., either version 1 of the License, or (at your
+// option) any later version.
+
+// Grappa is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero General Public License for more details.
+
+// You should have received a copy of the Affero General Public
+// License along with this program. If not, you may obtain one from
+// http://www.affero.org/oagpl.html.
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Delegate.hpp"
+#include "CompletionEvent.hpp"
+#include "Metrics.hpp"
+
+#include <vector>
+#include <deque>
+#include <utility>
+#include <type_traits>
+
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, delegate_atomics);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, delegate_atomic_locale_ops);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, delegate_atomic_batch_messages);
+
+namespace Grappa {
+  
+  /// @addtogroup Delegates
+  /// @{
+  
+  namespace impl {
+    
+    /// Maximum number of atomic ops combined into one message to a core.
+    const size_t atomic_batch_max = 64;
+    
+    // Atomic operations on a local pointer. The owning core uses these too,
+    // so they stay correct while cores in the same locale operate directly
+    // on the shared segment.
+    
+    struct AtomicFetchAdd {
+      template< typename T > T operator()(T* p, const T& v) const {
+        return __atomic_fetch_add(p, v, __ATOMIC_SEQ_CST);
+      }
+    };
+    struct AtomicFetchOr {
+      template< typename T > T operator()(T* p, const T& v) const {
+        return __atomic_fetch_or(p, v, __ATOMIC_SEQ_CST);
+      }
+    };
+    struct AtomicFetchAnd {
+      template< typename T > T operator()(T* p, const T& v) const {
+        return __atomic_fetch_and(p, v, __ATOMIC_SEQ_CST);
+      }
+    };
+    struct AtomicFetchXor {
+      template< typename T > T operator()(T* p, const T& v) const {
+        return __atomic_fetch_xor(p, v, __ATOMIC_SEQ_CST);
+      }
+    };
+    struct AtomicSwap {
+      template< typename T > T operator()(T* p, const T& v) const {
+        return __atomic_exchange_n(p, v, __ATOMIC_SEQ_CST);
+      }
+    };
+    struct AtomicFetchMin {
+      template< typename T > T operator()(T* p, const T& v) const {
+        T old = __atomic_load_n(p, __ATOMIC_SEQ_CST);
+        while (v < old && !__atomic_compare_exchange_n(p, &old, v, true,
+                                                       __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST));
+        return old;
+      }
+    };
+    struct AtomicFetchMax {
+      template< typename T > T operator()(T* p, const T& v) const {
+        T old = __atomic_load_n(p, __ATOMIC_SEQ_CST);
+        while (old < v && !__atomic_compare_exchange_n(p, &old, v, true,
+                                                       __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST));
+        return old;
+      }
+    };
+    /// operand is (compare value, new value); uses __sync builtins so
+    /// 16-byte operands compile to cmpxchg16b (requires -mcx16)
+    struct AtomicCompareSwap {
+      template< typename T > bool operator()(T* p, const std::pair<T,T>& v) const {
+        return __sync_bool_compare_and_swap(p, v.first, v.second);
+      }
+    };
+    
+    /// Apply `op` to the object at `target` with CPU atomics: directly if it is in
+    /// this locale's shared segment, otherwise with a blocking delegate to its owner.
+    template< typename T, typename O, typename F >
+    inline auto atomic_call(GlobalAddress<T> target, O operand, F op)
+      -> decltype(op(target.pointer(), operand))
+    {
+      delegate_atomics++;
+      if (target.is_locale_shared()) {
+        delegate_atomic_locale_ops++;
+        return op(target.locale_pointer(), operand);
+      } else {
+        return delegate::call(target.core(), [target,operand,op]{
+          return op(target.pointer(), operand);
+        });
+      }
+    }
+    
+    template< typename T, typename O >
+    struct AtomicRequest {
+      GlobalAddress<T> target;
+      O operand;
+      size_t index;
+    };
+    
+    template< typename R >
+    struct AtomicReply {
+      R results[atomic_batch_max];
+    };
+    
+    /// Apply `op` to each of `n` targets, storing results (if `results` is non-null).
+    /// Locale-shared targets are done in place; the rest are combined into one
+    /// message per destination core (up to atomic_batch_max ops each).
+    /// Blocks until all ops are complete.
+    template< typename T, typename O, typename R, typename F >
+    void atomic_batch(const GlobalAddress<T> * targets, const O * operands,
+                      R * results, size_t n, F op)
+    {
+      typedef AtomicRequest<T,O> Request;
+      std::vector< std::vector<Request> > pending( cores() );
+      std::deque< std::vector<Request> > in_flight; // kept alive until replies arrive
+      CompletionEvent ce;
+      Core origin = mycore();
+      
+      auto flush = [&](Core c) {
+        in_flight.emplace_back();
+        in_flight.back().swap( pending[c] );
+        const Request * reqs = &in_flight.back()[0];
+        size_t nreq = in_flight.back().size();
+        
+        ce.enroll();
+        delegate_atomic_batch_messages++;
+        send_heap_message(c, [origin,reqs,results,op,&ce](void * payload, size_t payload_size) {
+          auto in = static_cast<Request*>(payload);
+          size_t k = payload_size / sizeof(Request);
+          AtomicReply<R> reply;
+          for (size_t i=0; i<k; i++) {
+            reply.results[i] = op(in[i].target.pointer(), in[i].operand);
+          }
+          send_heap_message(origin, [reqs,results,reply,k,&ce]{
+            if (results) {
+              for (size_t i=0; i<k; i++) results[reqs[i].index] = reply.results[i];
+            }
+            ce.complete();
+          });
+        }, (void*)reqs, sizeof(Request)*nreq);
+      };
+      
+      for (size_t i=0; i<n; i++) {
+        delegate_atomics++;
+        if (targets[i].is_locale_shared()) {
+          delegate_atomic_locale_ops++;
+          R r = op(targets[i].locale_pointer(), operands[i]);
+          if (results) results[i] = r;
+        } else {
+          Core c = targets[i].core();
+          pending[c].push_back( Request{ targets[i], operands[i], i } );
+          if (pending[c].size() == atomic_batch_max) flush(c);
+        }
+      }
+      for (Core c=0; c<cores(); c++) {
+        if (!pending[c].empty()) flush(c);
+      }
+      ce.wait();
+    }
+    
+  } // namespace impl
+  
+  namespace delegate {
+    
+    /// Remote atomic operations.
+    ///
+    /// Unlike the other delegate operations, these are performed with CPU atomic
+    /// instructions. Targets in this core's locale are updated directly in the
+    /// locale shared segment without sending a message; other targets are
+    /// updated by their owning core. All accesses to an object used with these
+    /// must therefore go through this API (or other atomic instructions).
+    ///
+    /// The vector forms take arrays of `n` targets and operands, combine ops
+    /// headed to the same core into a single message, and block until all
+    /// are complete. `results` may be NULL if the old values are not needed.
+    ///
+    /// @b Example:
+    /// @code
+    ///   auto old = delegate::atomic::fetch_and_max(counters+k, v);
+    ///   delegate::atomic::fetch_and_add(addrs, ones, (int64_t*)NULL, n);
+    /// @endcode
+    ///
+    /// @warning Target objects must lie on a single core and be naturally aligned
+    ///          (16-byte aligned for 128-bit compare_and_swap).
+    namespace atomic {
+      
+#define GRAPPA_ATOMIC_FETCH_OP(name, Op)                                            \
+      template< typename T, typename U >                                            \
+      inline T name(GlobalAddress<T> target, U value) {                             \
+        static_assert(std::is_integral<T>::value, "atomic ops require integral types"); \
+        return impl::atomic_call(target, static_cast<T>(value), impl::Op());        \
+      }                                                                             \
+      template< typename T, typename U >                                            \
+      inline void name(const GlobalAddress<T> * targets, const U * values,          \
+                       T * results, size_t n) {                                     \
+        static_assert(std::is_integral<T>::value, "atomic ops require integral types"); \
+        static_assert(std::is_same<T,U>::value, "value type must match GlobalAddress type"); \
+        impl::atomic_batch(targets, values, results, n, impl::Op());                \
+      }
+      
+      /// Atomically add `value` to `*target`, returning the original value.
+      GRAPPA_ATOMIC_FETCH_OP(fetch_and_add, AtomicFetchAdd)
+      /// Atomically store min(`*target`, `value`), returning the original value.
+      GRAPPA_ATOMIC_FETCH_OP(fetch_and_min, AtomicFetchMin)
+      /// Atomically store max(`*target`, `value`), returning the original value.
+      GRAPPA_ATOMIC_FETCH_OP(fetch_and_max, AtomicFetchMax)
+      /// Atomically or `value` into `*target`, returning the original value.
+      GRAPPA_ATOMIC_FETCH_OP(fetch_and_or, AtomicFetchOr)
+      /// Atomically and `value` into `*target`, returning the original value.
+      GRAPPA_ATOMIC_FETCH_OP(fetch_and_and, AtomicFetchAnd)
+      /// Atomically xor `value` into `*target`, returning the original value.
+      GRAPPA_ATOMIC_FETCH_OP(fetch_and_xor, AtomicFetchXor)
+      /// Atomically replace `*target` with `value`, returning the original value.
+      GRAPPA_ATOMIC_FETCH_OP(swap, AtomicSwap)
+      
+#undef GRAPPA_ATOMIC_FETCH_OP
+      
+      /// If `*target` equals `cmp_val`, set it to `new_val` and return true.
+      /// Works on 1-, 2-, 4-, 8- and 16-byte (`unsigned __int128`) integers.
+      template< typename T, typename U, typename V >
+      inline bool compare_and_swap(GlobalAddress<T> target, U cmp_val, V new_val) {
+        static_assert(sizeof(T) <= 8 || sizeof(T) == 16, "unsupported compare_and_swap size");
+        return impl::atomic_call(target, std::make_pair(static_cast<T>(cmp_val), static_cast<T>(new_val)),
+                                 impl::AtomicCompareSwap());
+      }
+      
+      /// Vector compare_and_swap: `swaps[i]` holds (compare value, new value) for `targets[i]`.
+      template< typename T >
+      inline void compare_and_swap(const GlobalAddress<T> * targets, const std::pair<T,T> * swaps,
+                                   bool * results, size_t n) {
+        static_assert(sizeof(T) <= 8 || sizeof(T) == 16, "unsupported compare_and_swap size");
+        impl::atomic_batch(targets, swaps, results, n, impl::AtomicCompareSwap());
+      }
+      
+    } // namespace atomic
+  } // namespace delegate
+  
+  /// @}
+  
+} // namespace Grappa
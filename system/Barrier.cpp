@@ -23,7 +23,13 @@
 
 #include "Barrier.hpp"
 #include "ConditionVariable.hpp"
+#include "Phaser.hpp"
 
 namespace Grappa {
   ConditionVariable barrier_cv;
+  
+  namespace impl {
+    /// used by barrier_arrive()/barrier_wait()
+    Phaser default_phaser;
+  }
 }
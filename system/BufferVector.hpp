@@ -49,13 +49,13 @@ class BufferVector {
 
   public:
     BufferVector( size_t capacity = 2 ) 
-      : buf ( static_cast<T*>(Grappa::impl::locale_shared_memory.allocate( capacity*sizeof(T) )) )   // new T[capacity]
+      : buf ( static_cast<T*>(Grappa::impl::locale_shared_memory.allocate( capacity*sizeof(T), Grappa::impl::MemoryCategory::System )) )   // new T[capacity]
       , mode( WO )
       , nextIndex( 0 )
       , size( capacity ) { }
 
     ~BufferVector() {
-      Grappa::impl::locale_shared_memory.deallocate( buf );
+      Grappa::impl::locale_shared_memory.deallocate( buf, Grappa::impl::MemoryCategory::System );
     }
 
     void setWriteMode() {
@@ -75,9 +75,9 @@ class BufferVector {
         // expand the size of the buffer
         size_t newsize = size * 2;
         VLOG(3) << "New size of cell size: " << newsize << " bytes: " << newsize*sizeof(T);
-        T * newbuf = static_cast<T*>(Grappa::impl::locale_shared_memory.allocate( newsize*sizeof(T) ));      // new T[newsize]
+        T * newbuf = static_cast<T*>(Grappa::impl::locale_shared_memory.allocate( newsize*sizeof(T), Grappa::impl::MemoryCategory::System ));      // new T[newsize]
         memcpy( newbuf, buf, size*sizeof(T) );
-        Grappa::impl::locale_shared_memory.deallocate( buf );   // delete buf
+        Grappa::impl::locale_shared_memory.deallocate( buf, Grappa::impl::MemoryCategory::System );   // delete buf
         size = newsize;
         buf = newbuf;
       }
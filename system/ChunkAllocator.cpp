@@ -80,7 +80,9 @@ static void _aligned_allocator_append_chunk(struct aligned_allocator *aa,
 
     chunkallocator_append++;
     
-    new_chunk = Grappa::locale_alloc_aligned<struct memory_chunk>(CACHE_LINE_SIZE);
+    new_chunk = static_cast<struct memory_chunk*>(
+      Grappa::impl::locale_shared_memory.allocate_aligned( sizeof(struct memory_chunk), CACHE_LINE_SIZE,
+                                                           Grappa::impl::MemoryCategory::MessagePool ) );
     CHECK_NOTNULL(new_chunk);
 
     auto chunk_struct_size = sizeof( struct memory_chunk );
@@ -89,7 +91,9 @@ static void _aligned_allocator_append_chunk(struct aligned_allocator *aa,
     
     new_chunk->next = NULL;
     new_chunk->chunk_size = MAX(min_size, aa->chunk_size) + aa->align_on;
-    new_chunk->chunk = Grappa::locale_alloc_aligned<char>(CACHE_LINE_SIZE, new_chunk->chunk_size);
+    new_chunk->chunk = static_cast<char*>(
+      Grappa::impl::locale_shared_memory.allocate_aligned( new_chunk->chunk_size, CACHE_LINE_SIZE,
+                                                           Grappa::impl::MemoryCategory::MessagePool ) );
     CHECK_NOTNULL(new_chunk->chunk);
 
     auto chunk_size = sizeof(new_chunk->chunk_size);
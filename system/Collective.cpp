@@ -24,3 +24,7 @@
 #include "Collective.hpp"
 #include "Delegate.hpp"
 
+DEFINE_int64( collective_tree_fanout, 8, "Fan-out of broadcast tree used by on_all_cores/call_on_all_cores (0 sends directly from the caller to every core)" );
+
+DEFINE_int64( allreduce_ring_threshold, 1L << 16, "Arrays of at least this many bytes are allreduced around a ring instead of through one core" );
+
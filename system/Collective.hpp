@@ -34,10 +34,14 @@
 
 #include <functional>
 #include <algorithm>
+#include <vector>
 
 // TODO/FIXME: use actual max message size (have Communicator be able to tell us)
 const size_t MAX_MESSAGE_SIZE = 3192;
 
+DECLARE_int64( collective_tree_fanout );
+DECLARE_int64( allreduce_ring_threshold );
+
 #define COLL_MAX &collective_max
 #define COLL_MIN &collective_min
 #define COLL_ADD &collective_add
@@ -77,24 +81,99 @@ namespace Grappa {
   /// @addtogroup Collectives
   /// @{
   
+  namespace impl {
+    
+    /// One core's part in a tree-structured broadcast: counts completions
+    /// outstanding from its own work and from each child's subtree, and
+    /// reports to its parent once they're all in.
+    struct CollectiveTreeNode {
+      int64_t remaining;
+      GlobalAddress<CollectiveTreeNode> parent;
+      CompletionEvent * ce; ///< only set on the root
+      
+      void complete() {
+        if (--remaining > 0) return;
+        if (ce) {
+          ce->complete();
+        } else {
+          auto p = parent;
+          send_heap_message(p.core(), [p]{ p.pointer()->complete(); });
+          delete this;
+        }
+      }
+    };
+    
+    /// Broadcast tree used by call_on_all_cores/on_all_cores: a k-ary tree over
+    /// core ranks relative to `origin` (k = --collective_tree_fanout), so each
+    /// core sends at most k messages and receives at most k completions.
+    /// Cores in a locale are numbered contiguously, so subtrees near the
+    /// leaves tend to stay within a locale.
+    inline Core tree_fanout() {
+      return (FLAGS_collective_tree_fanout > 0) ? FLAGS_collective_tree_fanout : cores();
+    }
+    
+    template< bool Spawn, typename F >
+    void tree_collective_visit(Core origin, GlobalAddress<CollectiveTreeNode> parent, F work);
+    
+    /// Forward the broadcast to this core's children; returns the number of children.
+    template< bool Spawn, typename F >
+    int64_t tree_collective_forward(Core origin, GlobalAddress<CollectiveTreeNode> node, F work) {
+      const Core k = tree_fanout();
+      const int64_t rank = (mycore() - origin + cores()) % cores();
+      int64_t nchildren = 0;
+      for (int64_t r = rank*k + 1; r <= rank*k + k && r < cores(); r++) {
+        Core c = (origin + r) % cores();
+        send_heap_message(c, [origin, node, work] {
+          tree_collective_visit<Spawn>(origin, node, work);
+        });
+        nchildren++;
+      }
+      return nchildren;
+    }
+    
+    template< bool Spawn, typename F >
+    void run_tree_collective_work(CollectiveTreeNode * node, F work) {
+      if (Spawn) {
+        spawn([node, work] {
+          work();
+          node->complete();
+        });
+      } else {
+        work();
+        node->complete();
+      }
+    }
+    
+    /// Runs (in a message handler) when the broadcast reaches a non-root core.
+    template< bool Spawn, typename F >
+    void tree_collective_visit(Core origin, GlobalAddress<CollectiveTreeNode> parent, F work) {
+      auto node = new CollectiveTreeNode{ 1, parent, nullptr };
+      node->remaining += tree_collective_forward<Spawn>(origin, make_global(node), work);
+      run_tree_collective_work<Spawn>(node, work);
+    }
+    
+    /// Broadcast `work` from this core down the tree and block until every core is done.
+    template< bool Spawn, typename F >
+    void tree_collective(F work) {
+      CompletionEvent ce(1);
+      CollectiveTreeNode root{ 1, make_global((CollectiveTreeNode*)nullptr), &ce };
+      root.remaining += tree_collective_forward<Spawn>(mycore(), make_global(&root), work);
+      run_tree_collective_work<Spawn>(&root, work);
+      ce.wait();
+    }
+    
+  } // namespace impl
+  
   /// Call message (work that cannot block) on all cores, block until ack received from all.
   /// Like Grappa::on_all_cores() but does @a not spawn tasks on each core.
   /// Can safely be called concurrently with others.
+  ///
+  /// Work is broadcast down a tree (see --collective_tree_fanout) rather than
+  /// sent to each core from the caller, so the caller's cost doesn't grow
+  /// with the number of cores.
   template<typename F>
   void call_on_all_cores(F work) {
-    Core origin = mycore();
-    CompletionEvent ce(cores()-1);
-    
-    auto lsz = [&ce,origin,work]{};
-    
-    for (Core c = 0; c < cores(); c++) if (c != mycore()) {
-      send_heap_message(c, [&ce, origin, work] {
-        work();
-        send_heap_message(origin, [&ce]{ ce.complete(); });
-      });
-    }
-    work(); // do my core's work
-    ce.wait();
+    impl::tree_collective<false>(work);
   }
   
   /// Spawn a private task on each core, block until all complete.
@@ -111,21 +190,7 @@ namespace Grappa {
   /// @endcode
   template<typename F>
   void on_all_cores(F work) {
-    
-    CompletionEvent ce(cores());
-    auto ce_addr = make_global(&ce);
-    
-    auto lsz = [ce_addr,work]{};
-    
-    for (Core c = 0; c < cores(); c++) {
-      send_heap_message(c, [ce_addr, work] {
-        spawn([ce_addr, work] {
-          work();
-          complete(ce_addr);
-        });
-      });
-    }
-    ce.wait();
+    impl::tree_collective<true>(work);
   }
   
   namespace impl {
@@ -163,6 +228,50 @@ namespace Grappa {
       }
     }
     
+    enum class BuiltinOp { None, Add, Mult, Max, Min };
+    
+    /// Which built-in collective op (if any) ReduceOp is, for arithmetic types.
+    template< typename T, T (*ReduceOp)(const T&, const T&), bool Arithmetic = std::is_arithmetic<T>::value >
+    struct BuiltinOpOf {
+      static constexpr BuiltinOp value = BuiltinOp::None;
+    };
+    template< typename T, T (*ReduceOp)(const T&, const T&) >
+    struct BuiltinOpOf<T,ReduceOp,true> {
+      static constexpr BuiltinOp value =
+          (ReduceOp == &collective_add<T>)  ? BuiltinOp::Add
+        : (ReduceOp == &collective_mult<T>) ? BuiltinOp::Mult
+        : (ReduceOp == &collective_max<T>)  ? BuiltinOp::Max
+        : (ReduceOp == &collective_min<T>)  ? BuiltinOp::Min
+        : BuiltinOp::None;
+    };
+    
+    /// Elementwise `total[i] = ReduceOp(total[i], in[i])`. Built-in ops on arithmetic
+    /// types get plain loops over non-aliased arrays so the compiler vectorizes them.
+    template< typename T, T (*ReduceOp)(const T&, const T&) >
+    struct LocalReduce {
+      template< BuiltinOp Op > using Tag = std::integral_constant<BuiltinOp,Op>;
+      
+      static void apply(T * __restrict__ total, const T * __restrict__ in, size_t n, Tag<BuiltinOp::None>) {
+        for (size_t i=0; i<n; i++) total[i] = ReduceOp(total[i], in[i]);
+      }
+      static void apply(T * __restrict__ total, const T * __restrict__ in, size_t n, Tag<BuiltinOp::Add>) {
+        for (size_t i=0; i<n; i++) total[i] += in[i];
+      }
+      static void apply(T * __restrict__ total, const T * __restrict__ in, size_t n, Tag<BuiltinOp::Mult>) {
+        for (size_t i=0; i<n; i++) total[i] *= in[i];
+      }
+      static void apply(T * __restrict__ total, const T * __restrict__ in, size_t n, Tag<BuiltinOp::Max>) {
+        for (size_t i=0; i<n; i++) total[i] = (in[i] > total[i]) ? in[i] : total[i];
+      }
+      static void apply(T * __restrict__ total, const T * __restrict__ in, size_t n, Tag<BuiltinOp::Min>) {
+        for (size_t i=0; i<n; i++) total[i] = (in[i] < total[i]) ? in[i] : total[i];
+      }
+      
+      static void apply(T * total, const T * in, size_t n) {
+        apply(total, in, n, Tag<BuiltinOpOf<T,ReduceOp>::value>());
+      }
+    };
+    
     template<typename T, T (*ReduceOp)(const T&, const T&) >
     class InplaceReduction {
     protected:
@@ -170,10 +279,83 @@ namespace Grappa {
       T * array;
       Core elems_in = 0;
       size_t nelem;
+      
+      /// ring allreduce: chunks received so far for each step, and where the caller waits for them
+      std::vector<size_t> ring_received;
+      bool ring_delivered;
+      ConditionVariable ring_cv;
+      
+      size_t segment_begin(int64_t s) const {
+        return static_cast<size_t>( (__int128)nelem * s / cores() );
+      }
+      
+      static size_t chunks(size_t n) {
+        size_t n_per_msg = MAX_MESSAGE_SIZE / sizeof(T);
+        return n / n_per_msg + (n % n_per_msg ? 1 : 0);
+      }
+      
+      /// Reduce-scatter followed by allgather around a ring of cores. Over 2(P-1) steps,
+      /// each core sends the segment it completed in the previous step on to the next
+      /// core, so every core sends and receives about 2N elements in total
+      /// regardless of P, and no core is a hot spot.
+      ///
+      /// Sending straight out of the array is safe: a segment we send is only overwritten
+      /// again after the data has gone all the way around the ring, which can't
+      /// happen before our message has been delivered.
+      void ring_allreduce() {
+        const Core P = cores();
+        const Core next = (mycore() + 1) % P;
+        const size_t n_per_msg = MAX_MESSAGE_SIZE / sizeof(T);
+        
+        for (int64_t s = 0; s < 2*(P-1); s++) {
+          int64_t seg = ((mycore() - s) % P + P) % P;
+          size_t begin = segment_begin(seg), end = segment_begin(seg+1);
+          
+          for (size_t k = begin; k < end; k += n_per_msg) {
+            size_t this_nelem = std::min(n_per_msg, end-k);
+            send_heap_message(next, [this,k,s,P](void * payload, size_t payload_size) {
+              auto in = static_cast<T*>(payload);
+              auto in_n = payload_size/sizeof(T);
+              if (s < P-1) {
+                LocalReduce<T,ReduceOp>::apply(this->array+k, in, in_n); // reduce-scatter
+              } else {
+                std::copy(in, in+in_n, this->array+k);                   // allgather
+              }
+              this->ring_received[s]++;
+              broadcast(&this->ring_cv);
+            }, (void*)(array+k), sizeof(T)*this_nelem);
+          }
+          
+          // wait for the segment we'll forward in the next step
+          int64_t in_seg = ((mycore() - 1 - s) % P + P) % P;
+          size_t expected = chunks( segment_begin(in_seg+1) - segment_begin(in_seg) );
+          while (ring_received[s] < expected) Grappa::wait(&ring_cv);
+        }
+        
+        // don't return (letting the caller touch the array) until the next core has
+        // everything we sent it
+        Core prev = (mycore() + P - 1) % P;
+        send_heap_message(prev, [this]{
+          this->ring_delivered = true;
+          broadcast(&this->ring_cv);
+        });
+        while (!ring_delivered) Grappa::wait(&ring_cv);
+      }
+      
     public:      
       /// SPMD, must be called on static/file-global object on all cores
       /// blocks until reduction is complete
       void call_allreduce(T * in_array, size_t nelem) {
+        if (cores() > 2 && static_cast<int64_t>(nelem * sizeof(T)) >= FLAGS_allreduce_ring_threshold) {
+          this->array = in_array;
+          this->nelem = nelem;
+          ring_received.assign(2*(cores()-1), 0);
+          ring_delivered = false;
+          barrier(); // everyone must be set up before data starts arriving
+          ring_allreduce();
+          return;
+        }
+        
         // setup everything (block to make sure HOME_CORE is done)
         this->array = in_array;
         this->nelem = nelem;
@@ -197,11 +379,7 @@ namespace Grappa {
       
               auto in_array = static_cast<T*>(payload);
               auto in_n = payload_size/sizeof(T);
-              auto total = this->array+k;
-      
-              for (size_t i=0; i<in_n; i++) {
-                total[i] = ReduceOp(total[i], in_array[i]);
-              }
+              LocalReduce<T,ReduceOp>::apply(this->array+k, in_array, in_n);
               DVLOG(3) << "incrementing HOME sem, now at " << ce->get_count();      
               this->ce->complete();
             }, (void*)(in_array+k), sizeof(T)*this_nelem);
@@ -242,6 +420,193 @@ namespace Grappa {
       }
     };
     
+    /// Growable scratch array in the locale shared heap, so it can be a message payload.
+    /// Never shrinks; the memory is kept for reuse for the life of the program.
+    template< typename T >
+    class LocaleBuffer {
+      T * p = nullptr;
+      size_t capacity = 0;
+    public:
+      void resize(size_t n) {
+        if (n > capacity) {
+          if (p) locale_free(p);
+          p = locale_alloc<T>(n);
+          capacity = n;
+        }
+      }
+      T& operator[](size_t i) { return p[i]; }
+      T * data() { return p; }
+    };
+    
+    /// Two-level scan across cores. Each core sends its array to the first core of its
+    /// locale, which scans across that locale's cores. The locale totals are then scanned
+    /// on HOME_CORE (the first core of locale 0), and each locale's offset and the grand
+    /// total are sent back down the same path. Only one message per locale crosses the
+    /// network in each direction.
+    template< typename T, T (*ReduceOp)(const T&, const T&) >
+    class Scan {
+    protected:
+      T * array;
+      T * totals;
+      size_t nelem;
+      bool inclusive;
+      
+      LocaleBuffer<T> staged;     ///< others: copy of the input array to send to the leader
+      LocaleBuffer<T> gathered;   ///< leaders: arrays of this locale's cores, then their inclusive scan
+      LocaleBuffer<T> locales_in; ///< HOME_CORE: locale totals, then their inclusive scan
+      std::vector<Core> leaders;  ///< HOME_CORE: first core of each locale
+      LocaleBuffer<T> from_home;  ///< leaders: offset of this locale, then grand total
+      LocaleBuffer<T> out;        ///< leaders: results (then totals) for each of this locale's cores
+      CompletionEvent gather_ce, home_ce, offset_ce, result_ce, ack_ce;
+      
+      static size_t chunks(size_t n) {
+        size_t n_per_msg = MAX_MESSAGE_SIZE / sizeof(T);
+        return n / n_per_msg + (n % n_per_msg ? 1 : 0);
+      }
+      
+      /// Send `n` elements from `data` to `dest` in as many messages as needed; at
+      /// `dest`, `f(k, in, in_n)` is called with each piece and the index of its first element.
+      /// `data` is read when messages are sent, so must stay untouched until acknowledged.
+      template< typename F >
+      static void send_chunked(Core dest, const T * data, size_t n, F f) {
+        size_t n_per_msg = MAX_MESSAGE_SIZE / sizeof(T);
+        for (size_t k=0; k<n; k+=n_per_msg) {
+          size_t this_nelem = std::min(n_per_msg, n-k);
+          send_heap_message(dest, [f,k](void * payload, size_t payload_size) {
+            f(k, static_cast<T*>(payload), payload_size/sizeof(T));
+          }, (void*)(data+k), sizeof(T)*this_nelem);
+        }
+      }
+      
+      /// results for core `j` of this locale into `o` (nelem results, then nelem totals)
+      void finish_core(Core j, T * o) {
+        const T * mine = &gathered[j*nelem];
+        const T * before = (j > 0) ? &gathered[(j-1)*nelem] : nullptr;
+        bool has_offset = (mylocale() > 0);
+        const T * offset = &from_home[0];
+        for (size_t i=0; i<nelem; i++) {
+          const T * prev = inclusive ? mine : before;
+          if (prev && has_offset) o[i] = ReduceOp(offset[i], prev[i]);
+          else if (prev)          o[i] = prev[i];
+          else if (has_offset)    o[i] = offset[i];
+          else                    o[i] = T();
+        }
+        std::copy(from_home.data()+nelem, from_home.data()+2*nelem, o+nelem);
+      }
+      
+      void store_result(size_t k, const T * in, size_t in_n) {
+        for (size_t i=0; i<in_n; i++) {
+          if (k+i < nelem) array[k+i] = in[i];
+          else if (totals) totals[k+i-nelem] = in[i];
+        }
+      }
+      
+    public:
+      /// SPMD, must be called on static/file-global object on all cores;
+      /// blocks until the scan is complete
+      void call_scan(T * in_array, size_t n, bool incl, T * out_totals) {
+        this->array = in_array;
+        this->totals = out_totals;
+        this->nelem = n;
+        this->inclusive = incl;
+        
+        const Core lc = locale_cores();
+        const Core leader = mycore() - locale_mycore();
+        const bool is_leader = (locale_mycore() == 0);
+        const bool is_home = is_leader && (mylocale() == 0);
+        CHECK(!is_home || mycore() == HOME_CORE);
+        
+        if (is_leader) {
+          gathered.resize(lc*n);
+          from_home.resize(2*n);
+          out.resize(lc*2*n);
+          gather_ce.enroll( chunks(n)*(lc-1) );
+          offset_ce.enroll( is_home ? 0 : 2*chunks(n) );
+          ack_ce.enroll( (lc-1) + (is_home ? locales()-1 : 0) );
+        }
+        if (is_home) {
+          locales_in.resize(locales()*n);
+          leaders.resize(locales());
+          home_ce.enroll( chunks(n)*(locales()-1) );
+        }
+        if (!is_leader) {
+          staged.resize(n);
+          std::copy(array, array+n, staged.data());
+        }
+        result_ce.enroll( is_leader ? 0 : chunks(2*n) );
+        barrier(); // everyone must be set up before data starts arriving
+        
+        if (!is_leader) {
+          Core j = locale_mycore();
+          send_chunked(leader, staged.data(), n, [this,j](size_t k, const T * in, size_t in_n) {
+            std::copy(in, in+in_n, &this->gathered[j*this->nelem+k]);
+            this->gather_ce.complete();
+          });
+          result_ce.wait();
+          send_heap_message(leader, [this]{ this->ack_ce.complete(); });
+          return;
+        }
+        
+        // scan across this locale's cores
+        std::copy(array, array+n, gathered.data());
+        gather_ce.wait();
+        for (Core j=1; j<lc; j++) {
+          T * cur = &gathered[j*n];
+          const T * prev = &gathered[(j-1)*n];
+          for (size_t i=0; i<n; i++) cur[i] = ReduceOp(prev[i], cur[i]);
+        }
+        const T * locale_total = &gathered[(lc-1)*n];
+        
+        if (is_home) {
+          // scan across locales, then send each its offset and the grand total
+          std::copy(locale_total, locale_total+n, locales_in.data());
+          home_ce.wait();
+          for (Locale l=1; l<locales(); l++) {
+            T * cur = &locales_in[l*n];
+            const T * prev = &locales_in[(l-1)*n];
+            for (size_t i=0; i<n; i++) cur[i] = ReduceOp(prev[i], cur[i]);
+          }
+          const T * grand_total = &locales_in[(locales()-1)*n];
+          std::copy(grand_total, grand_total+n, &from_home[n]);
+          for (Locale l=1; l<locales(); l++) {
+            send_chunked(leaders[l], &locales_in[(l-1)*n], n, [this](size_t k, const T * in, size_t in_n){
+              std::copy(in, in+in_n, &this->from_home[k]);
+              this->offset_ce.complete();
+            });
+            send_chunked(leaders[l], grand_total, n, [this](size_t k, const T * in, size_t in_n){
+              std::copy(in, in+in_n, &this->from_home[this->nelem+k]);
+              this->offset_ce.complete();
+            });
+          }
+        } else {
+          Locale l = mylocale();
+          Core me = mycore();
+          send_chunked(HOME_CORE, locale_total, n, [this,l,me](size_t k, const T * in, size_t in_n){
+            std::copy(in, in+in_n, &this->locales_in[l*this->nelem+k]);
+            this->leaders[l] = me;
+            this->home_ce.complete();
+          });
+          offset_ce.wait();
+          send_heap_message(HOME_CORE, [this]{ this->ack_ce.complete(); });
+        }
+        
+        // hand results back to this locale's cores
+        for (Core j=1; j<lc; j++) {
+          T * o = &out[j*2*n];
+          finish_core(j, o);
+          send_chunked(leader+j, o, 2*n, [this](size_t k, const T * in, size_t in_n){
+            this->store_result(k, in, in_n);
+            this->result_ce.complete();
+          });
+        }
+        finish_core(0, &out[0]);
+        store_result(0, &out[0], 2*n);
+        
+        // don't let the next scan reuse buffers until everything sent from them has arrived
+        ack_ce.wait();
+      }
+    };
+    
   } // namespace impl
   
   /// Called from SPMD context, reduces values from all cores calling `allreduce` and returns reduced
@@ -272,6 +637,9 @@ namespace Grappa {
   /// Do an in-place allreduce (works on arrays). All elements of the array will be 
   /// overwritten by the operation with the total from all cores.
   ///
+  /// The array is sent from directly, so it must be in the locale shared heap
+  /// (allocated with locale_alloc(), or on a task's stack).
+  ///
   /// @warning May only one with a given type/op combination may be used at a time,
   ///          uses a function-private static variable.
   template< typename T, T (*ReduceOp)(const T&, const T&) >
@@ -280,6 +648,98 @@ namespace Grappa {
     reducer.call_allreduce(array, nelem);
   }
   
+  /// Called from SPMD context. Elementwise exclusive scan across cores, in place: afterwards
+  /// `array[i]` on core `c` holds the reduction of `array[i]` over cores `0..c-1` (and
+  /// core 0 gets `T()`). If `totals` is given, it receives the reduction over all cores,
+  /// as from allreduce_inplace(). Done in two levels (within each locale, then across
+  /// locales), so the cost on any one core grows with the number of locales rather
+  /// than cores.
+  ///
+  /// @warning Only one with a given type/op combination may be used at a time,
+  ///          uses a function-private static variable.
+  template< typename T, T (*ReduceOp)(const T&, const T&) >
+  void exclusive_scan_inplace(T * array, size_t nelem = 1, T * totals = nullptr) {
+    static impl::Scan<T,ReduceOp> scanner;
+    scanner.call_scan(array, nelem, false, totals);
+  }
+  
+  /// Called from SPMD context. Like exclusive_scan_inplace(), but core `c` gets the
+  /// reduction over cores `0..c`.
+  template< typename T, T (*ReduceOp)(const T&, const T&) >
+  void inclusive_scan_inplace(T * array, size_t nelem = 1, T * totals = nullptr) {
+    static impl::Scan<T,ReduceOp> scanner;
+    scanner.call_scan(array, nelem, true, totals);
+  }
+  
+  /// Called from SPMD context, returns the reduction of `myval` over cores before this
+  /// one (`T()` on core 0).
+  ///
+  /// @b Example:
+  /// @code
+  ///   Grappa::on_all_cores([]{
+  ///     // where this core's items start in a global numbering
+  ///     int64_t first = Grappa::exclusive_scan<int64_t,collective_add>(local_items.size());
+  ///   });
+  /// @endcode
+  template< typename T, T (*ReduceOp)(const T&, const T&) >
+  T exclusive_scan(T myval) {
+    exclusive_scan_inplace<T,ReduceOp>(&myval, 1);
+    return myval;
+  }
+  
+  /// Called from SPMD context, returns the reduction of `myval` over cores up to and
+  /// including this one.
+  template< typename T, T (*ReduceOp)(const T&, const T&) >
+  T inclusive_scan(T myval) {
+    inclusive_scan_inplace<T,ReduceOp>(&myval, 1);
+    return myval;
+  }
+  
+  /// Called from SPMD context with this core's histogram `counts[0..nbuckets)`. Computes,
+  /// in `offsets`, where this core's elements of each bucket start if all buckets are laid
+  /// out in order with each bucket's elements in core order:
+  ///   `offsets[b] = sum(all cores' counts[0..b)) + sum(counts[b] on cores before this one)`
+  /// Optionally also gets the total count of each bucket (`totals`) and where each bucket
+  /// starts (`starts`). Any of the outputs may be null, and one of `offsets` or `totals`
+  /// may be `counts` itself; if only `totals` and `starts` are wanted this is just an allreduce.
+  ///
+  /// @b Example:
+  /// @code
+  ///   // bucket sort: scatter keys to their final positions in one pass
+  ///   Grappa::on_all_cores([]{
+  ///     for (auto k : local_keys) counts[bucket(k)]++;
+  ///     Grappa::bucket_offsets(&counts[0], &offsets[0], nbuckets);
+  ///     for (auto k : local_keys) delegate::write<async>(sorted + offsets[bucket(k)]++, k);
+  ///   });
+  /// @endcode
+  template< typename T >
+  void bucket_offsets(const T * counts, T * offsets, size_t nbuckets,
+                      T * totals = nullptr, T * starts = nullptr) {
+    std::vector<T> tmp_totals;
+    if (!totals) {
+      tmp_totals.resize(nbuckets);
+      totals = &tmp_totals[0];
+    }
+    if (offsets) {
+      if (offsets != counts) std::copy(counts, counts+nbuckets, offsets);
+      exclusive_scan_inplace<T,collective_add>(offsets, nbuckets, totals);
+    } else {
+      // (allreduce_inplace sends straight from its array, which must be in the locale heap)
+      T * tmp = locale_alloc<T>(nbuckets);
+      std::copy(counts, counts+nbuckets, tmp);
+      allreduce_inplace<T,collective_add>(tmp, nbuckets);
+      std::copy(tmp, tmp+nbuckets, totals);
+      locale_free(tmp);
+    }
+    
+    T before = T();
+    for (size_t b=0; b<nbuckets; b++) {
+      if (offsets) offsets[b] += before;
+      if (starts) starts[b] = before;
+      before += totals[b];
+    }
+  }
+  
   /// Called from a single task (usually user_main), reduces values from all cores onto the calling node.
   /// Blocks until reduction is complete.
   /// Safe to use any number of these concurrently.
@@ -25,17 +25,24 @@
 #include "Grappa.hpp"
 #include "Communicator.hpp"
 #include "Collective.hpp"
+#include "AllToAll.hpp"
 #include "GlobalAllocator.hpp"
 #include "Addressing.hpp"
 
 // Tests the functions in Collective.hpp
 
+DEFINE_int64( collective_latency_iters, 100, "Iterations of each collective to time in latency benchmark" );
+
+DECLARE_int64( collective_tree_fanout );
+
 BOOST_AUTO_TEST_SUITE( Collective_tests );
 
 using namespace Grappa;
 
 static int global_x;
 
+GlobalCompletionEvent async_gce;
+
 struct TestObj {
   int64_t ignore;
   int64_t c;
@@ -49,6 +56,39 @@ int64_t accessObj(GlobalAddress<TestObj> g) {
   return g->c;
 }
 
+/// Time on_all_cores/call_on_all_cores for flat and tree broadcasts. Each
+/// line reports cores and per-call latency, so running at several core
+/// counts gives latency-vs-cores curves.
+void collective_latency() {
+  int64_t saved_fanout = FLAGS_collective_tree_fanout;
+  for (int64_t fanout : { (int64_t)0, (int64_t)2, (int64_t)8 }) {
+    call_on_all_cores([fanout]{ FLAGS_collective_tree_fanout = fanout; });
+    
+    Grappa::call_on_all_cores([]{ global_x = 0; });
+    double start = Grappa::walltime();
+    for (int64_t i = 0; i < FLAGS_collective_latency_iters; i++) {
+      Grappa::call_on_all_cores([]{ global_x++; });
+    }
+    double call_latency = (Grappa::walltime() - start) / FLAGS_collective_latency_iters;
+    BOOST_CHECK_EQUAL( Grappa::sum_all_cores([]{ return global_x; }),
+                       FLAGS_collective_latency_iters * Grappa::cores() );
+    
+    start = Grappa::walltime();
+    for (int64_t i = 0; i < FLAGS_collective_latency_iters; i++) {
+      Grappa::on_all_cores([]{ global_x++; });
+    }
+    double on_latency = (Grappa::walltime() - start) / FLAGS_collective_latency_iters;
+    BOOST_CHECK_EQUAL( Grappa::sum_all_cores([]{ return global_x; }),
+                       2 * FLAGS_collective_latency_iters * Grappa::cores() );
+    
+    LOG(INFO) << "collective_latency: cores " << Grappa::cores()
+              << ", fanout " << fanout
+              << ", call_on_all_cores " << call_latency * 1e6 << " us"
+              << ", on_all_cores " << on_latency * 1e6 << " us";
+  }
+  call_on_all_cores([saved_fanout]{ FLAGS_collective_tree_fanout = saved_fanout; });
+}
+
 BOOST_AUTO_TEST_CASE( test1 ) {
   Grappa::init( GRAPPA_TEST_ARGS );
   Grappa::run([]{
@@ -101,11 +141,113 @@ BOOST_AUTO_TEST_CASE( test1 ) {
       for (int i=0; i<N; i++) BOOST_CHECK_EQUAL(xs[i], Grappa::cores() * i);
     });
     
+    BOOST_MESSAGE("testing ring allreduce_inplace");
+    Grappa::on_all_cores([]{
+      // large enough to go around the ring, and not a multiple of cores or message size
+      const size_t N = 100003;
+      // (sent straight from the arrays, so they must be in the locale heap)
+      double * xs = Grappa::locale_alloc<double>(N);
+      int64_t * ys = Grappa::locale_alloc<int64_t>(N);
+      for (size_t i=0; i<N; i++) {
+        xs[i] = i;
+        ys[i] = 7*i + Grappa::mycore();
+      }
+      
+      Grappa::allreduce_inplace<double,collective_add>(xs, N);
+      Grappa::allreduce_inplace<int64_t,collective_max>(ys, N);
+      
+      size_t wrong = 0;
+      for (size_t i=0; i<N; i++) {
+        if (xs[i] != (double)Grappa::cores() * i) wrong++;
+        if (ys[i] != (int64_t)(7*i) + Grappa::cores() - 1) wrong++;
+      }
+      BOOST_CHECK_EQUAL(wrong, 0);
+      Grappa::locale_free(xs);
+      Grappa::locale_free(ys);
+    });
+    
+    BOOST_MESSAGE("testing allreduce_async/barrier_async");
+    Grappa::on_all_cores([]{
+      // several in flight at once, completed out of order
+      auto a = Grappa::allreduce_async<int,collective_add>(1);
+      auto b = Grappa::allreduce_async<int,collective_max>(Grappa::mycore());
+      auto c = Grappa::allreduce_async<int,collective_add>(Grappa::mycore());
+      auto bar = Grappa::barrier_async();
+      BOOST_CHECK_EQUAL(c.get(), Grappa::cores()*(Grappa::cores()-1)/2);
+      BOOST_CHECK_EQUAL(b.get(), Grappa::cores()-1);
+      BOOST_CHECK_EQUAL(a.get(), Grappa::cores());
+      bar.wait();
+      
+      // composed with a GCE: waiting on the GCE covers the reduction too
+      auto d = Grappa::allreduce_async<int,collective_add>(2, &async_gce);
+      async_gce.wait();
+      BOOST_CHECK(d.ready());
+      BOOST_CHECK_EQUAL(d.get(), 2*Grappa::cores());
+    });
+    
+    BOOST_MESSAGE("testing scans");
+    Grappa::on_all_cores([]{
+      int64_t me = Grappa::mycore(), n = Grappa::cores();
+      BOOST_CHECK_EQUAL((Grappa::exclusive_scan<int64_t,collective_add>(me+1)), me*(me+1)/2);
+      BOOST_CHECK_EQUAL((Grappa::inclusive_scan<int64_t,collective_add>(me+1)), (me+1)*(me+2)/2);
+      BOOST_CHECK_EQUAL((Grappa::inclusive_scan<int64_t,collective_max>(n-me)), n);
+      
+      // vector-valued, longer than a message
+      const size_t N = 5000;
+      std::vector<int64_t> xs(N), totals(N);
+      for (size_t i=0; i<N; i++) xs[i] = i + me;
+      Grappa::exclusive_scan_inplace<int64_t,collective_add>(xs.data(), N, totals.data());
+      size_t wrong = 0;
+      for (size_t i=0; i<N; i++) {
+        if (xs[i] != (int64_t)i*me + me*(me-1)/2) wrong++;
+        if (totals[i] != (int64_t)i*n + n*(n-1)/2) wrong++;
+      }
+      BOOST_CHECK_EQUAL(wrong, 0);
+      
+      // histogram offsets: core c has c+1 elements in each bucket
+      const size_t B = 10;
+      std::vector<int64_t> counts(B, me+1), offsets(B);
+      Grappa::bucket_offsets(counts.data(), offsets.data(), B);
+      for (size_t b=0; b<B; b++) {
+        BOOST_CHECK_EQUAL(offsets[b], (int64_t)b*n*(n+1)/2 + me*(me+1)/2);
+      }
+    });
+    
+    BOOST_MESSAGE("testing alltoallv");
+    Grappa::on_all_cores([]{
+      int64_t me = Grappa::mycore(), n = Grappa::cores();
+      // a small window, so senders have to wait for slots to be freed
+      auto window = FLAGS_alltoallv_window_bytes;
+      FLAGS_alltoallv_window_bytes = 4 * MAX_MESSAGE_SIZE;
+      
+      // core s sends (s+1)*(d+1)*1000 elements to core d, each encoding (s,d,i)
+      std::vector<std::vector<int64_t>> out(n);
+      for (int64_t d = 0; d < n; d++) {
+        for (int64_t i = 0; i < (me+1)*(d+1)*1000; i++) out[d].push_back((me*n + d) * 1000000 + i);
+      }
+      std::vector<size_t> recv_counts;
+      auto in = Grappa::alltoallv(out, &recv_counts);
+      
+      size_t wrong = 0, k = 0;
+      for (int64_t s = 0; s < n; s++) {
+        BOOST_CHECK_EQUAL(recv_counts[s], (s+1)*(me+1)*1000);
+        for (size_t i = 0; i < recv_counts[s]; i++, k++) {
+          if (in[k] != (int64_t)((s*n + me) * 1000000 + i)) wrong++;
+        }
+      }
+      BOOST_CHECK_EQUAL(k, in.size());
+      BOOST_CHECK_EQUAL(wrong, 0);
+      FLAGS_alltoallv_window_bytes = window;
+    });
+    
     Grappa::call_on_all_cores([]{ global_x = 1; });
     
     auto total = Grappa::sum_all_cores([]{ return global_x; });
     CHECK_EQ(total, cores());
     
+    BOOST_MESSAGE("timing broadcast collectives");
+    collective_latency();
+    
   });
   Grappa::finalize();
 }
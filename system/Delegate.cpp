@@ -51,3 +51,6 @@ GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, delegate_cmpswaps, 0);
 GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, delegate_cmpswap_targets, 0);
 GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, delegate_fetchadds, 0);
 GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, delegate_fetchadd_targets, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, delegate_atomics, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, delegate_atomic_locale_ops, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, delegate_atomic_batch_messages, 0);
@@ -71,7 +71,7 @@ namespace Grappa {
 
   template< typename T >
     ExternalCountPayloadMessage<T> * send_heap_message( Core dest, T t, void * payload, size_t payload_size, uint64_t * count ) {
-      void * p = Grappa::impl::locale_shared_memory.allocate_aligned( sizeof(ExternalCountPayloadMessage<T>), 8 );
+      void * p = Grappa::impl::locale_shared_memory.allocate_aligned( sizeof(ExternalCountPayloadMessage<T>), 8, Grappa::impl::MemoryCategory::MessagePool );
       auto m = new (p) ExternalCountPayloadMessage<T>( dest, t, payload, payload_size, count );
       m->delete_after_send(); 
       m->enqueue();
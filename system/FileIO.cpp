@@ -1,8 +1,15 @@
 
 #include <map>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "FileIO.hpp"
 
 DEFINE_bool( optimize_for_lustre, true, "Set MPI IO flags for faster Lustre performance" );
+DEFINE_bool( io_local_ingest, true, "In read_array, have each core read the file ranges backing its own blocks in place, rather than reading blocks anywhere and scattering them" );
+
+GRAPPA_DEFINE_METRIC(SimpleMetric<double>, read_rate_mbps, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, io_local_bytes_read, 0);
 
 
 namespace Grappa {
@@ -247,6 +254,64 @@ void write_unordered_shared( const char * filename, void * local_ptr, size_t siz
   MPI_CHECK( MPI_File_close( &outfile ) );
 }
 
+size_t read_local_bytes( const char * fname, size_t file_offset, GlobalAddress<char> begin, size_t nbytes ) {
+  char * lo = begin.localize();
+  char * hi = (begin + nbytes).localize();
+  if( lo >= hi ) return 0;
+  
+  int fd = open( fname, O_RDONLY );
+  CHECK( fd != -1 ) << "Error opening file for read only: " << fname;
+  
+  // touching a mapped page past the end of the file raises SIGBUS
+  struct stat st;
+  CHECK( fstat( fd, &st ) == 0 ) << "Error getting size of " << fname;
+  CHECK_GE( static_cast< size_t >( st.st_size ), file_offset + nbytes )
+    << "Reading past the end of " << fname;
+  
+  // Map the whole range: a locale's cores share the page cache, so each
+  // page comes off disk once per node even though every core touches it.
+  size_t page = sysconf( _SC_PAGESIZE );
+  size_t map_start = file_offset / page * page;
+  size_t map_len = file_offset + nbytes - map_start;
+  char * map = static_cast< char * >( mmap( nullptr, map_len, PROT_READ, MAP_SHARED, fd, map_start ) );
+  
+  auto copy = [=]( char * dst, size_t foff, size_t n ) {
+    if( map != MAP_FAILED ) {
+      memcpy( dst, map + (foff - map_start), n );
+    } else {
+      while( n > 0 ) {
+        ssize_t r = pread( fd, dst, n, foff );
+        CHECK( r > 0 ) << "Error reading " << fname << " at " << foff;
+        dst += r; foff += r; n -= r;
+      }
+    }
+  };
+  
+  // Local memory holds this core's blocks in order; walk it block by block,
+  // merging blocks that are also adjacent in the file into one copy.
+  Distribution d = begin.distribution();
+  size_t bs = begin.block_bytes();
+  char * run_dst = nullptr;
+  size_t run_foff = 0, run_len = 0;
+  for( char * p = lo; p < hi; ) {
+    size_t in_block = ( p - static_cast< char * >( global_memory_chunk_base ) ) % bs;
+    size_t n = std::min< size_t >( bs - in_block, hi - p );
+    size_t foff = file_offset + ( GlobalAddress<char>::Linear( p, d ) - begin );
+    if( run_len > 0 && run_dst + run_len == p && run_foff + run_len == foff ) {
+      run_len += n;
+    } else {
+      if( run_len > 0 ) copy( run_dst, run_foff, run_len );
+      run_dst = p; run_foff = foff; run_len = n;
+    }
+    p += n;
+  }
+  if( run_len > 0 ) copy( run_dst, run_foff, run_len );
+  
+  if( map != MAP_FAILED ) munmap( map, map_len );
+  close( fd );
+  return hi - lo;
+}
+
 } // namespace impl
 
 } // namespace Grappa
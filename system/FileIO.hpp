@@ -36,6 +36,8 @@
 #include "Tasking.hpp"
 #include "ParallelLoop.hpp"
 #include "Cache.hpp"
+#include "Metrics.hpp"
+#include "IOEngine.hpp"
 
 #include <sys/stat.h>
 #include <iterator>
@@ -44,6 +46,10 @@ namespace fs = boost::filesystem;
 
 DECLARE_uint64( io_blocks_per_node );
 DECLARE_uint64( io_blocksize_mb );
+DECLARE_bool( io_local_ingest );
+
+GRAPPA_DECLARE_METRIC(SimpleMetric<double>, read_rate_mbps);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, io_local_bytes_read);
 
 namespace Grappa {
 
@@ -72,6 +78,12 @@ void read_unordered_shared( const char * filename, void * local_ptr, size_t loca
 /// call in a collective context
 void write_unordered_shared( const char * filename, void * local_ptr, size_t local_size );
 
+/// Read the bytes of global range [begin, begin+nbytes) that live on this
+/// core straight into place, from file `fname` starting at `file_offset`
+/// (which holds byte `begin`). Not collective; each core calls it for its
+/// own part. Returns the number of bytes read.
+size_t read_local_bytes( const char * fname, size_t file_offset, GlobalAddress<char> begin, size_t nbytes );
+
 }
   
 #ifdef SIGRTMIN
@@ -184,7 +196,7 @@ namespace impl {
   /// Special fopen so we can be sure to open files correctly for reading asynchronously
   inline FileDesc file_open(const char *const fname, const char *const mode) {
     if (strncmp(mode, "r", FNAME_LENGTH) == 0) {
-      int fdesc = open(fname, O_RDONLY);
+      int fdesc = io_open(fname, O_RDONLY);
       if (fdesc == -1) {
         //fprintf(stderr, "Error opening file for read only: %s.\n", fname);
         LOG(FATAL) << "Error opening file for read only: " << fname;
@@ -203,9 +215,21 @@ namespace impl {
 
 
   inline void fread_blocking(void * buffer, size_t bufsize, size_t offset, FileDesc file_desc) {
-    IODescriptor d(file_desc, offset, buffer, bufsize);
-    d.block_on_read();
-    CHECK(d.complete);
+    if (io_uring_enabled()) {
+      ssize_t r = io_read(file_desc, buffer, bufsize, offset);
+      CHECK_EQ(r, (ssize_t)bufsize) << "read failed: " << (r < 0 ? strerror(-r) : "short read");
+    } else {
+      IODescriptor d(file_desc, offset, buffer, bufsize);
+      d.block_on_read();
+      CHECK(d.complete);
+    }
+  }
+  
+  /// Write `bufsize` bytes at `offset`, suspending only the calling worker
+  /// (through the io_uring engine when it is enabled).
+  inline void fwrite_blocking(const void * buffer, size_t bufsize, size_t offset, FileDesc file_desc) {
+    ssize_t r = io_write(file_desc, buffer, bufsize, offset);
+    CHECK_EQ(r, (ssize_t)bufsize) << "write failed: " << (r < 0 ? strerror(-r) : "short write");
   }
 
   template < typename T >
@@ -249,7 +273,8 @@ namespace impl {
     double t = Grappa::walltime();
 
   	Grappa::call_on_all_cores([]{
-  	  Grappa::impl::global_scheduler.allow_active_workers(FLAGS_io_blocks_per_node);
+  	  // (io_uring requests are throttled by the ring depth instead)
+  	  if (!io_uring_enabled()) Grappa::impl::global_scheduler.allow_active_workers(FLAGS_io_blocks_per_node);
   	});
 
     const int64_t NBUF = FLAGS_io_blocksize_mb*(1L<<20)/sizeof(T);
@@ -273,13 +298,13 @@ namespace impl {
     io_joiner.wait();
   
   	Grappa::call_on_all_cores([]{
-  	  Grappa::impl::global_scheduler.allow_active_workers(-1);
+  	  if (!io_uring_enabled()) Grappa::impl::global_scheduler.allow_active_workers(-1);
   	});
 
     f.offset += nelem * sizeof(T);
     t = Grappa::walltime() - t;
     VLOG(1) << "read_array_time: " << t;
-    VLOG(1) << "read_rate_mbps: " << ((double)nelem * sizeof(T) / (1L<<20)) / t;
+    read_rate_mbps = ((double)nelem * sizeof(T) / (1L<<20)) / t;
   }
 
   template < typename T >
@@ -288,7 +313,8 @@ namespace impl {
     double t = Grappa::walltime();
 
   	Grappa::call_on_all_cores([]{
-  	  Grappa::impl::global_scheduler.allow_active_workers(FLAGS_io_blocks_per_node);
+  	  // (io_uring requests are throttled by the ring depth instead)
+  	  if (!io_uring_enabled()) Grappa::impl::global_scheduler.allow_active_workers(FLAGS_io_blocks_per_node);
   	});
 
     size_t nfiles = std::distance(fs::directory_iterator(dirname), fs::directory_iterator());
@@ -323,21 +349,62 @@ namespace impl {
     io_joiner.wait();
   
   	Grappa::call_on_all_cores([]{
-  	  Grappa::impl::global_scheduler.allow_active_workers(-1);
+  	  if (!io_uring_enabled()) Grappa::impl::global_scheduler.allow_active_workers(-1);
   	});
 
     t = Grappa::walltime() - t;
     VLOG(1) << "read_array_time: " << t;
-    VLOG(1) << "read_rate_mbps: " << ((double)nelem * sizeof(T) / (1L<<20)) / t;
+    read_rate_mbps = ((double)nelem * sizeof(T) / (1L<<20)) / t;
     locale_free(args);
   }
   
+  /// Read with every core pulling in only the file ranges backing its own
+  /// blocks (see read_local_bytes), so no data crosses between cores.
+  template < typename T >
+  void _read_array_local(File& f, GlobalAddress<T> array, size_t nelem) {
+    double t = Grappa::walltime();
+    
+    size_t namelen = strlen(f.fname);
+    auto g_name = make_global(f.fname);
+    bool isDirectory = f.isDirectory;
+    size_t offset = f.offset;
+    
+    Grappa::on_all_cores([g_name,namelen,isDirectory,offset,array,nelem]{
+      char fname[FNAME_LENGTH];
+      { Incoherent<char>::RO c(g_name, namelen+1, fname); c.block_until_acquired(); }
+      auto bytes = GlobalAddress<char>::Raw(array.raw_bits());
+      
+      if (!isDirectory) {
+        io_local_bytes_read += read_local_bytes(fname, offset, bytes, nelem*sizeof(T));
+      } else {
+        for (fs::directory_iterator d(fname); d != fs::directory_iterator(); d++) {
+          int64_t start, end;
+          array_dir_scan(d->path(), &start, &end);
+          CHECK( start < end && start < static_cast<int64_t>(nelem) && end <= static_cast<int64_t>(nelem)) << "nelem = " << nelem << ", start = " << start << ", end = " << end;
+          io_local_bytes_read += read_local_bytes(d->path().string().c_str(), 0,
+                                                  bytes + start*sizeof(T), (end-start)*sizeof(T));
+        }
+      }
+    });
+    
+    if (!f.isDirectory) f.offset += nelem * sizeof(T);
+    t = Grappa::walltime() - t;
+    VLOG(1) << "read_array_time: " << t;
+    read_rate_mbps = ((double)nelem * sizeof(T) / (1L<<20)) / t;
+  }
+  
 } // namespace impl
 
 /// Read a file or directory of files into a global array.
+///
+/// With --io_local_ingest (the default), each core reads the parts of the
+/// file that land in its own blocks directly into place; otherwise blocks of
+/// the file are read on whichever core and written out to their owners.
 template < typename T >
 void read_array(File& f, GlobalAddress<T> array, size_t nelem) {
-  if (f.isDirectory) {
+  if (FLAGS_io_local_ingest && array.is_linear()) {
+    impl::_read_array_local(f, array, nelem);
+  } else if (f.isDirectory) {
     impl::_read_array_dir(f, array, nelem);
   } else {
     impl::_read_array_file(f, array, nelem);
@@ -372,7 +439,8 @@ namespace impl {
       Incoherent<char>::RO c(g_dir,namelen+1,dir);
       
       char fname[FNAME_LENGTH]; array_dir_fname(fname, &c[0], r.start, r.end);
-      std::fstream fo(fname, std::ios::out | std::ios::binary);
+      FileDesc fo = io_open(fname, O_WRONLY | O_CREAT | O_TRUNC);
+      CHECK(fo != -1) << "Error opening file for writing: " << fname;
       
       VLOG(1) << "saving to " << fname;
       
@@ -382,12 +450,12 @@ namespace impl {
       for_buffered (i, n, r.start, r.end, NBUF) {
         typename Incoherent<T>::RO c(array+i, n, buf);
         c.block_until_acquired();
-        fo.write((char*)buf, sizeof(T)*n);
+        fwrite_blocking(buf, sizeof(T)*n, sizeof(T)*(i-r.start), fo);
         VLOG(1) << "wrote " << i << ".." << i+n << " (" << n << ")";
       }
           Grappa::locale_free(buf);
       
-      fo.close();
+      file_close(fo);
       VLOG(1) << "finished saving array[" << r.start << ":" << r.end << "]";
     });
 	
@@ -400,19 +468,20 @@ namespace impl {
   void _save_array_file(const char * fname, GlobalAddress<T> array, size_t nelems) {
     double t = Grappa::walltime();
 
-    std::fstream fo(fname, std::ios::out | std::ios::binary);
+    FileDesc fo = io_open(fname, O_WRONLY | O_CREAT | O_TRUNC);
+    CHECK(fo != -1) << "Error opening file for writing: " << fname;
 
     const int64_t NBUF = FLAGS_io_blocksize_mb*(1L<<20)/sizeof(T);
   	T * buf = Grappa::locale_alloc<T>(NBUF);
     for_buffered (i, n, 0, (int64_t)nelems, NBUF) {
       typename Incoherent<T>::RO c(array+i, n, buf);
       c.block_until_acquired();
-  	  fo.write((char*)buf, sizeof(T)*n);
+  	  fwrite_blocking(buf, sizeof(T)*n, sizeof(T)*i, fo);
     }
   	Grappa::locale_free(buf);
 
     t = Grappa::walltime() - t;
-    fo.close();
+    file_close(fo);
     VLOG(2) << "save_array_time: " << t;
     VLOG(2) << "save_rate_mbps: " << ((double)nelems * sizeof(T) / (1L<<20)) / t;
   }
@@ -136,6 +136,68 @@ void test_read_save_array(bool asDirectory) {
   if (fs::exists(fname)) { fs::remove_all(fname); }
 }
 
+/// Local ingest into non-default distributions, starting at an element that
+/// is not block aligned, from a file with a header to skip.
+void test_read_distributed(Distribution dist) {
+  char fname[256];
+  snprintf(fname, 256, "./fileio_tests_dist.%ld.bin", NN);
+  const int64_t header = 3, skip = 5;
+  {
+    std::vector<int64_t> v(header + NN);
+    for (int64_t i = 0; i < header + static_cast<int64_t>(NN); i++) v[i] = i - header;
+    std::ofstream fo(fname, std::ios::out | std::ios::binary);
+    fo.write((char*)v.data(), v.size()*sizeof(int64_t));
+  }
+  
+  auto a = global_alloc<int64_t>(NN + skip, dist);
+  Grappa::memset(a, -1, NN + skip);
+  Grappa::File f(fname, false, header*sizeof(int64_t));
+  read_array(f, a + skip, NN);
+  BOOST_CHECK_EQUAL(f.offset, (header + NN)*sizeof(int64_t));
+  
+  forall(a, NN + skip, [](int64_t i, int64_t& e){
+    BOOST_CHECK_EQUAL(e, i < skip ? -1 : i - skip);
+  });
+  
+  global_free(a);
+  if (fs::exists(fname)) { fs::remove_all(fname); }
+}
+
+/// Round trip through the I/O engine (io_uring if available, else
+/// pread/pwrite), including unaligned reads of an O_DIRECT file.
+void test_io_engine() {
+  LOG(INFO) << "io engine: " << (impl::io_uring_enabled() ? "io_uring" : "aio/pread");
+  char fname[256];
+  snprintf(fname, 256, "./fileio_tests_engine.%d.bin", mycore());
+  const size_t n = 3*(1L<<20)/sizeof(int64_t) + 17;   // several pieces, not aligned
+  std::vector<int64_t> out(n), in(n);
+  for (size_t i = 0; i < n; i++) out[i] = 3*i + 1;
+  
+  int fd = impl::io_open(fname, O_WRONLY | O_CREAT | O_TRUNC);
+  BOOST_CHECK(fd != -1);
+  BOOST_CHECK_EQUAL(impl::io_write(fd, out.data(), n*sizeof(int64_t), 0), n*sizeof(int64_t));
+  close(fd);
+  
+  for (bool direct : {false, true}) {
+    FLAGS_io_direct = direct;
+    fd = impl::io_open(fname, O_RDONLY);
+    BOOST_CHECK(fd != -1);
+    BOOST_CHECK_EQUAL(impl::io_read(fd, in.data(), n*sizeof(int64_t), 0), n*sizeof(int64_t));
+    BOOST_CHECK(in == out);
+    
+    // odd offset and length, and a read running past the end of the file
+    const size_t skip = 1001, len = 12345;
+    std::vector<int64_t> part(len);
+    BOOST_CHECK_EQUAL(impl::io_read(fd, part.data(), len*sizeof(int64_t), skip*sizeof(int64_t)), len*sizeof(int64_t));
+    BOOST_CHECK(std::equal(part.begin(), part.end(), out.begin() + skip));
+    BOOST_CHECK_EQUAL(impl::io_read(fd, part.data(), len*sizeof(int64_t), (n-10)*sizeof(int64_t)), 10*sizeof(int64_t));
+    BOOST_CHECK_EQUAL(part[9], out[n-1]);
+    close(fd);
+  }
+  FLAGS_io_direct = false;
+  remove(fname);
+}
+
 void test_unordered_collective_read() {
   // create test file to read from
   char fname[256];
@@ -222,15 +284,28 @@ BOOST_AUTO_TEST_CASE( test1 ) {
   Grappa::init( GRAPPA_TEST_ARGS );
   Grappa::run([]{
       test_single_read();
-    
+      
       sync();
-      LOG(INFO) << "testing file read/write";
-      test_read_save_array(false);
-
+      on_all_cores([]{ test_io_engine(); });
+    
+      for (bool local : {true, false}) {
+        FLAGS_io_local_ingest = local;
+        
+        sync();
+        LOG(INFO) << "testing file read/write" << (local ? " (local ingest)" : "");
+        test_read_save_array(false);
+
+        sync();
+        //sleep(1);
+        LOG(INFO) << "testing dir read/write" << (local ? " (local ingest)" : "");
+        test_read_save_array(true);
+      }
+      FLAGS_io_local_ingest = true;
+      
       sync();
-      //sleep(1);
-      LOG(INFO) << "testing dir read/write";
-      test_read_save_array(true);
+      LOG(INFO) << "testing local ingest into other distributions";
+      test_read_distributed(Distribution::hashed(256));
+      test_read_distributed(Distribution::cyclic(4096));
 
       sync();
       LOG(INFO) << "testing unordered collective array read";
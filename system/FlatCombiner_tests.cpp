@@ -64,6 +64,14 @@ BOOST_AUTO_TEST_CASE( test1 ) {
   
     BOOST_CHECK_EQUAL(c->count(), 10*cores());
     LOG(INFO) << "count = " << c->count();
+    
+    auto lc = GlobalCounter::create(5, true);
+    on_all_cores([lc]{
+      for (int i=0; i<10; i++) {
+        lc->incr();
+      }
+    });
+    BOOST_CHECK_EQUAL(lc->count(), 5 + 10*cores());
   
     Metrics::merge_and_print();
   });
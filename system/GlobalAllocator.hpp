@@ -61,8 +61,14 @@ private:
   // release data at pointer in local heap
   /// (should be called only on node responsible for allocator)
   void local_free( GlobalAddress< void > address ) {
-    void * va = reinterpret_cast< void * >( address.raw_bits() );
-    a_p_->free( va );
+    if( address.is_linear() && !address.distribution().is_default() ) {
+      // distributed allocations are aligned inside the chunk we handed out
+      void * va = reinterpret_cast< void * >( address.raw_bits() & pointer_mask );
+      a_p_->free_containing( va );
+    } else {
+      void * va = reinterpret_cast< void * >( address.raw_bits() );
+      a_p_->free( va );
+    }
   }
 
 
@@ -142,6 +148,36 @@ GlobalAddress<T> global_alloc(size_t count) {
   return static_cast<GlobalAddress<T>>(GlobalAllocator::remote_malloc(sizeof(T)*count));
 }
 
+/// Allocate `count` elements from the global shared heap, laid out
+/// across cores according to `dist` (see Distribution).
+///
+/// The allocation is padded so that its local part starts at the same
+/// block-aligned offset on every core; this costs up to one extra
+/// block per core. The block size must be a multiple of sizeof(T), so that
+/// no element straddles two cores.
+template< typename T = int8_t >
+GlobalAddress<T> global_alloc(size_t count, Distribution dist) {
+  if (dist.is_default()) return global_alloc<T>(count);
+  CHECK_GT(count, 0) << "allocation must be greater than 0";
+  
+  dist = dist.sized_for(count, sizeof(T));
+  CHECK(dist.block_bytes() % sizeof(T) == 0) << "elements must not straddle distribution blocks";
+  size_t nc = cores();
+  size_t bs = dist.block_bytes();
+  size_t nblocks = (count * sizeof(T) + bs - 1) / bs;
+  size_t local_bytes = (nblocks + nc - 1) / nc * bs;
+  local_bytes = (local_bytes + block_size - 1) / block_size * block_size;
+  
+  // local part must start at a multiple of both this block size and BLOCK_SIZE
+  size_t align = bs;
+  while (align % block_size != 0) align += bs;
+  
+  auto raw = GlobalAllocator::remote_malloc(nc * (local_bytes + align)).raw_bits();
+  intptr_t stride = nc * align;
+  intptr_t aligned = (raw + stride - 1) / stride * stride;
+  return GlobalAddress<T>::Raw((dist.bits() << dist_shift_val) | aligned);
+}
+
 /// Free memory allocated from global shared heap.
 template< typename T >
 void global_free(GlobalAddress<T> address) {
@@ -71,6 +71,13 @@ namespace Grappa {
 /// state. Note: `reset` no longer needs to be called between phases. Instead, it just
 /// must be guaranteed that at least one task has been enrolled before anyone tries to
 /// call `wait` otherwise they may fall through before the enrollment has completed.
+///
+/// Termination is detected over a tree of cores rooted at `master_core` (the same shape
+/// as the on_all_cores broadcast tree, see --collective_tree_fanout). Each core tracks
+/// how many "units" below it are active (its own work, plus each child subtree with work),
+/// and only tells its parent when that goes 0 -> 1 or 1 -> 0. So the master sees at most
+/// one transition per child rather than one per core, and the final wakeup is broadcast
+/// back down the tree.
 class GlobalCompletionEvent : public CompletionEvent {
   // All nodes
   // (count)
@@ -78,9 +85,18 @@ class GlobalCompletionEvent : public CompletionEvent {
   bool event_in_progress;
   Core master_core;
   
-  // Master barrier only
+  /// active units in this core's subtree: own work (count > 0) plus active children
   Core cores_out;
   
+  /// this subtree has gone active and we're waiting for our parent to acknowledge it
+  bool activating;
+  
+  /// children whose activation we acknowledge once our own is acknowledged
+  std::vector<Core> pending_acks;
+  
+  /// local enrollers waiting for activation to be acknowledged
+  ConditionVariable activated_cv;
+  
   /// pointer to shared arg for loops that use a GCE
   const void * shared_ptr;
 
@@ -147,6 +163,78 @@ class GlobalCompletionEvent : public CompletionEvent {
     }
   }
   
+  /// rank of a core in the termination tree (master is 0)
+  int64_t tree_rank(Core c) const { return (c - master_core + cores()) % cores(); }
+  Core tree_core(int64_t rank) const { return (master_core + rank) % cores(); }
+  
+  Core tree_parent() const {
+    return tree_core( (tree_rank(mycore()) - 1) / impl::tree_fanout() );
+  }
+  
+  /// A unit below this core (its own work if `from` is this core, otherwise the
+  /// subtree of child `from`) has become active. Safe to call from message handlers.
+  void unit_active(Core from) {
+    cores_out++;
+    if (from != mycore() && (activating || cores_out == 1)) {
+      pending_acks.push_back(from);
+    }
+    
+    if (cores_out == 1) { // cores_out[0 -> 1]
+      activating = true;
+      if (mycore() == master_core) {
+        // first activity anywhere: make sure other cores are ready to wait before anyone proceeds
+        spawn([this]{
+          call_on_all_cores([this]{ event_in_progress = true; });
+          activated();
+        });
+      } else {
+        DVLOG(4) << "subtree activating, telling Core[" << tree_parent() << "]";
+        Core me = mycore();
+        send_heap_message(tree_parent(), [this,me]{ unit_active(me); });
+      }
+    } else if (!activating && from != mycore()) {
+      // already known to be active all the way up
+      send_heap_message(from, [this]{ activated(); });
+    }
+  }
+  
+  /// Parent has acknowledged this subtree's activation.
+  void activated() {
+    activating = false;
+    for (auto c : pending_acks) {
+      send_heap_message(c, [this]{ activated(); });
+    }
+    pending_acks.clear();
+    broadcast(&activated_cv);
+  }
+  
+  /// A unit below this core has run out of work.
+  void unit_inactive() {
+    cores_out--;
+    DVLOG(4) << "unit inactive (cores_out:" << cores_out << ")";
+    if (cores_out == 0) { // cores_out[1 -> 0]
+      if (mycore() == master_core) {
+        CHECK_EQ(count, 0);
+        wake_subtree();
+      } else {
+        send_heap_message(tree_parent(), [this]{ unit_inactive(); });
+      }
+    }
+  }
+  
+  /// Wake everyone in this core's subtree, forwarding down the tree first.
+  void wake_subtree() {
+    const int64_t k = impl::tree_fanout();
+    const int64_t rank = tree_rank(mycore());
+    for (int64_t r = rank*k + 1; r <= rank*k + k && r < cores(); r++) {
+      send_heap_message(tree_core(r), [this]{ wake_subtree(); });
+    }
+    CHECK_EQ(count, 0);
+    DVLOG(3) << "broadcast";
+    broadcast(&cv); // wake anyone who was waiting here
+    reset(); // reset, now anyone else calling `wait` should fall through
+  }
+  
 public:
   
   static std::vector<GlobalCompletionEvent*> get_user_tracked();
@@ -175,7 +263,7 @@ public:
     }
   }
   
-  GlobalCompletionEvent(bool user_track=false): master_core(0), completion_msgs(nullptr) {
+  GlobalCompletionEvent(bool user_track=false): master_core(0), activating(false), completion_msgs(nullptr) {
     reset();
 
     if (user_track) {
@@ -197,6 +285,7 @@ public:
     count = 0;
     cv.waiters_ = 0;
     cores_out = 0;
+    activating = false;
     event_in_progress = false;
   }
   
@@ -215,22 +304,12 @@ public:
     // first one to have work here
     if (count == inc) { // count[0 -> inc]
       event_in_progress = true; // optimization to save checking in wait()
-      // cancel barrier
-      Core co = impl::call(master_core, [this] {
-        cores_out++;
-        return cores_out;
-      });
-      // first one to cancel barrier should make sure other cores are ready to wait
-      if (co == 1) { // cores_out[0 -> 1]
-        event_in_progress = true;
-        call_on_all_cores([this] {
-          event_in_progress = true;
-        });
-        CHECK(event_in_progress);
-      }
-      // block until cancelled
+      // cancel barrier, blocking until every ancestor in the tree knows we're active
+      unit_active(mycore());
+      while (activating) Grappa::wait(&activated_cv);
+      CHECK(event_in_progress);
       CHECK_GT(count, 0);
-      DVLOG(2) << "gce(" << this << " cores_out: " << co << ", count: " << count << ")";
+      DVLOG(2) << "gce(" << this << " cores_out: " << cores_out << ", count: " << count << ")";
     }
   }
   
@@ -244,25 +323,8 @@ public:
     
     // out of work here
     if (count == 0) { // count[dec -> 0]
-      // enter cancellable barrier
-      send_heap_message(master_core, [this] {
-        cores_out--;
-        DVLOG(4) << "core entered barrier (cores_out:"<< cores_out <<")";
-        
-        // if all are in
-        if (cores_out == 0) { // cores_out[1 -> 0]
-          CHECK_EQ(count, 0);
-          // notify everyone to wake
-          for (Core c = 0; c < cores(); c++) {
-            send_heap_message(c, [this] {
-              CHECK_EQ(count, 0);
-              DVLOG(3) << "broadcast";
-              broadcast(&cv); // wake anyone who was waiting here
-              reset(); // reset, now anyone else calling `wait` should fall through
-            });
-          }
-        }
-      });
+      // enter cancellable barrier; last one in wakes everyone
+      unit_inactive();
     }
   }
   
@@ -28,9 +28,18 @@
 #include "LocaleSharedMemory.hpp"
 #include "GlobalAllocator.hpp"
 #include "Collective.hpp"
+#include <cstdio>
 
 namespace Grappa {
 
+/// Counter that any core can cheaply increment. By default increments are combined on
+/// each core (with a FlatCombiner) and sent to a master core, so reading the count is a
+/// single delegate to the master.
+///
+/// In locale-combined mode (`create(initial, true)`), cores instead add into one counter
+/// per locale in shared memory with an atomic, and reading sums the master's count and
+/// one value per locale. This avoids per-core messages entirely, for counters that are
+/// updated and read frequently.
 class GlobalCounter {
 public:
   
@@ -58,13 +67,30 @@ public:
     bool is_full() { return false; }
   };
   FlatCombiner<Proxy> comb;
+  
+  /// (locale-combined mode) this locale's shared count
+  long * locale_count;
     
-  GlobalCounter(long initial_count = 0, Core master_core = 0): comb(locale_new<Proxy>(this)) {
+  GlobalCounter(long initial_count = 0, Core master_core = 0,
+                GlobalAddress<GlobalCounter> self = GlobalAddress<GlobalCounter>(),
+                bool locale_combined = false)
+    : self(self), comb(locale_new<Proxy>(this)), locale_count(nullptr)
+  {
     master.count = initial_count;
     master.core = master_core;
+    if (locale_combined) {
+      // same name on every core of the locale, since the symmetric address is the same
+      char name[64];
+      snprintf(name, sizeof(name), "GlobalCounter@%lx", (unsigned long)self.raw_bits());
+      locale_count = static_cast<long*>( impl::locale_shared_memory.find_or_create_named(name, sizeof(long)) );
+    }
   }
   
   void incr(long d = 1) {
+    if (locale_count) {
+      __atomic_fetch_add(locale_count, d, __ATOMIC_RELAXED);
+      return;
+    }
     comb.combine([d](Proxy& p){
       p.delta += d;
       return FCStatus::BLOCKED;
@@ -73,13 +99,27 @@ public:
   
   long count() {
     auto s = self;
-    return delegate::call(master.core, [s]{ return s->master.count; });
+    long total = delegate::call(master.core, [s]{ return s->master.count; });
+    if (locale_count) {
+      // one read per locale; ours directly from shared memory
+      total += __atomic_load_n(locale_count, __ATOMIC_RELAXED);
+      for (Core c = 0; c < cores(); c++) {
+        bool first_of_locale = (c == 0) || (locale_of(c) != locale_of(c-1));
+        if (first_of_locale && locale_of(c) != mylocale()) {
+          total += delegate::call(c, [s]{ return __atomic_load_n(s->locale_count, __ATOMIC_RELAXED); });
+        }
+      }
+    }
+    return total;
   }
   
-  static GlobalAddress<GlobalCounter> create(long initial_count = 0) {
+  static GlobalAddress<GlobalCounter> create(long initial_count = 0, bool locale_combined = false) {
     auto a = symmetric_global_alloc<GlobalCounter>();
     auto master_core = mycore();
-    call_on_all_cores([a,master_core]{ new (a.localize()) GlobalCounter(0, master_core); });
+    call_on_all_cores([a,master_core,initial_count,locale_combined]{
+      new (a.localize()) GlobalCounter(mycore() == master_core ? initial_count : 0,
+                                       master_core, a, locale_combined);
+    });
     return a;
   }
   
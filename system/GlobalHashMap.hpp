@@ -27,8 +27,10 @@
 #include "ParallelLoop.hpp"
 #include "Metrics.hpp"
 #include "FlatCombiner.hpp"
+#include "Collective.hpp"
+#include "HashBatch.hpp"
+#include "SwissTable.hpp"
 #include <utility>
-#include <unordered_map>
 #include <vector>
 
 GRAPPA_DECLARE_METRIC(SimpleMetric<size_t>, hashmap_insert_ops);
@@ -39,15 +41,15 @@ GRAPPA_DECLARE_METRIC(SimpleMetric<size_t>, hashmap_lookup_msgs);
 
 namespace Grappa {
 
+/// Distributed hash map. Each key is owned by one core (chosen by its hash),
+/// which keeps its entries in a core-local open-addressing table
+/// (impl::SwissTable), so inserts and lookups at the owner neither chase
+/// pointers nor allocate per entry.
 template< typename K, typename V > 
 class GlobalHashMap {
 public:
-  struct Entry {
-    K key;
-    V val;
-    Entry( K key ) : key(key), val() {}
-    Entry( K key, V val): key(key), val(val) {}
-  };
+  using Shard = impl::SwissTable<K,V>;
+  using Entry = typename Shard::Slot;
   
   struct ResultEntry {
     bool found;
@@ -55,47 +57,17 @@ public:
     V val;
   };
   
-public:
-  struct Cell { // TODO: keep first few in the 64-byte block, then go to secondary storage
-    std::vector<Entry> entries;
-    
-    Cell() : entries() { entries.reserve(10); }
-    
-    void clear() { entries.clear(); }
-    
-    std::pair<bool,V> lookup(K key) {
-      
-      for (auto& e : this->entries) if (e.key == key) return std::pair<bool,K>{true, e.val};
-      return std::pair<bool,K>(false,V());
-    }
-    void insert(const K& key, const V& val) {
-      bool found = false;
-      for (auto& e : entries) {
-        if (e.key == key) {
-          e.val = val;
-          found = true;
-          break;
-        }
-      }
-      if (!found) {
-        entries.emplace_back(key, val);
-      }
-    }
-  } GRAPPA_BLOCK_ALIGNED;
-
   struct Proxy {
     static const size_t LOCAL_HASH_SIZE = 1<<10;
     
     GlobalHashMap * owner;
-    std::unordered_map<K,V> map;
-    std::unordered_map<K,ResultEntry*> lookups;
+    impl::SwissTable<K,V> map;
+    impl::SwissTable<K,ResultEntry*> lookups;
     
     Proxy(GlobalHashMap * owner): owner(owner)
       , map(LOCAL_HASH_SIZE)
       , lookups(LOCAL_HASH_SIZE)
-    {
-      clear();
-    }
+    { }
     
     void clear() { map.clear(); lookups.clear(); }
     
@@ -107,39 +79,32 @@ public:
     }
     
     void insert(const K& newk, const V& newv) {
-      if (map.count(newk) == 0) {
-        map[newk] = newv;
-      }
+      auto r = map.insert(newk);
+      if (r.second) r.first->val = newv;
     }
     
     void sync() {
       CompletionEvent ce(map.size()+lookups.size());
       auto cea = make_global(&ce);
+      auto self = owner->self;
       
-      for (auto& e : map) { auto& k = e.first; auto& v = e.second;
+      map.for_each([self,cea](Entry& e){ auto k = e.key; auto v = e.val;
         ++hashmap_insert_msgs;
-        auto cell = owner->base+owner->computeIndex(k);
-        send_heap_message(cell.core(), [cell,cea,k,v]{
-          cell->insert(k, v);
+        send_heap_message(self->owner_of(k), [self,cea,k,v]{
+          self->shard.insert(k).first->val = v;
           complete(cea);
         });
-      }
+      });
       
-      for (auto& e : lookups) { auto k = e.first;
+      lookups.for_each([self,cea](typename impl::SwissTable<K,ResultEntry*>::Slot& e){
+        auto k = e.key; auto re = e.val;
         ++hashmap_lookup_msgs;
-        auto re = e.second;
         DVLOG(3) << "lookup " << k << " with re = " << re;
-        auto cell = owner->base+owner->computeIndex(k);
         
-        send_heap_message(cell.core(), [cell,k,cea,re]{
-          Cell * c = cell.localize();
-          bool found = false;
-          V val;
-          for (auto& e : c->entries) if (e.key == k) {
-            found = true;
-            val = e.val;
-            break;
-          }
+        send_heap_message(self->owner_of(k), [self,k,cea,re]{
+          auto s = self->shard.find(k);
+          bool found = (s != nullptr);
+          V val = found ? s->val : V();
           send_heap_message(cea.core(), [cea,re,found,val]{
             ResultEntry * r = re;
             while (r != nullptr) {
@@ -150,70 +115,70 @@ public:
             complete(cea);
           });
         });
-      }
+      });
       ce.wait();
     }
   };
 
   // private members
   GlobalAddress<GlobalHashMap> self;
-  GlobalAddress< Cell > base;
   size_t capacity;
+  Shard shard;   // entries owned by this core
   
   FlatCombiner<Proxy> proxy;
 
-  uint64_t computeIndex(K key) {
+  /// Core owning `key`'s entry.
+  Core owner_of(const K& key) const {
     static std::hash<K> hasher;
-    return hasher(key) % capacity;
+    return impl::hash_owner(impl::hash_mix(hasher(key)), cores());
   }
 
   // for creating local GlobalHashMap
-  GlobalHashMap( GlobalAddress<GlobalHashMap> self, GlobalAddress<Cell> base, size_t capacity )
-    : self(self), base(base), capacity(capacity)
+  GlobalHashMap( GlobalAddress<GlobalHashMap> self, size_t capacity )
+    : self(self), capacity(capacity)
+    , shard(capacity / cores() + 1)
     , proxy(locale_new<Proxy>(this))
   {
-    CHECK_LT(sizeof(self)+sizeof(base)+sizeof(capacity)+sizeof(proxy), 2*block_size);
+    CHECK_LT(sizeof(self)+sizeof(capacity)+sizeof(shard)+sizeof(proxy), 2*block_size);
   }
   
 public:
   // for static construction
   GlobalHashMap( ) {}
   
+  /// @param total_capacity expected number of entries (tables grow past it)
   static GlobalAddress<GlobalHashMap> create(size_t total_capacity) {
-    auto base = global_alloc<Cell>(total_capacity);
     auto self = symmetric_global_alloc<GlobalHashMap>();
-    call_on_all_cores([self,base,total_capacity]{
-      new (self.localize()) GlobalHashMap(self, base, total_capacity);
+    call_on_all_cores([self,total_capacity]{
+      new (self.localize()) GlobalHashMap(self, total_capacity);
     });
-    forall(base, total_capacity, [](int64_t i, Cell& c) { new (&c) Cell(); });
     return self;
   }
   
-  GlobalAddress<Cell> begin() { return this->base; }
-  size_t ncells() { return this->capacity; }
-  
   void clear() {
-    forall(base, capacity, [](Cell& c){ c.clear(); });
+    auto self = this->self;
+    call_on_all_cores([self]{ self->shard.clear(); });
   }
   
   void destroy() {
     auto self = this->self;
-    forall(this->base, this->capacity, [](Cell& c){ c.~Cell(); });
-    global_free(this->base);
     call_on_all_cores([self]{ self->~GlobalHashMap(); });
     global_free(self);
   }
   
+  /// Number of entries, and bytes of table storage, summed over all cores.
+  size_t size() {
+    auto self = this->self;
+    return sum_all_cores([self]{ return self->shard.size(); });
+  }
+  size_t bytes() {
+    auto self = this->self;
+    return sum_all_cores([self]{ return self->shard.bytes(); });
+  }
+  
   template< typename F >
   void forall_entries(F visit) {
-    forall(base, capacity, [visit](int64_t i, Cell& c){
-      // if cell is not hit then no action
-      if (c.entries == nullptr) return;
-      DVLOG(3) << "c<" << &c << "> entries:" << c.entries << " size: " << c.entries->size();
-      for (Entry& e : *c.entries) {
-        visit(e.key, *e.val);
-      }
-    });
+    forall(self, visit);
   }
   
   bool lookup(K key, V * val) {
@@ -223,24 +188,20 @@ public:
       DVLOG(3) << "lookup[" << key << "] = " << &re;
       
       proxy.combine([&re,key](Proxy& p){
-        // if (p.map.count(key) > 0) {
-        //   re.found = true;
-        //   re.val = p.map[key];
-        //   return FCStatus::SATISFIED;
-        // } else {
-          if (p.lookups.count(key) == 0) p.lookups[key] = nullptr;
-          re.next = p.lookups[key];
-          p.lookups[key] = &re;
-          DVLOG(3) << "p.lookups[" << key << "] = " << &re;
-          return FCStatus::BLOCKED;
-        // }
+        auto& head = p.lookups.insert(key).first->val;
+        re.next = head;
+        head = &re;
+        DVLOG(3) << "p.lookups[" << key << "] = " << &re;
+        return FCStatus::BLOCKED;
       });
       *val = re.val;
       return re.found;
     } else {
       ++hashmap_lookup_msgs;
-      auto result = delegate::call(base+computeIndex(key), [key](Cell* c){
-        return c->lookup(key);
+      auto self = this->self;
+      auto result = delegate::call(owner_of(key), [self,key]{
+        auto s = self->shard.find(key);
+        return s ? std::make_pair(true, s->val) : std::make_pair(false, V());
       });
       *val = result.second;
       return result.first;
@@ -250,45 +211,87 @@ public:
   void insert(K key, V val) {
     ++hashmap_insert_ops;
     if (FLAGS_flat_combining) {
-      proxy.combine([key,val](Proxy& p){ p.map[key] = val; return FCStatus::BLOCKED; });
+      proxy.combine([key,val](Proxy& p){ p.map.insert(key).first->val = val; return FCStatus::BLOCKED; });
     } else {
       ++hashmap_insert_msgs;
-      delegate::call(base+computeIndex(key), [key,val](Cell * c) { c->insert(key,val); });
+      auto self = this->self;
+      delegate::call(owner_of(key), [self,key,val]{ self->shard.insert(key).first->val = val; });
     }
   }
+  
+  /// Insert (or overwrite) `n` key/value pairs. Pairs are bucketed by owner
+  /// core locally and each bucket is shipped in as few messages as possible,
+  /// then inserted in a tight loop at the owner. Blocks until all are done.
+  void insert_batch(const K * keys, const V * vals, size_t n) {
+    struct KV { K key; V val; };
+    hashmap_insert_ops += n;
+    auto self = this->self;
+    hashmap_insert_msgs += impl::scatter_to_owners<KV>(n, MAX_MESSAGE_SIZE / sizeof(KV),
+    [self,keys,vals](size_t i, Core& dest){
+      dest = self->owner_of(keys[i]);
+      return KV{keys[i], vals[i]};
+    }, [self](const KV * kvs, size_t m, GlobalAddress<CompletionEvent> ce){
+      for (size_t i = 0; i < m; i++) self->shard.insert(kvs[i].key).first->val = kvs[i].val;
+      complete(ce);
+    });
+  }
+  
+  /// Look up `n` keys, batched like insert_batch. Sets `vals[i]` to the
+  /// value for `keys[i]` (or `V()` if absent) and, if given, `found[i]`.
+  void lookup_batch(const K * keys, size_t n, V * vals, bool * found = nullptr) {
+    struct Request { K key; size_t index; };
+    struct Reply { size_t index; bool found; V val; };
+    hashmap_lookup_ops += n;
+    auto self = this->self;
+    hashmap_lookup_msgs += impl::scatter_to_owners<Request>(n,
+      MAX_MESSAGE_SIZE / std::max(sizeof(Request), sizeof(Reply)),
+    [self,keys](size_t i, Core& dest){
+      dest = self->owner_of(keys[i]);
+      return Request{keys[i], i};
+    }, [self,vals,found](const Request * reqs, size_t m, GlobalAddress<CompletionEvent> ce){
+      std::vector<Reply> replies(m);
+      for (size_t i = 0; i < m; i++) {
+        auto s = self->shard.find(reqs[i].key);
+        replies[i] = Reply{reqs[i].index, s != nullptr, s ? s->val : V()};
+      }
+      impl::reply_with(ce.core(), replies.data(), m, [vals,found,ce](const Reply * rs, size_t m){
+        for (size_t i = 0; i < m; i++) {
+          vals[rs[i].index] = rs[i].val;
+          if (found) found[rs[i].index] = rs[i].found;
+        }
+        complete(ce);
+      });
+    });
+  }
     
 } GRAPPA_BLOCK_ALIGNED;
 
+/// Insert `key` if absent (value-initialized), then call `on_insert(V&)` on
+/// its value at the owning core.
 template< SyncMode S = SyncMode::Blocking,
           GlobalCompletionEvent * C = &impl::local_gce,
           typename K = nullptr_t, typename V = nullptr_t,
           typename F = nullptr_t >
 void insert(GlobalAddress<GlobalHashMap<K,V>> self, K key, F on_insert) {
   ++hashmap_insert_msgs;
-  delegate::call<S,C>(self->base+self->computeIndex(key),
-  [=](typename GlobalHashMap<K,V>::Cell& c){
-    for (auto& e : c.entries) {
-      if (e.key == key) {
-        on_insert(e.val);
-        return;
-      }
-    }
-    c.entries.emplace_back(key);
-    on_insert(c.entries.back().val);
+  delegate::call<S,C>(self->owner_of(key), [=]{
+    on_insert(self->shard.insert(key).first->val);
   });
 }
 
+/// Visit every entry, in parallel on each entry's owning core. Blocks until
+/// all visits (and anything they enroll in GCE) are done.
 template< GlobalCompletionEvent * GCE = &impl::local_gce,
           int64_t Threshold = impl::USE_LOOP_THRESHOLD_FLAG,
           typename T = decltype(nullptr),
           typename V = decltype(nullptr),
           typename F = decltype(nullptr) >
 void forall(GlobalAddress<GlobalHashMap<T,V>> self, F visit) {
-  forall<GCE,Threshold>(self->begin(), self->ncells(),
-  [visit](typename GlobalHashMap<T,V>::Cell& c){
-    for (auto& e : c.entries) {
+  impl::forall_local<GCE,Threshold>([self]{ return static_cast<int64_t>(self->shard.capacity()); },
+  [self,visit](int64_t s, int64_t n){
+    self->shard.for_each(s, n, [&visit](typename GlobalHashMap<T,V>::Entry& e){
       visit(e.key, e.val);
-    }
+    });
   });
 }
 
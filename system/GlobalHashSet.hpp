@@ -29,10 +29,11 @@
 #include "Metrics.hpp"
 #include "Array.hpp"
 #include "FlatCombiner.hpp"
+#include "Collective.hpp"
+#include "HashBatch.hpp"
+#include "SwissTable.hpp"
 
 #include <vector>
-#include <unordered_set>
-#include <unordered_map>
 
 GRAPPA_DECLARE_METRIC(SummarizingMetric<uint64_t>, cell_traversal_length);
 
@@ -45,20 +46,13 @@ GRAPPA_DECLARE_METRIC(SimpleMetric<size_t>, hashset_matched_lookups);
 
 namespace Grappa {
 
+/// Distributed hash set, laid out like GlobalHashMap: each key lives in a
+/// core-local open-addressing table on the core its hash selects.
 template <typename K>
 class GlobalHashSet {
 protected:
-  struct Entry {
-    K key;
-    Entry(){}
-    Entry(K key) : key(key) {}
-  };
+  using Shard = impl::SwissTable<K>;
   
-  struct Cell { // TODO: keep first few in the 64-byte block, then go to secondary storage
-    std::vector<Entry> entries;
-    Cell() { entries.reserve(16); }
-  } GRAPPA_BLOCK_ALIGNED;
-
   struct ResultEntry {
     bool result;
     ResultEntry * next;
@@ -68,8 +62,8 @@ protected:
     static const size_t LOCAL_HASH_SIZE = 1<<10;
     
     GlobalHashSet * owner;
-    std::unordered_set<K> keys_to_insert;
-    std::unordered_map<K,ResultEntry*> lookups;
+    impl::SwissTable<K> keys_to_insert;
+    impl::SwissTable<K,ResultEntry*> lookups;
     
     Proxy(GlobalHashSet * owner): owner(owner)
       , keys_to_insert(LOCAL_HASH_SIZE)
@@ -86,36 +80,28 @@ protected:
     }
     
     void insert(const K& newk) {
-      if (keys_to_insert.count(newk) == 0) {
-        keys_to_insert.insert(newk);
-      }
+      keys_to_insert.insert(newk);
     }
 
     void sync() {
       CompletionEvent ce(keys_to_insert.size()+lookups.size());
       auto cea = make_global(&ce);
+      auto self = owner->self;
       
-      for (auto& k : keys_to_insert) {
+      keys_to_insert.for_each([self,cea](typename Shard::Slot& e){ auto k = e.key;
         ++hashset_insert_msgs;
-        auto cell = owner->base+owner->computeIndex(k);
-        send_heap_message(cell.core(), [cell,k,cea]{
-          Cell * c = cell.localize();
-          bool found = false;
-          for (auto& e : c->entries) if (e.key == k) { found = true; break; }
-          if (!found) c->entries.emplace_back(k);
+        send_heap_message(self->owner_of(k), [self,k,cea]{
+          self->shard.insert(k);
           complete(cea);
         });
-      }
-      for (auto& e : lookups) { auto k = e.first;
+      });
+      lookups.for_each([self,cea](typename impl::SwissTable<K,ResultEntry*>::Slot& e){
+        auto k = e.key; auto re = e.val;
         ++hashset_lookup_msgs;
-        auto re = e.second;
         DVLOG(3) << "lookup " << k << " with re = " << re;
-        auto cell = owner->base+owner->computeIndex(k);
         
-        send_heap_message(cell.core(), [cell,k,cea,re]{
-          Cell * c = cell.localize();
-          bool found = false;
-          for (auto& e : c->entries) if (e.key == k) { found = true; break; }
+        send_heap_message(self->owner_of(k), [self,k,cea,re]{
+          bool found = self->shard.find(k) != nullptr;
           
           send_heap_message(cea.core(), [cea,re,found]{
             ResultEntry * r = re;
@@ -126,47 +112,43 @@ protected:
             complete(cea);
           });
         });
-      }
+      });
       ce.wait();
     }
   };
 
   // private members
   GlobalAddress<GlobalHashSet> self;
-  GlobalAddress< Cell > base;
   size_t capacity;
-  
-  size_t count; // not maintained, just need storage for size()
+  Shard shard;   // keys owned by this core
   
   FlatCombiner<Proxy> proxy;
   
-  uint64_t computeIndex( K key ) {
+  Core owner_of( const K& key ) const {
     static std::hash<K> hasher;
-    return hasher(key) % capacity;
+    return impl::hash_owner(impl::hash_mix(hasher(key)), cores());
   }
 
   // for creating local GlobalHashSet
-  GlobalHashSet( GlobalAddress<GlobalHashSet> self, GlobalAddress<Cell> base, size_t capacity )
-    : self(self), base(base), capacity(capacity)
+  GlobalHashSet( GlobalAddress<GlobalHashSet> self, size_t capacity )
+    : self(self), capacity(capacity)
+    , shard(capacity / cores() + 1)
     , proxy(locale_new<Proxy>(this))
   { }
   
 public:
   
+  /// @param total_capacity expected number of keys (tables grow past it)
   static GlobalAddress<GlobalHashSet> create(size_t total_capacity) {
-    auto base = global_alloc<Cell>(total_capacity);
     auto self = symmetric_global_alloc<GlobalHashSet>();
-    call_on_all_cores([self,base,total_capacity]{
-      new (self.localize()) GlobalHashSet(self, base, total_capacity);
+    call_on_all_cores([self,total_capacity]{
+      new (self.localize()) GlobalHashSet(self, total_capacity);
     });
-    forall(base, total_capacity, [](int64_t i, Cell& c) { new (&c) Cell(); });
     return self;
   }
   
   void destroy() {
     auto self = this->self;
-    forall(this->base, this->capacity, [](Cell& c){ c.~Cell(); });
-    global_free(this->base);
     call_on_all_cores([self]{ self->~GlobalHashSet(); });
     global_free(self);
   }
@@ -178,24 +160,18 @@ public:
       DVLOG(3) << "lookup[" << key << "] = " << &re;
       
       proxy.combine([&re,key,this](Proxy& p){
-        // if (p.keys_to_insert.count(key) > 0) {
-        //   ++hashset_matched_lookups;
-        //   re.result = true;
-        //   return FCStatus::SATISFIED;
-        // } else {
-          if (p.lookups.count(key) == 0) p.lookups[key] = nullptr;
-          re.next = p.lookups[key];
-          p.lookups[key] = &re;
-          DVLOG(3) << "p.lookups[" << key << "] = " << &re;
-          return FCStatus::BLOCKED;
-        // }
+        auto& head = p.lookups.insert(key).first->val;
+        re.next = head;
+        head = &re;
+        DVLOG(3) << "p.lookups[" << key << "] = " << &re;
+        return FCStatus::BLOCKED;
       });
       return re.result;
     } else {
       ++hashset_lookup_msgs;
-      return delegate::call(base+computeIndex(key), [key](Cell* c){
-        for (auto& e : c->entries) if (e.key == key) return true;
-        return false;
+      auto self = this->self;
+      return delegate::call(owner_of(key), [self,key]{
+        return self->shard.find(key) != nullptr;
       });
     }
   }
@@ -212,14 +188,8 @@ public:
       proxy.combine([key](Proxy& p){ p.insert(key); return FCStatus::BLOCKED; });
     } else {
       ++hashset_insert_msgs;
-      delegate::call(base+computeIndex(key), [key](Cell * c) {
-        // find matching key in the list, if found, no insert necessary
-        for (auto& e : c->entries) if (e.key == key) return;
-        
-        // this is the first time the key has been seen so add it to the list
-        c->entries.emplace_back( key );
-        return;
-      });
+      auto self = this->self;
+      delegate::call(owner_of(key), [self,key]{ self->shard.insert(key); });
     }
   }
 
@@ -252,24 +222,64 @@ public:
     });
   }
   
+  /// Insert `n` keys, bucketed by owner core and shipped in as few messages
+  /// as possible. Blocks until all are inserted.
+  void insert_batch(const K * keys, size_t n) {
+    hashset_insert_ops += n;
+    auto self = this->self;
+    hashset_insert_msgs += impl::scatter_to_owners<K>(n, MAX_MESSAGE_SIZE / sizeof(K),
+    [self,keys](size_t i, Core& dest){
+      dest = self->owner_of(keys[i]);
+      return keys[i];
+    }, [self](const K * ks, size_t m, GlobalAddress<CompletionEvent> ce){
+      for (size_t i = 0; i < m; i++) self->shard.insert(ks[i]);
+      complete(ce);
+    });
+  }
+  
+  /// Look up `n` keys, batched like insert_batch; sets `found[i]`.
+  void lookup_batch(const K * keys, size_t n, bool * found) {
+    struct Request { K key; size_t index; };
+    struct Reply { size_t index; bool found; };
+    hashset_lookup_ops += n;
+    auto self = this->self;
+    hashset_lookup_msgs += impl::scatter_to_owners<Request>(n,
+      MAX_MESSAGE_SIZE / std::max(sizeof(Request), sizeof(Reply)),
+    [self,keys](size_t i, Core& dest){
+      dest = self->owner_of(keys[i]);
+      return Request{keys[i], i};
+    }, [self,found](const Request * reqs, size_t m, GlobalAddress<CompletionEvent> ce){
+      std::vector<Reply> replies(m);
+      for (size_t i = 0; i < m; i++) {
+        replies[i] = Reply{reqs[i].index, self->shard.find(reqs[i].key) != nullptr};
+      }
+      impl::reply_with(ce.core(), replies.data(), m, [found,ce](const Reply * rs, size_t m){
+        for (size_t i = 0; i < m; i++) found[rs[i].index] = rs[i].found;
+        complete(ce);
+      });
+    });
+  }
+  
   template< GlobalCompletionEvent * GCE = &impl::local_gce, typename F = decltype(nullptr) >
   void forall_keys(F visit) {
-    forall<GCE>(base, capacity, [visit](int64_t i, Cell& c){
-      for (auto& e : c.entries) {
-        visit(e.key);
-      }
+    auto self = this->self;
+    impl::forall_local<GCE>([self]{ return static_cast<int64_t>(self->shard.capacity()); },
+    [self,visit](int64_t s, int64_t n){
+      self->shard.for_each(s, n, [&visit](typename Shard::Slot& e){ visit(e.key); });
     });
   }
   
   size_t size() {
     auto self = this->self;
-    call_on_all_cores([self]{ self->count = 0; });
-    forall_keys([self](K& k){ self->count++; });
-    on_all_cores([self]{ self->count = allreduce<size_t,collective_add>(self->count); });
-    return count;
+    return sum_all_cores([self]{ return self->shard.size(); });
+  }
+  
+  /// Bytes of table storage summed over all cores.
+  size_t bytes() {
+    auto self = this->self;
+    return sum_all_cores([self]{ return self->shard.bytes(); });
   }
   
 } GRAPPA_BLOCK_ALIGNED;
 
 } // namespace Grappa
-
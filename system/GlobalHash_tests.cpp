@@ -34,6 +34,7 @@
 #include <boost/random/uniform_int.hpp>
 #include <boost/random/variate_generator.hpp>
 #include <random>
+#include <memory>
 
 using namespace Grappa;
 
@@ -47,12 +48,17 @@ DEFINE_int64(ntrials, 1, "number of independent trials to average over");
 
 DEFINE_bool(map_perf, false, "do performance test of GlobalHashMap");
 DEFINE_bool(set_perf, false, "do performance test of GlobalHashSet");
+DEFINE_bool(hash_bench, false, "benchmark GlobalHashMap insert/lookup rates and memory per entry");
 
 DEFINE_bool(insert_async, false, "do async inserts");
 
 DEFINE_double(fraction_lookups, 0.0, "fraction of accesses that should be lookups");
 
 GRAPPA_DEFINE_METRIC(SummarizingMetric<double>, trial_time, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<double>, hash_bench_insert_rate, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<double>, hash_bench_lookup_rate, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<double>, hash_bench_lookup_batch_rate, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<double>, hash_bench_bytes_per_entry, 0);
 
 template< typename T >
 inline T next_random() {
@@ -118,8 +124,84 @@ void test_correctness() {
   forall(ha, [](long key, long& val){
     BOOST_CHECK_EQUAL(val, 42);
   });
+  BOOST_CHECK_EQUAL(ha->size(), std::max<int64_t>(FLAGS_nelems, 10));
   
+  // read-modify-write at the owner; value-initialized on first insert
+  forall(0, FLAGS_nelems, [ha](int64_t i){
+    insert(ha, i % 10, [](long& v){ v++; });
+  });
+  for (int i=0; i<10; i++) {
+    long val;
+    BOOST_CHECK(ha->lookup(i, &val));
+    BOOST_CHECK_EQUAL(val, 42 + FLAGS_nelems / 10 + (i < FLAGS_nelems % 10 ? 1 : 0));
+  }
+  
+  ha->destroy();
+  
+  // start far too small, so every shard has to grow several times
+  auto hb = GlobalHashMap<long,long>::create(1);
+  const long n = 20000;
+  forall(0, n, [hb](int64_t i){ hb->insert(i*7919, i); });
+  BOOST_CHECK_EQUAL(hb->size(), n);
+  forall(0, n, [hb](int64_t i){
+    long val = -1;
+    BOOST_CHECK(hb->lookup(i*7919, &val));
+    BOOST_CHECK_EQUAL(val, i);
+    BOOST_CHECK(!hb->lookup(i*7919+1, &val));
+  });
+  hb->destroy();
+}
+
+void test_batch() {
+  LOG(INFO) << "Testing batched insert/lookup...";
+  auto ha = GlobalHashMap<long,long>::create(FLAGS_global_hash_size);
+  auto sa = GlobalHashSet<long>::create(FLAGS_global_hash_size);
+  on_all_cores([ha,sa]{
+    // overlapping keys from every core, more than fit in one message per owner
+    const size_t n = 2000;
+    std::vector<long> keys(n), vals(n);
+    for (size_t i = 0; i < n; i++) { keys[i] = i * 3; vals[i] = i * 3 + 1; }
+    ha->insert_batch(keys.data(), vals.data(), n);
+    sa->insert_batch(keys.data(), n);
+    barrier();
+    
+    std::vector<long> qs(2*n), out(2*n);
+    std::unique_ptr<bool[]> found(new bool[2*n]), sfound(new bool[2*n]);
+    for (size_t i = 0; i < 2*n; i++) qs[i] = i * 3 + (i % 2);
+    ha->lookup_batch(qs.data(), 2*n, out.data(), found.get());
+    sa->lookup_batch(qs.data(), 2*n, sfound.get());
+    size_t wrong = 0;
+    for (size_t i = 0; i < 2*n; i++) {
+      bool expect = (i % 2 == 0) && i < n;
+      if (found[i] != expect || sfound[i] != expect) wrong++;
+      if (expect && out[i] != qs[i] + 1) wrong++;
+    }
+    BOOST_CHECK_EQUAL(wrong, 0);
+  });
+  BOOST_CHECK_EQUAL(ha->size(), 2000);
+  BOOST_CHECK_EQUAL(sa->size(), 2000);
   ha->destroy();
+  sa->destroy();
+}
+
+void test_swiss_table() {
+  LOG(INFO) << "Testing local SwissTable...";
+  impl::SwissTable<long,long> t;
+  for (long i = 0; i < 5000; i++) t.insert(i<<16).first->val = i;
+  BOOST_CHECK_EQUAL(t.size(), 5000);
+  BOOST_CHECK(t.size() <= t.capacity() / 8 * 7);
+  for (long i = 0; i < 5000; i++) {
+    auto s = t.find(i<<16);
+    BOOST_CHECK(s != nullptr && s->val == i);
+    BOOST_CHECK(t.find((i<<16)+1) == nullptr);
+  }
+  BOOST_CHECK(!t.insert(0).second);
+  long n = 0;
+  t.for_each([&n](impl::SwissTable<long,long>::Slot& s){ n++; });
+  BOOST_CHECK_EQUAL(n, 5000);
+  t.clear();
+  BOOST_CHECK_EQUAL(t.size(), 0);
+  BOOST_CHECK(t.find(0) == nullptr);
 }
 
 void test_set_correctness() {
@@ -173,6 +255,46 @@ double test_set_insert_throughput() {
   return t;
 }
 
+/// Insert FLAGS_nelems distinct keys, then look each one up, reporting
+/// throughput of each phase and table bytes per stored entry.
+void hash_bench() {
+  auto ha = GlobalHashMap<long,long>::create(FLAGS_global_hash_size);
+  const int64_t n = FLAGS_nelems;
+  
+  double t = walltime();
+  forall(0, n, [ha](int64_t i){ ha->insert(i, i); });
+  double insert_time = walltime() - t;
+  
+  t = walltime();
+  forall(0, n, [ha](int64_t i){
+    long v;
+    ha->lookup(i, &v);
+  });
+  double lookup_time = walltime() - t;
+  
+  // the same keys again through the batch API, from each core's block
+  t = walltime();
+  on_all_cores([ha,n]{
+    range_t r = blockDist(0, n, mycore(), cores());
+    std::vector<long> keys(r.end - r.start), vals(r.end - r.start);
+    for (int64_t i = r.start; i < r.end; i++) keys[i-r.start] = i;
+    ha->lookup_batch(keys.data(), keys.size(), vals.data());
+  });
+  double batch_time = walltime() - t;
+  hash_bench_lookup_batch_rate = n / batch_time;
+  
+  size_t entries = ha->size();
+  BOOST_CHECK_EQUAL(entries, n);
+  hash_bench_insert_rate = n / insert_time;
+  hash_bench_lookup_rate = n / lookup_time;
+  hash_bench_bytes_per_entry = static_cast<double>(ha->bytes()) / entries;
+  LOG(INFO) << "hash_bench: " << n << " entries, insert " << n / insert_time / 1e6 << " Mops/s"
+            << ", lookup " << n / lookup_time / 1e6 << " Mops/s"
+            << ", lookup_batch " << n / batch_time / 1e6 << " Mops/s"
+            << ", " << static_cast<double>(ha->bytes()) / entries << " bytes/entry";
+  ha->destroy();
+}
+
 BOOST_AUTO_TEST_CASE( test1 ) {
   Grappa::init( GRAPPA_TEST_ARGS );
   Grappa::run([]{
@@ -190,9 +312,13 @@ BOOST_AUTO_TEST_CASE( test1 ) {
       for (int i=0; i<FLAGS_ntrials; i++) {
         trial_time += test_set_insert_throughput();
       }
+    } else if (FLAGS_hash_bench) {
+      hash_bench();
     } else {
+      test_swiss_table();
       test_correctness();
       test_set_correctness();
+      test_batch();
     }
   
     Metrics::merge_and_print();
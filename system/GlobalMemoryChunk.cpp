@@ -39,35 +39,139 @@ extern "C" {
 #define USE_HUGEPAGES_DEFAULT true
 #endif
 #endif
+#ifndef SHM_HUGE_SHIFT
+#define SHM_HUGE_SHIFT 26
+#endif
+
+#include <fstream>
+#include <string>
 
 #include "Communicator.hpp"
 
 #include "GlobalMemoryChunk.hpp"
 #include "LocaleSharedMemory.hpp"
+#include "Metrics.hpp"
+
+DEFINE_bool( global_memory_use_hugepages, false, "Back global heap with explicit huge pages (falls back to transparent huge pages, then normal pages)" );
+DEFINE_int64( global_memory_hugepage_size, 1L << 30, "Size of huge pages to use for global heap (2MB or 1GB)" );
+DEFINE_int64( global_memory_per_node_base_address, 0x0000123400000000L, "Address at which huge-page-backed global heap is mapped in each process of a locale");
+
+/// page size backing this core's chunk of the global heap
+GRAPPA_DEFINE_METRIC( SimpleMetric<int64_t>, global_heap_page_size, 0 );
 
-DEFINE_bool( global_memory_use_hugepages, false, "UNUSED: use 1GB huge pages for global heap" );
-DEFINE_int64( global_memory_per_node_base_address, 0x0000123400000000L, "UNUSED: global memory base address");
+/// size of transparent huge pages on x86-64
+static const int64_t transparent_hugepage_size = 1L << 21;
 
 
 namespace Grappa {
 namespace impl {
 void * global_memory_chunk_base = NULL;
+void ** locale_global_memory_chunk_bases = NULL;
 }
 }
 
+/// Are transparent huge pages enabled for shared memory mappings?
+static bool shmem_transparent_hugepages_enabled() {
+  std::ifstream f( "/sys/kernel/mm/transparent_hugepage/shmem_enabled" );
+  std::string setting;
+  std::getline( f, setting );
+  return ( setting.find("[always]") != std::string::npos ||
+           setting.find("[advise]") != std::string::npos ||
+           setting.find("[within_size]") != std::string::npos ||
+           setting.find("[force]") != std::string::npos );
+}
+
+/// Try to map this locale's global heap on explicit huge pages, with
+/// each core's chunk laid out contiguously in one SysV segment
+/// attached at the same address in every process of the locale.
+/// Returns NULL on every core of the locale if that isn't possible.
+void * GlobalMemoryChunk::map_hugepages() {
+  const int64_t page_size = FLAGS_global_memory_hugepage_size;
+  CHECK_EQ( page_size & (page_size-1), 0 ) << "Huge page size must be a power of 2";
+  size_t locale_bytes = size_ * Grappa::locale_cores();
+  locale_bytes = (locale_bytes + page_size - 1) & ~(page_size - 1);
+
+  int shmid = -1;
+  if( Grappa::locale_mycore() == 0 ) {
+    int page_flag = __builtin_ctzll( page_size ) << SHM_HUGE_SHIFT;
+    shmid = shmget( IPC_PRIVATE, locale_bytes, IPC_CREAT | SHM_HUGETLB | page_flag | 0600 );
+    PLOG_IF( WARNING, shmid < 0 ) << "Couldn't get " << locale_bytes << " bytes of "
+                                  << page_size << "-byte huge pages for global heap";
+  }
+  MPI_CHECK( MPI_Bcast( &shmid, 1, MPI_INT, 0, global_communicator.locale_comm ) );
+  if( shmid < 0 ) return NULL;
+
+  void * base = reinterpret_cast< void* >( FLAGS_global_memory_per_node_base_address );
+  void * p = shmat( shmid, base, 0 );
+  int attached = ( p == base ), all_attached = 0;
+  PLOG_IF( WARNING, !attached ) << "Couldn't attach huge page global heap at " << base;
+  MPI_CHECK( MPI_Allreduce( &attached, &all_attached, 1, MPI_INT, MPI_LAND, global_communicator.locale_comm ) );
+
+  // everyone has attached (or failed), so segment can go away once detached
+  if( Grappa::locale_mycore() == 0 ) shmctl( shmid, IPC_RMID, NULL );
+
+  if( !all_attached ) {
+    if( attached ) shmdt( p );
+    return NULL;
+  }
+
+  hugetlb_base_ = base;
+  page_size_ = page_size;
+  return static_cast< char* >( base ) + size_ * Grappa::locale_mycore();
+}
+
 /// Tear down GlobalMemoryChunk, removing shm region if possible
 GlobalMemoryChunk::~GlobalMemoryChunk() {
-  Grappa::impl::locale_shared_memory.deallocate( memory_ );
+  delete [] Grappa::impl::locale_global_memory_chunk_bases;
+  Grappa::impl::locale_global_memory_chunk_bases = NULL;
+  if( hugetlb_base_ ) {
+    shmdt( hugetlb_base_ );
+    Grappa::impl::locale_shared_memory.account_bytes( size_, Grappa::impl::MemoryCategory::GlobalHeap, false );
+  } else {
+    Grappa::impl::locale_shared_memory.deallocate( memory_, Grappa::impl::MemoryCategory::GlobalHeap );
+  }
 }
 
 /// Construct GlobalMemoryChunk.
 GlobalMemoryChunk::GlobalMemoryChunk( size_t size )
   : size_( size )
   , memory_( 0 )
+  , hugetlb_base_( NULL )
+  , page_size_( sysconf( _SC_PAGESIZE ) )
 {
   DVLOG(2) << "Core " << Grappa::mycore() << " allocating " << size_ << " bytes ";
-  memory_ = Grappa::impl::locale_shared_memory.allocate_aligned( size_, 64 );
+  if( FLAGS_global_memory_use_hugepages ) {
+    memory_ = map_hugepages();
+    if( memory_ ) {
+      Grappa::impl::locale_shared_memory.account_bytes( size_, Grappa::impl::MemoryCategory::GlobalHeap, true );
+    }
+
+    if( !memory_ ) {
+      // fall back to the locale heap, asking for transparent huge pages if we can get them
+      if( shmem_transparent_hugepages_enabled() ) {
+        memory_ = Grappa::impl::locale_shared_memory.allocate_aligned( size_, transparent_hugepage_size,
+                                                                       Grappa::impl::MemoryCategory::GlobalHeap );
+        if( 0 == madvise( memory_, size_, MADV_HUGEPAGE ) ) {
+          page_size_ = transparent_hugepage_size;
+        }
+      }
+      LOG_IF( WARNING, Grappa::mycore() == 0 ) << "Huge pages unavailable for global heap; using "
+                                               << page_size_ << "-byte pages";
+    }
+  }
+  if( !memory_ ) {
+    memory_ = Grappa::impl::locale_shared_memory.allocate_aligned( size_, 64, Grappa::impl::MemoryCategory::GlobalHeap );
+  }
   CHECK_NOTNULL( memory_ );
+  global_heap_page_size = page_size_;
   Grappa::impl::global_memory_chunk_base = memory_;
+
+  // share chunk bases within the locale so cores can reach each other's
+  // heap directly (all cores map the locale segment at the same address)
+  Grappa::impl::locale_global_memory_chunk_bases = new void*[ Grappa::locale_cores() ];
+  MPI_CHECK( MPI_Allgather( &memory_, sizeof(void*), MPI_BYTE,
+                            Grappa::impl::locale_global_memory_chunk_bases, sizeof(void*), MPI_BYTE,
+                            global_communicator.locale_comm ) );
+  
   DVLOG(2) << "Core " << Grappa::mycore() << " allocated " << size_ << " bytes ";
 }
@@ -25,6 +25,9 @@
 #define __GLOBAL_MEMORY_CHUNK_HPP__
 
 #include "Addressing.hpp"
+#include "Metrics.hpp"
+
+GRAPPA_DECLARE_METRIC( SimpleMetric<int64_t>, global_heap_page_size );
 
 /// One processes' chunk of the global memory.
 class GlobalMemoryChunk
@@ -33,6 +36,12 @@ private:
   size_t size_;
   void * memory_;
 
+  /// base of this locale's huge page segment, if we got one
+  void * hugetlb_base_;
+  int64_t page_size_;
+
+  void * map_hugepages();
+
 public:
   GlobalMemoryChunk( size_t size );
   ~GlobalMemoryChunk();
@@ -41,6 +50,11 @@ public:
     return memory_;
   }
 
+  /// size of the pages backing this chunk
+  int64_t page_size() const {
+    return page_size_;
+  }
+
   GlobalAddress< void > global_pointer()  {
     return make_linear( memory_ );
   }
@@ -49,6 +63,7 @@ public:
 namespace Grappa {
 namespace impl {
 extern void * global_memory_chunk_base;
+extern void ** locale_global_memory_chunk_bases;
 }
 }
 
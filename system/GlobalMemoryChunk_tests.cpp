@@ -28,6 +28,7 @@
 
 #include "Grappa.hpp"
 #include "Delegate.hpp"
+#include "GlobalMemoryChunk.hpp"
 
 DECLARE_int64( global_memory_per_node_base_address );
 
@@ -54,6 +55,12 @@ BOOST_AUTO_TEST_CASE( test1 ) {
   DVLOG(1) << "Spawning user main Worker....";
   
   Grappa::run([]{
+    // whatever backing we got, its page size should be reported
+    Grappa::on_all_cores([]{
+      BOOST_CHECK_GE( global_heap_page_size.value(), sysconf( _SC_PAGESIZE ) );
+      BOOST_CHECK_EQUAL( global_heap_page_size.value() & (global_heap_page_size.value() - 1), 0 );
+    });
+
     for( int i = 0; i < size; ++i ) {
       BOOST_MESSAGE( "Writing to " << base + i );
       Grappa::delegate::write( base + i, i );
@@ -39,6 +39,7 @@
 // #include "tasks/GlobalQueue.hpp"
 
 #include "FileIO.hpp"
+#include "IOEngine.hpp"
 
 #include "RDMAAggregator.hpp"
 #include "LocaleSharedMemory.hpp"
@@ -70,6 +71,7 @@ DECLARE_double( locale_user_heap_fraction );
 DECLARE_double( global_heap_fraction );
 DECLARE_int64( shared_pool_max_size );
 DECLARE_bool( global_memory_use_hugepages );
+DECLARE_int64( global_memory_hugepage_size );
 DECLARE_double(locale_shared_fraction);
 
 
@@ -135,17 +137,18 @@ namespace Grappa {
     bytes_per_core &= ~( (1L << 12) - 1 );
     
     // be aware of hugepages
-    // Each core should ask for a multiple of 1GB hugepages
+    // Each core should ask for a multiple of the huge page size
     // and the whole node should ask for no more than the total pages available
     if ( FLAGS_global_memory_use_hugepages ) {
-      int64_t pages_per_core = bytes_per_core / (1L << 30);
-      int64_t new_bpp = pages_per_core * (1L << 30);
+      const int64_t page = FLAGS_global_memory_hugepage_size;
+      int64_t pages_per_core = bytes_per_core / page;
+      int64_t new_bpp = pages_per_core * page;
       if (new_bpp == 0) {
-        MASTER_ONLY VLOG(1) << "Allocating 1GB per core anyway.";
-        new_bpp = 1L << 30;
+        MASTER_ONLY VLOG(1) << "Allocating 1 huge page per core anyway.";
+        new_bpp = page;
       }
       MASTER_ONLY VLOG_IF(1, bytes_per_core != new_bpp) << "With ppn=" << ppn << ", can only allocate "
-      << pages_per_core*ppn << " / " << FLAGS_node_memsize / (1L << 30) << " 1GB huge pages per node";
+      << pages_per_core*ppn << " / " << FLAGS_node_memsize / page << " " << page << "-byte huge pages per node";
       bytes_per_core = new_bpp;
     }
     
@@ -188,6 +191,9 @@ static void poller( Worker * me, void * args ) {
         desc = temp;
       }
     }
+    
+    // submit and complete io_uring requests
+    Grappa::impl::io_poll();
 
     Grappa::yield_periodic();
   }
@@ -454,6 +460,7 @@ void Grappa_init( int * argc_p, char ** argv_p[], int64_t global_memory_size_byt
     exit(1);
   }
 #endif
+  Grappa::impl::io_engine_init();
 
   
   VLOG(2) << "Communicator initialized.";
@@ -665,6 +672,7 @@ int Grappa_finish( int retval )
 
   global_task_manager.finish();
   global_aggregator.finish();
+  Grappa::impl::io_engine_finish();
 
   if (global_memory) delete global_memory;
   locale_shared_memory.finish();
@@ -44,7 +44,11 @@
 
 #include "Delegate.hpp"
 #include "AsyncDelegate.hpp"
+#include "AtomicDelegate.hpp"
 #include "Collective.hpp"
+#include "AsyncCollective.hpp"
+#include "AllToAll.hpp"
+#include "Phaser.hpp"
 #include "ParallelLoop.hpp"
 #include "GlobalAllocator.hpp"
 // #include "Cache.hpp"
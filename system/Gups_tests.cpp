@@ -26,6 +26,7 @@
 
 #include <memory>
 #include <algorithm>
+#include <vector>
 
 #include <Grappa.hpp>
 #include "GlobalAllocator.hpp"
@@ -47,12 +48,24 @@ DEFINE_int64( repeats, 1, "Repeats" );
 DEFINE_int64( iterations, 1 << 25, "Iterations" );
 DEFINE_int64( sizeA, 1024, "Size of array that gups increments" );
 DEFINE_bool( validate, true, "Validate result" );
+DEFINE_bool( atomics, false, "Also measure each remote atomic operation" );
+DEFINE_int64( atomic_batch, 64, "Updates per call for the vector atomic ops" );
 
 DECLARE_string( load_balance );
 
 GRAPPA_DEFINE_METRIC( SimpleMetric<double>, gups_runtime, 0.0 );
 GRAPPA_DEFINE_METRIC( SimpleMetric<double>, gups_throughput, 0 );
 GRAPPA_DEFINE_METRIC( SimpleMetric<double>, gups_throughput_per_locale, 0 );
+GRAPPA_DEFINE_METRIC( SimpleMetric<double>, gups_atomic_fetch_add_throughput, 0 );
+GRAPPA_DEFINE_METRIC( SimpleMetric<double>, gups_atomic_fetch_min_throughput, 0 );
+GRAPPA_DEFINE_METRIC( SimpleMetric<double>, gups_atomic_fetch_max_throughput, 0 );
+GRAPPA_DEFINE_METRIC( SimpleMetric<double>, gups_atomic_fetch_or_throughput, 0 );
+GRAPPA_DEFINE_METRIC( SimpleMetric<double>, gups_atomic_fetch_and_throughput, 0 );
+GRAPPA_DEFINE_METRIC( SimpleMetric<double>, gups_atomic_fetch_xor_throughput, 0 );
+GRAPPA_DEFINE_METRIC( SimpleMetric<double>, gups_atomic_swap_throughput, 0 );
+GRAPPA_DEFINE_METRIC( SimpleMetric<double>, gups_atomic_cas_throughput, 0 );
+GRAPPA_DEFINE_METRIC( SimpleMetric<double>, gups_atomic_cas128_throughput, 0 );
+GRAPPA_DEFINE_METRIC( SimpleMetric<double>, gups_atomic_batch_fetch_add_throughput, 0 );
 
 const uint64_t LARGE_PRIME = 18446744073709551557UL;
 
@@ -78,6 +91,99 @@ void validate(GlobalAddress<int64_t> A, size_t n) {
 
 
 
+int64_t sum_array( GlobalAddress<int64_t> A ) {
+  return Grappa::sum_all_cores( [A]{
+      int64_t total = 0;
+      for( auto& v : iterate_local( A, FLAGS_sizeA ) ) total += v;
+      return total;
+    });
+}
+
+/// time FLAGS_iterations random updates of A, each done by `update(address, i)`
+template< typename F >
+double time_updates( GlobalAddress<int64_t> A, F update ) {
+  Grappa::memset(A, 0, FLAGS_sizeA);
+  double start = Grappa::walltime();
+  Grappa::forall<unbound>( 0, FLAGS_iterations, [A,update] ( int64_t i ) {
+      uint64_t b = (i * LARGE_PRIME) % FLAGS_sizeA;
+      update( A + b, i );
+    } );
+  double end = Grappa::walltime();
+  return FLAGS_iterations / (end - start);
+}
+
+/// measure each remote atomic op with the same random access pattern as gups
+void time_atomics( GlobalAddress<int64_t> A ) {
+  using namespace Grappa::delegate;
+  
+  gups_atomic_fetch_add_throughput = time_updates( A, []( GlobalAddress<int64_t> a, int64_t i ) {
+      atomic::fetch_and_add( a, 1 );
+    });
+  if( FLAGS_validate ) {
+    BOOST_CHECK_EQUAL( sum_array( A ), FLAGS_iterations );
+  }
+  gups_atomic_fetch_min_throughput = time_updates( A, []( GlobalAddress<int64_t> a, int64_t i ) {
+      atomic::fetch_and_min( a, -i );
+    });
+  gups_atomic_fetch_max_throughput = time_updates( A, []( GlobalAddress<int64_t> a, int64_t i ) {
+      atomic::fetch_and_max( a, i );
+    });
+  gups_atomic_fetch_or_throughput = time_updates( A, []( GlobalAddress<int64_t> a, int64_t i ) {
+      atomic::fetch_and_or( a, 1L << (i % 64) );
+    });
+  gups_atomic_fetch_and_throughput = time_updates( A, []( GlobalAddress<int64_t> a, int64_t i ) {
+      atomic::fetch_and_and( a, ~(1L << (i % 64)) );
+    });
+  gups_atomic_fetch_xor_throughput = time_updates( A, []( GlobalAddress<int64_t> a, int64_t i ) {
+      atomic::fetch_and_xor( a, i );
+    });
+  gups_atomic_swap_throughput = time_updates( A, []( GlobalAddress<int64_t> a, int64_t i ) {
+      atomic::swap( a, i );
+    });
+  gups_atomic_cas_throughput = time_updates( A, []( GlobalAddress<int64_t> a, int64_t i ) {
+      atomic::compare_and_swap( a, 0, i );
+    });
+  
+  // 128-bit compare and swap on pairs of words
+  auto A128 = static_cast< GlobalAddress< unsigned __int128 > >( A );
+  gups_atomic_cas128_throughput = time_updates( A, [A,A128]( GlobalAddress<int64_t> a, int64_t i ) {
+      auto p = A128 + (a - A) / 2;
+      atomic::compare_and_swap( p, (unsigned __int128) 0, (unsigned __int128) i );
+    });
+  
+  // vector form: each task issues FLAGS_atomic_batch updates in one call
+  Grappa::memset(A, 0, FLAGS_sizeA);
+  int64_t nbatch = (FLAGS_iterations + FLAGS_atomic_batch - 1) / FLAGS_atomic_batch;
+  double start = Grappa::walltime();
+  Grappa::forall<unbound>( 0, nbatch, [A] ( int64_t k ) {
+      int64_t first = k * FLAGS_atomic_batch;
+      int64_t n = std::min( FLAGS_atomic_batch, FLAGS_iterations - first );
+      std::vector< GlobalAddress<int64_t> > targets( n );
+      std::vector< int64_t > ones( n, 1 );
+      for( int64_t j = 0; j < n; j++ ) {
+        targets[j] = A + ((first + j) * LARGE_PRIME) % FLAGS_sizeA;
+      }
+      atomic::fetch_and_add( targets.data(), ones.data(), (int64_t*) NULL, n );
+    } );
+  double end = Grappa::walltime();
+  gups_atomic_batch_fetch_add_throughput = FLAGS_iterations / (end - start);
+  if( FLAGS_validate ) {
+    BOOST_CHECK_EQUAL( sum_array( A ), FLAGS_iterations );
+  }
+  
+  LOG(INFO) << "atomic fetch_and_add " << gups_atomic_fetch_add_throughput
+            << ", fetch_and_min " << gups_atomic_fetch_min_throughput
+            << ", fetch_and_max " << gups_atomic_fetch_max_throughput
+            << ", fetch_and_or " << gups_atomic_fetch_or_throughput
+            << ", fetch_and_and " << gups_atomic_fetch_and_throughput
+            << ", fetch_and_xor " << gups_atomic_fetch_xor_throughput
+            << ", swap " << gups_atomic_swap_throughput
+            << ", compare_and_swap " << gups_atomic_cas_throughput
+            << ", compare_and_swap (128-bit) " << gups_atomic_cas128_throughput
+            << ", batched fetch_and_add " << gups_atomic_batch_fetch_add_throughput
+            << " updates/s";
+}
+
 BOOST_AUTO_TEST_CASE( test1 ) {
   Grappa::init( GRAPPA_TEST_ARGS );
   Grappa::run([]{
@@ -120,6 +226,10 @@ BOOST_AUTO_TEST_CASE( test1 ) {
         validate(A, FLAGS_sizeA);
       }
 
+      if( FLAGS_atomics ) {
+        time_atomics( A );
+      }
+
      } while (FLAGS_repeats-- > 1);
 
     LOG(INFO) << "Done. ";
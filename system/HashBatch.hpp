@@ -0,0 +1,106 @@
+////////////////////////////////////////////////////////////////////////
+// This file is part of Grappa, a system for scaling irregular
+// applications on commodity clusters. 
+
+// Copyright (C) 2010-2014 University of Washington and Battelle
+// Memorial Institute. University of Washington authorizes use of this
+// Grappa software.
+
+// Grappa is free software: you can redistribute it and/or modify it
+// under the terms of the Affero General Public License as published
+// by Affero, Inc., either version 1 of the License, or (at your
+// option) any later version.
+
+// Grappa is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero General Public License for more details.
+
+// You should have received a copy of the Affero General Public
+// License along with this program. If not, you may obtain one from
+// http://www.affero.org/oagpl.html.
+////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include "Collective.hpp"
+#include "CompletionEvent.hpp"
+#include "LocaleSharedMemory.hpp"
+#include "Message.hpp"
+#include "Tasking.hpp"
+#include <type_traits>
+#include <vector>
+
+namespace Grappa {
+namespace impl {
+
+/// Bucket `n` items by destination core and ship each bucket in as few
+/// messages as possible, for the batch operations of GlobalHashMap and
+/// GlobalHashSet.
+///
+/// `make(i, dest)` returns item `i` and sets the core it goes to. At the
+/// destination, `on_arrival(items, n, ce)` runs in the message handler on
+/// each chunk of up to `per_msg` items, and must `complete(ce)` once (itself
+/// or from a reply). Blocks until every chunk has been completed.
+///
+/// @return the number of messages sent
+template< typename Item, typename M, typename F >
+size_t scatter_to_owners(size_t n, size_t per_msg, M make, F on_arrival) {
+  static_assert(std::is_trivially_copyable<Item>::value, "batched items are sent as raw bytes");
+  CHECK_GT(per_msg, 0);
+  
+  std::vector<Core> dests(n);
+  std::vector<size_t> offsets(cores()+1, 0);
+  // staged in the locale heap, since chunks are sent straight out of it
+  Item * buf = locale_alloc<Item>(std::max<size_t>(n, 1));
+  {
+    std::vector<Item> items;
+    items.reserve(n);
+    for (size_t i = 0; i < n; i++) {
+      items.push_back(make(i, dests[i]));
+      offsets[dests[i]+1]++;
+    }
+    for (Core c = 0; c < cores(); c++) offsets[c+1] += offsets[c];
+    std::vector<size_t> pos(offsets.begin(), offsets.end()-1);
+    for (size_t i = 0; i < n; i++) buf[pos[dests[i]]++] = items[i];
+  }
+  
+  size_t nmsgs = 0;
+  for (Core c = 0; c < cores(); c++) {
+    size_t m = offsets[c+1] - offsets[c];
+    nmsgs += m / per_msg + (m % per_msg ? 1 : 0);
+  }
+  
+  CompletionEvent ce(nmsgs);
+  auto cea = make_global(&ce);
+  for (Core c = 0; c < cores(); c++) {
+    for (size_t k = offsets[c]; k < offsets[c+1]; k += per_msg) {
+      size_t m = std::min(per_msg, offsets[c+1] - k);
+      send_heap_message(c, [cea,on_arrival](void * payload, size_t payload_size){
+        on_arrival(static_cast<const Item*>(payload), payload_size / sizeof(Item), cea);
+      }, buf + k, m * sizeof(Item));
+    }
+  }
+  ce.wait();
+  locale_free(buf);
+  return nmsgs;
+}
+
+/// Send `n` replies back to `dest` from a message handler. The replies are
+/// copied to the locale heap and sent by a spawned task, which frees them
+/// once the message has gone out. `on_arrival(items, n)` runs at `dest`.
+template< typename Item, typename F >
+void reply_with(Core dest, const Item * items, size_t n, F on_arrival) {
+  Item * buf = locale_alloc<Item>(std::max<size_t>(n, 1));
+  std::copy(items, items + n, buf);
+  spawn([dest,buf,n,on_arrival]{
+    {
+      auto msg = send_message(dest, [on_arrival](void * payload, size_t payload_size){
+        on_arrival(static_cast<const Item*>(payload), payload_size / sizeof(Item));
+      }, buf, n * sizeof(Item));
+    } // blocks until sent
+    locale_free(buf);
+  });
+}
+
+} // namespace impl
+} // namespace Grappa
@@ -0,0 +1,315 @@
+////////////////////////////////////////////////////////////////////////
+// This file is part of Grappa, a system for scaling irregular
+// applications on commodity clusters. 
+
+// Copyright (C) 2010-2014 University of Washington and Battelle
+// Memorial Institute. University of Washington authorizes use of this
+// Grappa software.
+
+// Grappa is free software: you can redistribute it and/or modify it
+// under the terms of the Affero General Public License as published
+// by Affero, Inc., either version 1 of the License, or (at your
+// option) any later version.
+
+// Grappa is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero General Public License for more details.
+
+// You should have received a copy of the Affero General Public
+// License along with this program. If not, you may obtain one from
+// http://www.affero.org/oagpl.html.
+////////////////////////////////////////////////////////////////////////
+#include "IOEngine.hpp"
+#include "CompletionEvent.hpp"
+#include "ConditionVariable.hpp"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <algorithm>
+#include <vector>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define GRAPPA_HAVE_IO_URING
+#endif
+#endif
+
+DECLARE_uint64( io_blocksize_mb );
+
+DEFINE_string( io_engine, "uring", "File I/O engine: 'uring' (io_uring polled by the scheduler) or 'aio' (signal-driven POSIX AIO / blocking pread); falls back to 'aio' if io_uring can't be set up" );
+DEFINE_int64( io_uring_depth, 128, "Submission queue entries in each core's io_uring (max requests in flight per core)" );
+DEFINE_bool( io_direct, false, "Open files for reading with O_DIRECT (bypassing the page cache) when using the io_uring engine" );
+
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, io_uring_ops, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, io_uring_bytes, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, io_uring_submit_calls, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, io_uring_full_waits, 0);
+
+namespace Grappa {
+namespace impl {
+
+/// alignment required of O_DIRECT buffers, offsets and lengths
+static const size_t direct_alignment = 4096;
+
+/// One piece of a read or write, referenced by its submission's user_data.
+struct IORequest {
+  struct iovec iov;
+  ssize_t result;
+  CompletionEvent * ce;
+};
+
+#ifdef GRAPPA_HAVE_IO_URING
+
+struct Ring {
+  int fd = -1;
+  
+  void * sq_ptr = nullptr; size_t sq_bytes = 0;
+  void * cq_ptr = nullptr; size_t cq_bytes = 0;
+  struct io_uring_sqe * sqes = nullptr; size_t sqes_bytes = 0;
+  
+  unsigned * sq_tail; unsigned * sq_mask; unsigned * sq_array; unsigned sq_entries;
+  unsigned * cq_head; unsigned * cq_tail; unsigned * cq_mask; struct io_uring_cqe * cqes;
+  
+  unsigned to_submit = 0;  ///< queued since the last io_uring_enter
+  unsigned inflight = 0;   ///< queued or submitted, not yet completed
+  ConditionVariable slot_free;
+  
+  bool setup( unsigned depth ) {
+    struct io_uring_params p;
+    memset( &p, 0, sizeof(p) );
+    fd = syscall( __NR_io_uring_setup, depth, &p );
+    if( fd < 0 ) return false;
+    
+    sq_bytes = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cq_bytes = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+    if( single ) sq_bytes = cq_bytes = std::max( sq_bytes, cq_bytes );
+    
+    sq_ptr = mmap( nullptr, sq_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING );
+    if( sq_ptr == MAP_FAILED ) { sq_ptr = nullptr; return false; }
+    if( single ) {
+      cq_ptr = sq_ptr;
+    } else {
+      cq_ptr = mmap( nullptr, cq_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING );
+      if( cq_ptr == MAP_FAILED ) { cq_ptr = nullptr; return false; }
+    }
+    sqes_bytes = p.sq_entries * sizeof(struct io_uring_sqe);
+    sqes = static_cast< struct io_uring_sqe * >( mmap( nullptr, sqes_bytes, PROT_READ | PROT_WRITE,
+                                                       MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES ) );
+    if( sqes == MAP_FAILED ) { sqes = nullptr; return false; }
+    
+    char * sq = static_cast< char * >( sq_ptr );
+    char * cq = static_cast< char * >( cq_ptr );
+    sq_tail  = reinterpret_cast< unsigned * >( sq + p.sq_off.tail );
+    sq_mask  = reinterpret_cast< unsigned * >( sq + p.sq_off.ring_mask );
+    sq_array = reinterpret_cast< unsigned * >( sq + p.sq_off.array );
+    sq_entries = p.sq_entries;
+    cq_head  = reinterpret_cast< unsigned * >( cq + p.cq_off.head );
+    cq_tail  = reinterpret_cast< unsigned * >( cq + p.cq_off.tail );
+    cq_mask  = reinterpret_cast< unsigned * >( cq + p.cq_off.ring_mask );
+    cqes     = reinterpret_cast< struct io_uring_cqe * >( cq + p.cq_off.cqes );
+    return true;
+  }
+  
+  void teardown() {
+    if( sqes ) munmap( sqes, sqes_bytes );
+    if( cq_ptr && cq_ptr != sq_ptr ) munmap( cq_ptr, cq_bytes );
+    if( sq_ptr ) munmap( sq_ptr, sq_bytes );
+    if( fd >= 0 ) close( fd );
+    fd = -1; sq_ptr = cq_ptr = nullptr; sqes = nullptr;
+  }
+  
+  /// Queue a request; suspends the caller while the ring is full. (Keeping
+  /// in-flight requests within the SQ size also keeps the CQ from overflowing.)
+  void queue( uint8_t opcode, int file, IORequest * r, size_t offset ) {
+    while( inflight >= sq_entries ) {
+      io_uring_full_waits++;
+      Grappa::wait( &slot_free );
+    }
+    unsigned tail = *sq_tail;
+    unsigned index = tail & *sq_mask;
+    struct io_uring_sqe * sqe = &sqes[index];
+    memset( sqe, 0, sizeof(*sqe) );
+    sqe->opcode = opcode;
+    sqe->fd = file;
+    sqe->addr = reinterpret_cast< uint64_t >( &r->iov );
+    sqe->len = 1;
+    sqe->off = offset;
+    sqe->user_data = reinterpret_cast< uint64_t >( r );
+    sq_array[index] = index;
+    __atomic_store_n( sq_tail, tail + 1, __ATOMIC_RELEASE );
+    to_submit++;
+    inflight++;
+    io_uring_ops++;
+  }
+  
+  void poll() {
+    if( to_submit > 0 ) {
+      int ret = syscall( __NR_io_uring_enter, fd, to_submit, 0, 0, nullptr, 0 );
+      io_uring_submit_calls++;
+      if( ret > 0 ) {
+        to_submit -= ret;
+      } else if( ret < 0 && errno != EAGAIN && errno != EBUSY && errno != EINTR ) {
+        PLOG(FATAL) << "io_uring_enter failed";
+      }
+    }
+    
+    unsigned head = *cq_head;
+    unsigned tail = __atomic_load_n( cq_tail, __ATOMIC_ACQUIRE );
+    if( head == tail ) return;
+    for( ; head != tail; head++ ) {
+      struct io_uring_cqe * cqe = &cqes[ head & *cq_mask ];
+      IORequest * r = reinterpret_cast< IORequest * >( cqe->user_data );
+      r->result = cqe->res;
+      if( cqe->res > 0 ) io_uring_bytes += cqe->res;
+      inflight--;
+      r->ce->complete();
+    }
+    __atomic_store_n( cq_head, head, __ATOMIC_RELEASE );
+    broadcast( &slot_free );
+  }
+};
+
+static Ring ring;
+
+#endif // GRAPPA_HAVE_IO_URING
+
+static bool uring_enabled = false;
+
+void io_engine_init() {
+#ifdef GRAPPA_HAVE_IO_URING
+  if( FLAGS_io_engine == "uring" ) {
+    uring_enabled = ring.setup( FLAGS_io_uring_depth );
+    if( !uring_enabled ) {
+      LOG(WARNING) << "io_uring setup failed (" << strerror( errno ) << "); using the aio engine";
+      ring.teardown();
+    }
+  }
+#else
+  if( FLAGS_io_engine == "uring" ) {
+    VLOG(1) << "built without io_uring support; using the aio engine";
+  }
+#endif
+}
+
+void io_engine_finish() {
+#ifdef GRAPPA_HAVE_IO_URING
+  if( uring_enabled ) ring.teardown();
+  uring_enabled = false;
+#endif
+}
+
+void io_poll() {
+#ifdef GRAPPA_HAVE_IO_URING
+  if( uring_enabled ) ring.poll();
+#endif
+}
+
+bool io_uring_enabled() { return uring_enabled; }
+
+int io_open( const char * fname, int flags, mode_t mode ) {
+  if( FLAGS_io_direct && uring_enabled && (flags & O_ACCMODE) == O_RDONLY ) {
+    int fd = open( fname, flags | O_DIRECT, mode );
+    if( fd >= 0 ) return fd;
+    // some filesystems (tmpfs) refuse O_DIRECT; read through the page cache instead
+  }
+  return open( fname, flags, mode );
+}
+
+/// Split [offset, offset+n) into pieces of at most --io_blocksize_mb, have
+/// them all in flight at once, and wait for them. Falls back to
+/// pread/pwrite without the ring.
+static ssize_t transfer( bool is_write, int fd, char * buf, size_t n, size_t offset ) {
+#ifdef GRAPPA_HAVE_IO_URING
+  if( uring_enabled && n > 0 ) {
+    size_t piece = std::max< size_t >( FLAGS_io_blocksize_mb << 20, direct_alignment );
+    size_t npieces = (n + piece - 1) / piece;
+    std::vector< IORequest > reqs( npieces );
+    CompletionEvent ce( npieces );
+    for( size_t i = 0; i < npieces; i++ ) {
+      size_t len = std::min( piece, n - i*piece );
+      reqs[i].iov.iov_base = buf + i*piece;
+      reqs[i].iov.iov_len = len;
+      reqs[i].ce = &ce;
+      ring.queue( is_write ? IORING_OP_WRITEV : IORING_OP_READV, fd, &reqs[i], offset + i*piece );
+    }
+    ce.wait();
+    
+    // total is the contiguous prefix transferred; finish any short pieces
+    size_t total = 0;
+    for( size_t i = 0; i < npieces; i++ ) {
+      size_t len = reqs[i].iov.iov_len;
+      if( reqs[i].result < 0 ) return reqs[i].result;
+      size_t done = reqs[i].result;
+      if( done < len && done > 0 ) {
+        ssize_t more = transfer( is_write, fd, buf + i*piece + done, len - done, offset + i*piece + done );
+        if( more < 0 ) return more;
+        done += more;
+      }
+      total += done;
+      if( done < len ) break;   // end of file
+    }
+    return total;
+  }
+#endif
+  size_t total = 0;
+  while( total < n ) {
+    ssize_t r = is_write ? pwrite( fd, buf + total, n - total, offset + total )
+                         : pread( fd, buf + total, n - total, offset + total );
+    if( r < 0 ) {
+      if( errno == EINTR ) continue;
+      return -errno;
+    }
+    if( r == 0 ) break;
+    total += r;
+  }
+  return total;
+}
+
+ssize_t io_read( int fd, void * buf, size_t n, size_t offset ) {
+  char * dst = static_cast< char * >( buf );
+  bool direct = uring_enabled && (fcntl( fd, F_GETFL ) & O_DIRECT);
+  if( !direct || ( reinterpret_cast< uintptr_t >( dst ) % direct_alignment == 0
+                   && offset % direct_alignment == 0 && n % direct_alignment == 0 ) ) {
+    return transfer( false, fd, dst, n, offset );
+  }
+  
+  // unaligned request on an O_DIRECT file: read aligned spans into a bounce
+  // buffer, a block at a time, and copy out the part that was asked for
+  size_t bounce_bytes = std::max< size_t >( FLAGS_io_blocksize_mb << 20, direct_alignment );
+  bounce_bytes = (bounce_bytes + direct_alignment - 1) / direct_alignment * direct_alignment;
+  void * bounce = nullptr;
+  CHECK_EQ( posix_memalign( &bounce, direct_alignment, bounce_bytes ), 0 );
+  
+  size_t total = 0;
+  while( total < n ) {
+    size_t pos = offset + total;
+    size_t aligned = pos / direct_alignment * direct_alignment;
+    size_t want = std::min( bounce_bytes, (pos - aligned) + (n - total) );
+    want = (want + direct_alignment - 1) / direct_alignment * direct_alignment;
+    ssize_t r = transfer( false, fd, static_cast< char * >( bounce ), want, aligned );
+    if( r < 0 ) { free( bounce ); return r; }
+    if( static_cast< size_t >( r ) <= pos - aligned ) break;   // end of file
+    size_t got = std::min( r - (pos - aligned), n - total );
+    memcpy( dst + total, static_cast< char * >( bounce ) + (pos - aligned), got );
+    total += got;
+    if( static_cast< size_t >( r ) < want ) break;
+  }
+  free( bounce );
+  return total;
+}
+
+ssize_t io_write( int fd, const void * buf, size_t n, size_t offset ) {
+  return transfer( true, fd, static_cast< char * >( const_cast< void * >( buf ) ), n, offset );
+}
+
+} // namespace impl
+} // namespace Grappa
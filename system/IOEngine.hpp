@@ -0,0 +1,77 @@
+////////////////////////////////////////////////////////////////////////
+// This file is part of Grappa, a system for scaling irregular
+// applications on commodity clusters. 
+
+// Copyright (C) 2010-2014 University of Washington and Battelle
+// Memorial Institute. University of Washington authorizes use of this
+// Grappa software.
+
+// Grappa is free software: you can redistribute it and/or modify it
+// under the terms of the Affero General Public License as published
+// by Affero, Inc., either version 1 of the License, or (at your
+// option) any later version.
+
+// Grappa is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero General Public License for more details.
+
+// You should have received a copy of the Affero General Public
+// License along with this program. If not, you may obtain one from
+// http://www.affero.org/oagpl.html.
+////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <sys/types.h>
+#include <gflags/gflags.h>
+#include "Metrics.hpp"
+
+DECLARE_string( io_engine );
+DECLARE_int64( io_uring_depth );
+DECLARE_bool( io_direct );
+
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, io_uring_ops);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, io_uring_bytes);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, io_uring_submit_calls);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, io_uring_full_waits);
+
+namespace Grappa {
+namespace impl {
+
+/// Per-core file I/O engine built on io_uring.
+///
+/// Requests are queued on the core's submission ring by the calling worker,
+/// which then suspends; the polling thread submits everything queued with
+/// one `io_uring_enter` and wakes workers as their completions arrive, so
+/// there are no helper threads or signals. A request larger than
+/// --io_blocksize_mb is split into pieces that are all in flight at once, up
+/// to --io_uring_depth per core.
+///
+/// If io_uring is unavailable (old kernel, seccomp) or --io_engine=aio, the
+/// calls below fall back to pread/pwrite.
+
+/// Set up this core's ring (called from Grappa_init).
+void io_engine_init();
+/// Tear down this core's ring (called from Grappa_finish).
+void io_engine_finish();
+/// Submit queued requests and complete finished ones; called by the poller.
+void io_poll();
+
+/// Is the io_uring engine in use on this core?
+bool io_uring_enabled();
+
+/// Open a file; adds O_DIRECT to read-only opens when --io_direct is set and
+/// the io_uring engine is in use. Returns -1 on failure, like open().
+int io_open( const char * fname, int flags, mode_t mode = 0644 );
+
+/// Read `n` bytes at `offset`, suspending only the calling worker. Handles
+/// unaligned requests on O_DIRECT files by bouncing through an aligned buffer.
+/// @return bytes read (short only at end of file), or -errno
+ssize_t io_read( int fd, void * buf, size_t n, size_t offset );
+
+/// Write `n` bytes at `offset`, suspending only the calling worker.
+/// @return bytes written, or -errno
+ssize_t io_write( int fd, const void * buf, size_t n, size_t offset );
+
+} // namespace impl
+} // namespace Grappa
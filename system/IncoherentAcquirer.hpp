@@ -119,7 +119,7 @@ public:
       DVLOG(5) << " address + count block max is " << (*request_address_ + *count_).block_max();
       DVLOG(5) << " address block min " << request_address_->block_min();
       DVLOG(5) << "Straddle: diff is " << byte_diff << " bs " << block_size;
-      num_messages_ = byte_diff / block_size;
+      num_messages_ = byte_diff / request_address_->block_bytes();
     }
 
     if( num_messages_ > 1 ) DVLOG(5) << "****************************** MULTI BLOCK CACHE REQUEST ******************************";
@@ -142,7 +142,7 @@ public:
       size_t total_bytes = *count_ * sizeof(T);
       
       // allocate enough requests/messages that we don't run out
-      size_t nmsg = total_bytes / block_size + 2;
+      size_t nmsg = total_bytes / request_address_->block_bytes() + 2;
       size_t msg_size = sizeof(Grappa::Message<RequestArgs>);
       
       do_acquire();
@@ -104,7 +104,7 @@ public:
       DVLOG(5) << " multiplied difference is " << ( (*request_address_ + *count_ - 1).block_max() - request_address_->block_min() ) * sizeof(T);
       DVLOG(5) << " address block min " << request_address_->block_min();
       DVLOG(5) << "Straddle: diff is " << byte_diff << " bs " << block_size;
-      num_messages_ = byte_diff / block_size;
+      num_messages_ = byte_diff / request_address_->block_bytes();
     }
 
     if( num_messages_ > 1 ) DVLOG(5) << "****************************** MULTI BLOCK CACHE REQUEST ******************************";
@@ -127,7 +127,7 @@ public:
       size_t total_bytes = *count_ * sizeof(T);
 
       // allocate enough requests/messages that we don't run out
-      size_t nmsg = total_bytes / block_size + 2;
+      size_t nmsg = total_bytes / request_address_->block_bytes() + 2;
       size_t msg_size = sizeof(Grappa::PayloadMessage<RequestArgs>);
       
       do_release();
@@ -22,6 +22,8 @@
 ////////////////////////////////////////////////////////////////////////
 
 #include "LocaleSharedMemory.hpp"
+#include "Metrics.hpp"
+#include "tasks/TaskingScheduler.hpp"
 
 DEFINE_int64( locale_shared_size, 0, "Total shared memory between cores on node (when 0, defaults to locale_shared_fraction * total node memory)" );
 
@@ -31,11 +33,31 @@ DEFINE_double( locale_user_heap_fraction, 0.1, "Fraction of locale shared memory
 
 DEFINE_double( global_heap_fraction, 0.25, "Fraction of locale shared memory to set aside for global shared heap" );
 
+DEFINE_int64( user_memory_budget, 0, "Soft per-core budget in bytes for locale_alloc'd memory; spawns block while exceeded (0 for none)" );
+
+DEFINE_int64( cache_memory_budget, 0, "Soft per-core budget in bytes for Incoherent cache storage; spawns block while exceeded (0 for none)" );
+
+DEFINE_int64( stack_memory_budget, 0, "Soft per-core budget in bytes for Worker stacks; no extra workers are created beyond it (0 for none)" );
+
+GRAPPA_DEFINE_METRIC( SimpleMetric<int64_t>, memory_high_water_user, 0 );
+GRAPPA_DEFINE_METRIC( SimpleMetric<int64_t>, memory_high_water_global_heap, 0 );
+GRAPPA_DEFINE_METRIC( SimpleMetric<int64_t>, memory_high_water_aggregator, 0 );
+GRAPPA_DEFINE_METRIC( SimpleMetric<int64_t>, memory_high_water_stacks, 0 );
+GRAPPA_DEFINE_METRIC( SimpleMetric<int64_t>, memory_high_water_cache, 0 );
+GRAPPA_DEFINE_METRIC( SimpleMetric<int64_t>, memory_high_water_message_pool, 0 );
+GRAPPA_DEFINE_METRIC( SimpleMetric<int64_t>, memory_high_water_system, 0 );
+
+/// number of times a task was held back because a memory budget was exceeded
+GRAPPA_DEFINE_METRIC( SimpleMetric<int64_t>, memory_budget_stalls, 0 );
+
 DECLARE_int64( node_memsize );
 DECLARE_bool( global_memory_use_hugepages );
 
 // forward declarations
 namespace Grappa {
+
+extern Worker * master_thread;
+
 namespace impl {
 
 /// called on failures to backtrace and pause for debugger
@@ -58,6 +80,29 @@ namespace impl {
 /// global LocaleSharedMemory instance
 LocaleSharedMemory locale_shared_memory;
 
+static Grappa::SimpleMetric<int64_t> * high_water_metrics[] = {
+  &memory_high_water_user,
+  &memory_high_water_global_heap,
+  &memory_high_water_aggregator,
+  &memory_high_water_stacks,
+  &memory_high_water_cache,
+  &memory_high_water_message_pool,
+  &memory_high_water_system,
+};
+
+const char * memory_category_name( MemoryCategory c ) {
+  switch( c ) {
+  case MemoryCategory::User:        return "user";
+  case MemoryCategory::GlobalHeap:  return "global_heap";
+  case MemoryCategory::Aggregator:  return "aggregator";
+  case MemoryCategory::Stacks:      return "stacks";
+  case MemoryCategory::Cache:       return "cache";
+  case MemoryCategory::MessagePool: return "message_pool";
+  case MemoryCategory::System:      return "system";
+  default:                          return "unknown";
+  }
+}
+
 
 
 
@@ -139,6 +184,8 @@ LocaleSharedMemory::LocaleSharedMemory()
   , base_address( reinterpret_cast<void*>( 0x400000000000L ) )
   , segment() // default constructor; initialize later
   , allocated(0)
+  , accounts()
+  , over_budget_( false )
 { 
   boost::interprocess::shared_memory_object::remove( region_name.c_str() );
 
@@ -165,6 +212,10 @@ void LocaleSharedMemory::activate() {
   if( Grappa::locale_mycore() != 0 ) { attach(); }
   global_communicator.barrier();
   //available = global_bytes_per_core;
+
+  set_budget( MemoryCategory::User, FLAGS_user_memory_budget );
+  set_budget( MemoryCategory::Cache, FLAGS_cache_memory_budget );
+  set_budget( MemoryCategory::Stacks, FLAGS_stack_memory_budget );
 }
 
 void LocaleSharedMemory::finish() {
@@ -172,40 +223,121 @@ void LocaleSharedMemory::finish() {
   if( Grappa::locale_mycore() == 0 ) { destroy(); }
 }
 
-void * LocaleSharedMemory::allocate( size_t size ) {
+void LocaleSharedMemory::account( void * p, MemoryCategory c, bool alloc ) {
+  if( p == NULL ) return;
+
+  // charge the size of the block actually handed out so frees balance exactly
+  account_bytes( segment.get_segment_manager()->size( p ), c, alloc );
+}
+
+void LocaleSharedMemory::account_bytes( int64_t size, MemoryCategory c, bool alloc ) {
+  auto& a = accounts[ static_cast<int>(c) ];
+  if( alloc ) {
+    a.current += size;
+    allocated += size;
+    if( a.current > a.high_water ) {
+      a.high_water = a.current;
+      *high_water_metrics[ static_cast<int>(c) ] = a.high_water;
+    }
+  } else {
+    a.current -= size;
+    allocated -= size;
+  }
+
+  if( a.budget > 0 || over_budget_ ) {
+    over_budget_ = false;
+    for( int i = 0; i < static_cast<int>( MemoryCategory::Count ); ++i ) {
+      over_budget_ |= over_budget( static_cast<MemoryCategory>(i) );
+    }
+  }
+}
+
+void LocaleSharedMemory::log_accounts() {
+  LOG(ERROR) << "Locale shared memory use on core " << global_communicator.mycore << ":";
+  for( int i = 0; i < static_cast<int>( MemoryCategory::Count ); ++i ) {
+    auto& a = accounts[i];
+    LOG(ERROR) << "  " << memory_category_name( static_cast<MemoryCategory>(i) )
+               << ": " << a.current << " bytes (high water " << a.high_water
+               << ", budget " << a.budget << ")";
+  }
+}
+
+void LocaleSharedMemory::set_budget( MemoryCategory c, int64_t bytes ) {
+  accounts[ static_cast<int>(c) ].budget = bytes;
+  over_budget_ = false;
+  for( int i = 0; i < static_cast<int>( MemoryCategory::Count ); ++i ) {
+    over_budget_ |= over_budget( static_cast<MemoryCategory>(i) );
+  }
+}
+
+void LocaleSharedMemory::wait_for_budget() {
+  // can't block in message handlers or outside of tasks
+  if( global_scheduler.in_no_switch_region() ||
+      global_scheduler.get_current_thread() == Grappa::master_thread ) return;
+
+  // only wait while someone else might still free memory
+  bool stalled = false;
+  while( over_budget_ && global_scheduler.active_task_count() > 1 ) {
+    if( !stalled ) {
+      memory_budget_stalls++;
+      stalled = true;
+    }
+    global_communicator.poll();
+    Grappa::yield();
+  }
+}
+
+void * LocaleSharedMemory::allocate( size_t size, MemoryCategory c ) {
   void * p = NULL;
   try {
     p = segment.allocate( size );
-    allocated += size;
+    account( p, c, true );
   }
   catch(...){
-    LOG(ERROR) << "Allocation of " << size << " bytes failed with " 
-               << get_free_memory() << " free and "
+    LOG(ERROR) << "Allocation of " << size << " bytes for " << memory_category_name(c)
+               << " failed with " << get_free_memory() << " free and "
                << allocated << " allocated locally";
+    log_accounts();
     failure_function();
     throw;
   }
   return p;
 }
 
-void * LocaleSharedMemory::allocate_aligned( size_t size, size_t alignment ) {
+void * LocaleSharedMemory::find_or_create_named( const char * name, size_t size ) {
+  try {
+    // find_or_construct is atomic across the processes sharing the segment
+    return segment.find_or_construct< char >( name )[ size ]( 0 );
+  }
+  catch(...){
+    LOG(ERROR) << "Named allocation '" << name << "' of " << size << " bytes failed with "
+               << get_free_memory() << " free";
+    failure_function();
+    throw;
+  }
+}
+
+void * LocaleSharedMemory::allocate_aligned( size_t size, size_t alignment, MemoryCategory c ) {
   void * p = NULL;
   try {
     p = segment.allocate_aligned( size, alignment );
-    allocated += size;
+    account( p, c, true );
   }
   catch(...){
     LOG(ERROR) << "Allocation of " << size << " bytes with alignment " << alignment 
+               << " for " << memory_category_name(c)
                << " failed with " << get_free_memory() << " free and "
                << allocated << " allocated locally";
+    log_accounts();
     failure_function();
     throw;
   }
   return p;
 }
 
-void LocaleSharedMemory::deallocate( void * ptr ) {
+void LocaleSharedMemory::deallocate( void * ptr, MemoryCategory c ) {
   try {
+    account( ptr, c, false );
     segment.deallocate( ptr );
   }
   catch(...){
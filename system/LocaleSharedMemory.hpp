@@ -37,6 +37,21 @@
 namespace Grappa {
 namespace impl {
 
+/// Subsystems whose use of the locale shared heap is accounted separately,
+/// so exhaustion can be blamed on someone and soft budgets can be enforced.
+enum class MemoryCategory : int {
+  User = 0,     ///< locale_alloc() and friends
+  GlobalHeap,   ///< this core's chunk of the global heap
+  Aggregator,   ///< RDMA aggregator buffers
+  Stacks,       ///< Worker stacks
+  Cache,        ///< Incoherent cache storage
+  MessagePool,  ///< shared message pool chunks and oversized messages
+  System,       ///< other runtime structures (steal queues, buffer vectors, ...)
+  Count
+};
+
+const char * memory_category_name( MemoryCategory c );
+
 class LocaleSharedMemory {
 private:
   size_t region_size;
@@ -45,6 +60,20 @@ private:
   
   size_t allocated;
 
+  /// bytes currently allocated by this core, high-water mark and soft budget (0 = none)
+  struct Account {
+    int64_t current;
+    int64_t high_water;
+    int64_t budget;
+  };
+  Account accounts[ static_cast<int>( MemoryCategory::Count ) ];
+
+  /// true if any category is over its budget
+  bool over_budget_;
+
+  void account( void * p, MemoryCategory c, bool alloc );
+  void log_accounts();
+
   void create();
   void attach();
   void destroy();
@@ -78,13 +107,40 @@ public:
   }
     //#endif
 
-  void * allocate( size_t size );
-  void * allocate_aligned( size_t size, size_t alignment );
-  void deallocate( void * ptr );
+  void * allocate( size_t size, MemoryCategory c = MemoryCategory::User );
+  void * allocate_aligned( size_t size, size_t alignment, MemoryCategory c = MemoryCategory::User );
+  /// Find the zero-filled block of `size` bytes with the given name, allocating it if
+  /// no core in the locale has yet; safe for cores of a locale to race on. Used for
+  /// state shared by a locale's cores, and not freed until the segment is destroyed.
+  void * find_or_create_named( const char * name, size_t size );
+  /// Free memory; `c` must match the category it was allocated under.
+  void deallocate( void * ptr, MemoryCategory c = MemoryCategory::User );
+  /// Charge (or, if `!alloc`, credit) `size` bytes that this core got from
+  /// somewhere other than the locale segment, such as the huge page global heap.
+  void account_bytes( int64_t size, MemoryCategory c, bool alloc );
 
   const size_t get_free_memory() const { return segment.get_free_memory(); }
   const size_t get_size() const { return segment.get_size(); }
   const size_t get_allocated() const { return allocated; }
+
+  int64_t get_allocated( MemoryCategory c ) const { return accounts[ static_cast<int>(c) ].current; }
+  int64_t get_high_water( MemoryCategory c ) const { return accounts[ static_cast<int>(c) ].high_water; }
+
+  /// Set soft per-core budget in bytes for a category (0 for no budget).
+  void set_budget( MemoryCategory c, int64_t bytes );
+  int64_t get_budget( MemoryCategory c ) const { return accounts[ static_cast<int>(c) ].budget; }
+
+  bool over_budget() const { return over_budget_; }
+  bool over_budget( MemoryCategory c ) const {
+    auto& a = accounts[ static_cast<int>(c) ];
+    return a.budget > 0 && a.current > a.budget;
+  }
+
+  /// Apply backpressure: if some category is over budget, yield the
+  /// calling task (while other tasks are active and might free memory)
+  /// until usage drops back under budget. Returns immediately when
+  /// called from a context that cannot block.
+  void wait_for_budget();
 };
 
 
@@ -126,6 +182,14 @@ inline T* locale_new() {
   return new (locale_alloc<T>()) T();
 }
 
+/// If a soft memory budget (see --user_memory_budget etc.) is exceeded,
+/// block the calling task until other tasks have released memory.
+inline void memory_backpressure() {
+  if( impl::locale_shared_memory.over_budget() ) {
+    impl::locale_shared_memory.wait_for_budget();
+  }
+}
+
 /// Free memory that was allocated from locale shared heap.
 inline void locale_free(void * ptr) {
   impl::locale_shared_memory.deallocate(ptr);
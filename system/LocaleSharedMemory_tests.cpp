@@ -64,6 +64,47 @@ BOOST_AUTO_TEST_CASE( test1 ) {
         BOOST_CHECK_EQUAL( arr[ Grappa::locale_mycore() ], other_index );
       });
 
+    LOG(INFO) << "Checking accounting";
+    using Grappa::impl::MemoryCategory;
+    auto& lsm = Grappa::impl::locale_shared_memory;
+    BOOST_CHECK_GT( lsm.get_allocated( MemoryCategory::GlobalHeap ), 0 );
+    BOOST_CHECK_GT( lsm.get_allocated( MemoryCategory::Stacks ), 0 );
+    
+    const int64_t sz = 1 << 20;
+    auto before = lsm.get_allocated( MemoryCategory::User );
+    void * p = Grappa::locale_alloc( sz );
+    BOOST_CHECK_GE( lsm.get_allocated( MemoryCategory::User ), before + sz );
+    BOOST_CHECK_GE( lsm.get_high_water( MemoryCategory::User ), before + sz );
+    Grappa::locale_free( p );
+    BOOST_CHECK_EQUAL( lsm.get_allocated( MemoryCategory::User ), before );
+    BOOST_CHECK( !lsm.over_budget() );
+    
+    LOG(INFO) << "Checking budget backpressure";
+    struct { bool go; bool freed; void * p; } st = { false, false, nullptr };
+    Grappa::CompletionEvent started(1), done(2);
+    lsm.set_budget( MemoryCategory::User, before + sz / 2 );
+    
+    // this task holds the memory that puts us over budget
+    Grappa::spawn([&st,&started,&done]{
+      started.complete();
+      while( !st.go ) Grappa::yield();
+      Grappa::locale_free( st.p );
+      st.freed = true;
+      done.complete();
+    });
+    started.wait();
+    
+    st.p = Grappa::locale_alloc( sz );
+    BOOST_CHECK( lsm.over_budget() );
+    st.go = true;
+    
+    // spawning is held back until the other task frees its memory
+    Grappa::spawn([&done]{ done.complete(); });
+    BOOST_CHECK( st.freed );
+    BOOST_CHECK( !lsm.over_budget() );
+    done.wait();
+    lsm.set_budget( MemoryCategory::User, 0 );
+
     LOG(INFO) << "Done";
   });
   Grappa::finalize();
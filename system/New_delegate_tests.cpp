@@ -187,6 +187,37 @@ void check_async_delegates() {
   BOOST_CHECK_EQUAL(delegate::read(make_global(&global_y,1)), N);
 }
 
+void check_read_async() {
+  BOOST_MESSAGE("check_read_async");
+  const int64_t N = 100;
+  auto A = global_alloc<int64_t>(N);
+  forall(A, N, [](int64_t i, int64_t& e){ e = i; });
+  
+  // futures can be collected and waited on out of order
+  std::vector<delegate::Future<int64_t>> fs;
+  for (int64_t i=0; i<N; i++) fs.push_back(delegate::read_async(A+i));
+  for (int64_t i=N-1; i>=0; i--) BOOST_CHECK_EQUAL(fs[i].get(), i);
+  
+  auto f = delegate::call_async(1, []{ return mycore(); });
+  f.wait();
+  BOOST_CHECK(f.ready());
+  BOOST_CHECK_EQUAL(f.get(), 1);
+  
+  // window smaller than, equal to, and larger than the stream
+  for (int64_t n : {N, (int64_t)7, (int64_t)1, (int64_t)0}) {
+    int64_t next = 0, total = 0;
+    delegate::prefetch_window<7>(n, [A,N](int64_t i){ return A + (N-1-i); },
+                                 [&](int64_t i, int64_t v){
+      BOOST_CHECK_EQUAL(i, next++);
+      BOOST_CHECK_EQUAL(v, N-1-i);
+      total += v;
+    });
+    BOOST_CHECK_EQUAL(next, n);
+    BOOST_CHECK_EQUAL(total, (2*N-1-n)*n/2);
+  }
+  global_free(A);
+}
+
 uint64_t fc_targ = 0;
 uint64_t non_fc_targ = 0;
 void check_fetch_add_combining() {
@@ -243,6 +274,8 @@ BOOST_AUTO_TEST_CASE( test1 ) {
   
     check_async_delegates();
 
+    check_read_async();
+
     check_fetch_add_combining();
  
     check_call_suspending();
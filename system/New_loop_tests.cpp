@@ -34,6 +34,10 @@
 #include "Array.hpp"
 #include "Collective.hpp"
 
+DEFINE_int64( gce_phases, 100, "Number of fine-grained GlobalCompletionEvent phases to time" );
+
+DECLARE_int64( collective_tree_fanout );
+
 BOOST_AUTO_TEST_SUITE( New_loop_tests );
 
 using namespace Grappa;
@@ -297,6 +301,30 @@ void test_forall_here_async() {
   }
 }
 
+/// Many short async phases, so termination detection dominates. Run with
+/// different --collective_tree_fanout (0 is the flat, master-centric scheme)
+/// to compare.
+void test_gce_phases() {
+  BOOST_MESSAGE("Timing fine-grained GCE phases...");
+  const int64_t N = cores() * 64;
+  auto array = Grappa::global_alloc<int64_t>(N);
+  Grappa::memset(array, 0, N);
+  
+  double start = Grappa::walltime();
+  for (int64_t p = 0; p < FLAGS_gce_phases; p++) {
+    forall<async,&my_gce>(array, N, [](int64_t& e){ e++; });
+    my_gce.wait();
+  }
+  double phase_time = (Grappa::walltime() - start) / FLAGS_gce_phases;
+  
+  for (int64_t i = 0; i < N; i++) {
+    BOOST_CHECK_EQUAL(delegate::read(array+i), FLAGS_gce_phases);
+  }
+  LOG(INFO) << "gce_phases: cores " << cores() << ", fanout " << FLAGS_collective_tree_fanout
+            << ", phase time " << phase_time * 1e6 << " us";
+  Grappa::global_free(array);
+}
+
 BOOST_AUTO_TEST_CASE( test1 ) {
   Grappa::init( GRAPPA_TEST_ARGS );
   Grappa::run([]{
@@ -317,6 +345,8 @@ BOOST_AUTO_TEST_CASE( test1 ) {
 
     test_forall_here_async();
     
+    test_gce_phases();
+    
     Metrics::merge_and_dump_to_file();
   });
   Grappa::finalize();
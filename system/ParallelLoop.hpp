@@ -96,10 +96,10 @@ namespace Grappa {
         // (also need to count 2 bytes from lambda overhead or something)
         struct { long rstart:48, riters:48, origin:16; } packed = { rstart, riters, origin };
         
-        if (C) C->enroll();
+        if (C != nullptr) C->enroll();
         spawn<B>([packed, loop_body] {
           loop_decomposition<B,C,Threshold>(packed.rstart, packed.riters, loop_body);
-          if (C) C->send_completion(packed.origin);
+          if (C != nullptr) C->send_completion(packed.origin);
         });
         
         // left side here
@@ -144,7 +144,7 @@ namespace Grappa {
         } else {
           CHECK(false) << "unimplemented, sorry!";
         }
-      } else if (C && S == SyncMode::Async && B == TaskMode::Bound
+      } else if (C != nullptr && S == SyncMode::Async && B == TaskMode::Bound
           && sizeof(F) > 8
           && C->get_shared_ptr<F>() == nullptr) {
         auto hf = new HeapF(loop_body, iters);
@@ -155,7 +155,7 @@ namespace Grappa {
         });
       } else {
         impl::loop_decomposition<B,C,Threshold>(start, iters, loop_body);
-        if (S == SyncMode::Blocking && C) C->wait();
+        if (S == SyncMode::Blocking && C != nullptr) C->wait();
       }
     }
     
@@ -272,6 +272,24 @@ namespace Grappa {
       };
       impl::forall<B,S,C,Threshold>(start, iters, f, &decltype(f)::operator());
     }
+    
+    /// Run `loop_body(start,iters)` over `[0, count())` on every core, in parallel on each,
+    /// where `count` is evaluated on the core itself (e.g. the size of its shard of some
+    /// symmetric structure). Blocks until all iterations, and anything they enroll in GCE,
+    /// are done.
+    template< GlobalCompletionEvent * GCE = &local_gce,
+              int64_t Threshold = USE_LOOP_THRESHOLD_FLAG,
+              typename N = decltype(nullptr),
+              typename F = decltype(nullptr) >
+    void forall_local(N count, F loop_body) {
+      Core origin = mycore();
+      GCE->enroll(cores());
+      on_all_cores([count,loop_body,origin]{
+        impl::forall_here<TaskMode::Bound,SyncMode::Async,GCE,Threshold>(0, count(), loop_body);
+        GCE->send_completion(origin);
+        GCE->wait();
+      });
+    }
   }
   
 #define FORALL_OVERLOAD(...) \
@@ -334,11 +352,14 @@ namespace Grappa {
     auto end = base+nelem;
     if (nelem > 0) { fc = 1; }
   
-    size_t block_elems = std::max<size_t>(1, block_size / sizeof(T));
+    size_t block_elems = std::max<size_t>(1, base.block_bytes() / sizeof(T));
     int64_t nfirstcore = base.block_max() - base;
     int64_t n = nelem - nfirstcore;
     
-    if (n > 0) {
+    if (n > 0 && base.distribution().policy() == Distribution::Policy::Hashed) {
+      // cores holding later blocks aren't contiguous; visit them all
+      return std::make_pair( 0, nc );
+    } else if (n > 0) {
       int64_t nrest = n / block_elems;
       if (nrest >= nc-1) {
         fc = nc;
@@ -368,7 +389,7 @@ namespace Grappa {
     
     Core origin = mycore();
     
-    if (GCE) GCE->enroll(fc);
+    if (GCE != nullptr) GCE->enroll(fc);
     struct { int64_t nelems : 48, origin : 16; } packed = { nelems, mycore() };
     
     for (Core i=0; i<fc; i++) {
@@ -378,7 +399,7 @@ namespace Grappa {
           T* local_end = (base+packed.nelems).localize();
           size_t n = local_end - local_base;
           do_on_core(local_base, n);
-          if (GCE) complete(make_global(GCE,packed.origin));
+          if (GCE != nullptr) complete(make_global(GCE,packed.origin));
         });
       });
     }
@@ -398,11 +419,11 @@ namespace Grappa {
       [loop_body,base](T* local_base, size_t nlocal){
         Grappa::forall_here<B,SyncMode::Async,GCE,Threshold>(0, nlocal, 
             [loop_body,local_base,base](int64_t s, int64_t n){
-          loop_body( make_linear(local_base+s)-base, n, local_base+s );
+          loop_body( make_linear(local_base+s, base.distribution())-base, n, local_base+s );
         });
       });
       
-      if (S == SyncMode::Blocking && GCE) GCE->wait();
+      if (S == SyncMode::Blocking && GCE != nullptr) GCE->wait();
     }
   
     template< TaskMode B, SyncMode S,
@@ -411,15 +432,20 @@ namespace Grappa {
     void forall(GlobalAddress<T> base, int64_t nelems, F loop_body,
                 void (F::*mf)(int64_t,T&) const)
     {
-      auto f = [loop_body](int64_t start, int64_t niters, T* first){
-        auto block_elems = block_size / sizeof(T);
-        auto a = make_linear(first);
+      auto dist = base.distribution();
+      auto f = [loop_body,base,dist](int64_t start, int64_t niters, T* first){
+        auto block_elems = base.block_bytes() / sizeof(T);
+        auto a = make_linear(first, dist);
         auto n_to_boundary = a.block_max() - a;
         auto index = start;
         
         for (int64_t i=0; i<niters; i++,index++,n_to_boundary--) {
           if (n_to_boundary == 0) {
-            index += block_elems * (cores()-1);
+            if (dist.policy() == Distribution::Policy::Hashed) {
+              index = make_linear(first+i, dist) - base;
+            } else {
+              index += block_elems * (cores()-1);
+            }
             n_to_boundary = block_elems;
           }
           loop_body(index, first[i]);
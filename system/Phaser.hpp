@@ -0,0 +1,145 @@
+////////////////////////////////////////////////////////////////////////
+// This file is part of Grappa, a system for scaling irregular
+// applications on commodity clusters. 
+
+// Copyright (C) 2010-2014 University of Washington and Battelle
+// Memorial Institute. University of Washington authorizes use of this
+// Grappa software.
+
+// Grappa is free software: you can redistribute it and/or modify it
+// under the terms of the Affero General Public License as published
+// by Affero, Inc., either version 1 of the License, or (at your
+// option) any later version.
+
+// Grappa is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero General Public License for more details.
+
+// You should have received a copy of the Affero General Public
+// License along with this program. If not, you may obtain one from
+// http://www.affero.org/oagpl.html.
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Collective.hpp"
+#include "ConditionVariable.hpp"
+
+namespace Grappa {
+  
+  /// @addtogroup Synchronization
+  /// @{
+  
+  /// Split-phase ("fuzzy") SPMD barrier. Each phase, every core calls `arrive()` once it
+  /// has produced what others depend on, can then do work that doesn't depend on the
+  /// phase, and calls `wait()` before using anything the others produced. Only `wait()`
+  /// blocks, and only until the last core has arrived, so fast cores overlap the time
+  /// they would otherwise spend idle in barrier().
+  ///
+  /// Arrivals are counted up a tree of cores (see --collective_tree_fanout) and the
+  /// release is sent back down it, entirely with Grappa messages, so no core handles more
+  /// than a fan-out's worth of messages per phase.
+  ///
+  /// Phasers are symmetric objects: *declare them in the C++ global scope*, so they have
+  /// the same address on every core (like Reducer). Independent phasers can be used to
+  /// synchronize unrelated groups of work separately.
+  ///
+  /// @b Example:
+  /// @code
+  ///   Phaser frontier_phase;
+  ///
+  ///   Grappa::on_all_cores([]{
+  ///     for (int level = 0; !done; level++) {
+  ///       send_next_frontier();
+  ///       frontier_phase.arrive();
+  ///       compute_local_statistics();  // doesn't need others' frontiers
+  ///       frontier_phase.wait();
+  ///       swap_frontiers();
+  ///     }
+  ///   });
+  /// @endcode
+  class Phaser {
+    /// phases this core has completed (waited for); the current phase is `phase`
+    int64_t phase;
+    /// true between arrive() and wait()
+    bool arrived;
+    /// arrivals from this core and its subtree, for the current and next phase
+    Core subtree_arrivals[2];
+    /// phases released by the root so far
+    int64_t released;
+    ConditionVariable cv;
+    
+    Core nchildren() const {
+      const Core k = impl::tree_fanout();
+      Core first = mycore()*k + 1;
+      if (first >= cores()) return 0;
+      return std::min<Core>(k, cores() - first);
+    }
+    Core parent() const { return (mycore() - 1) / impl::tree_fanout(); }
+    
+    /// count an arrival for phase `p` from this core or its subtree
+    void count_arrival(int64_t p) {
+      auto& n = subtree_arrivals[p % 2];
+      n++;
+      if (n == nchildren() + 1) {
+        n = 0;
+        if (mycore() == 0) {
+          release(p);
+        } else {
+          auto self = this;
+          send_heap_message(parent(), [self,p]{ self->count_arrival(p); });
+        }
+      }
+    }
+    
+    void release(int64_t p) {
+      released = p + 1;
+      broadcast(&cv);
+      const Core k = impl::tree_fanout();
+      auto self = this;
+      for (Core c = mycore()*k + 1; c < cores() && c <= mycore()*k + k; c++) {
+        send_heap_message(c, [self,p]{ self->release(p); });
+      }
+    }
+    
+  public:
+    Phaser(): phase(0), arrived(false), subtree_arrivals{0,0}, released(0) {}
+    
+    /// Signal that this core has reached the end of the current phase. Doesn't block.
+    void arrive() {
+      CHECK(!arrived) << "Phaser::arrive() called twice without wait()";
+      arrived = true;
+      count_arrival(phase);
+    }
+    
+    /// True once every core has arrived for the current phase (doesn't block).
+    bool ready() const { return released > phase; }
+    
+    /// Block until every core has arrived for the current phase, then move to the next one.
+    void wait() {
+      CHECK(arrived) << "Phaser::wait() called without arrive()";
+      while (!ready()) Grappa::wait(&cv);
+      arrived = false;
+      phase++;
+    }
+    
+    /// Ordinary barrier.
+    void arrive_and_wait() { arrive(); wait(); }
+    
+    /// Number of phases this core has completed.
+    int64_t current_phase() const { return phase; }
+  };
+  
+  namespace impl { extern Phaser default_phaser; }
+  
+  /// Split-phase version of barrier(), using a global Phaser: signal that this core has
+  /// reached the barrier, without waiting for the others. Must be followed by barrier_wait().
+  inline void barrier_arrive() { impl::default_phaser.arrive(); }
+  
+  /// Complete a barrier started by barrier_arrive(): block until every core has arrived.
+  inline void barrier_wait() { impl::default_phaser.wait(); }
+  
+  /// @}
+  
+} // namespace Grappa
@@ -0,0 +1,94 @@
+////////////////////////////////////////////////////////////////////////
+// This file is part of Grappa, a system for scaling irregular
+// applications on commodity clusters. 
+
+// Copyright (C) 2010-2014 University of Washington and Battelle
+// Memorial Institute. University of Washington authorizes use of this
+// Grappa software.
+
+// Grappa is free software: you can redistribute it and/or modify it
+// under the terms of the Affero General Public License as published
+// by Affero, Inc., either version 1 of the License, or (at your
+// option) any later version.
+
+// Grappa is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero General Public License for more details.
+
+// You should have received a copy of the Affero General Public
+// License along with this program. If not, you may obtain one from
+// http://www.affero.org/oagpl.html.
+////////////////////////////////////////////////////////////////////////
+
+#include <boost/test/unit_test.hpp>
+#include "Grappa.hpp"
+#include "Phaser.hpp"
+#include "Delegate.hpp"
+
+DEFINE_int64( phaser_iters, 1000, "Number of phases to time" );
+
+BOOST_AUTO_TEST_SUITE( Phaser_tests );
+
+using namespace Grappa;
+
+Phaser ph;
+Phaser other_ph;
+
+int64_t slots[64];
+
+BOOST_AUTO_TEST_CASE( test1 ) {
+  Grappa::init( GRAPPA_TEST_ARGS );
+  Grappa::run([]{
+    CHECK_LE(cores(), 64);
+    
+    BOOST_MESSAGE("Testing arrive/wait ordering");
+    on_all_cores([]{
+      for (int64_t p = 1; p <= 10; p++) {
+        // write our slot on every core, then make sure we see everyone's after wait()
+        for (Core c = 0; c < cores(); c++) {
+          auto me = mycore();
+          delegate::call(c, [me,p]{ slots[me] = p; });
+        }
+        ph.arrive();
+        ph.wait();
+        for (Core c = 0; c < cores(); c++) BOOST_CHECK_EQUAL(slots[c], p);
+        ph.arrive_and_wait(); // nobody starts the next phase until everyone has checked
+      }
+      BOOST_CHECK_EQUAL(ph.current_phase(), 20);
+    });
+    
+    BOOST_MESSAGE("Testing independent phasers and the default split-phase barrier");
+    on_all_cores([]{
+      barrier_arrive();
+      // core 0 arrives late on the other phaser; nobody gets past it until then
+      if (mycore() == 0) {
+        for (int i = 0; i < 100; i++) Grappa::yield();
+        slots[0] = -1;
+      }
+      other_ph.arrive();
+      other_ph.wait();
+      BOOST_CHECK_EQUAL(delegate::read(make_global(&slots[0], 0)), -1);
+      barrier_wait();
+    });
+    
+    BOOST_MESSAGE("Timing split-phase barrier");
+    on_all_cores([]{
+      double start = walltime();
+      for (int64_t i = 0; i < FLAGS_phaser_iters; i++) {
+        barrier_arrive();
+        barrier_wait();
+      }
+      double t = (walltime() - start) / FLAGS_phaser_iters;
+      if (mycore() == 0) LOG(INFO) << "phaser barrier: " << t*1e6 << " us";
+      
+      start = walltime();
+      for (int64_t i = 0; i < FLAGS_phaser_iters; i++) barrier();
+      t = (walltime() - start) / FLAGS_phaser_iters;
+      if (mycore() == 0) LOG(INFO) << "MPI barrier: " << t*1e6 << " us";
+    });
+  });
+  Grappa::finalize();
+}
+
+BOOST_AUTO_TEST_SUITE_END();
@@ -46,7 +46,7 @@ struct PushBuffer {
   }
   ~PushBuffer() {
     flush();
-    for (int i=0; i<NBUFS; i++) Grappa::impl::locale_shared_memory.deallocate(buf[i]);
+    for (int i=0; i<NBUFS; i++) Grappa::impl::locale_shared_memory.deallocate(buf[i], Grappa::impl::MemoryCategory::System);
   }
   void push(const T& o) {
     CHECK(target_array.pointer() != NULL) << "buffer not initialized!";
@@ -60,7 +60,7 @@ struct PushBuffer {
   void setup(GlobalAddress<T> _target_array, GlobalAddress<int64_t> _shared_index) {
     if (buf[0] == nullptr) {
       for (int64_t i=0; i<NBUFS; i++) {
-        buf[i] = static_cast<T*>(Grappa::impl::locale_shared_memory.allocate(BUFSIZE * sizeof(T)));
+        buf[i] = static_cast<T*>(Grappa::impl::locale_shared_memory.allocate(BUFSIZE * sizeof(T), Grappa::impl::MemoryCategory::System));
         curr_size[i] = 0;
       }
     }
@@ -22,7 +22,10 @@
 ////////////////////////////////////////////////////////////////////////
 #pragma once
 #include <Collective.hpp>
+#include <LocaleSharedMemory.hpp>
 #include <functional>
+#include <type_traits>
+#include <cstdio>
 
 /// 
 /// A Reducer object encapsulates a reduction
@@ -222,26 +225,142 @@ namespace Grappa {
     
   } GRAPPA_BLOCK_ALIGNED;
   
+  /// Where a Reducer accumulates updates before they are reduced across the system.
+  enum class ReducerMode {
+    /// Each core keeps its own value: updates are plain local operations, and
+    /// reads reduce over every core.
+    PerCore,
+    /// Cores in a locale fold updates into one value in locale shared memory with
+    /// atomics, so reads only reduce over locales. Better for values that are read
+    /// often (progress counters, frontier sizes polled every iteration). The value
+    /// type must fit in a machine word.
+    Locale
+  };
+  
   /// Base class for Reducer implementing some operations common to all 
   /// specializations.
-  template< typename T, T (*ReduceOp)(const T&, const T&) >
+  template< typename T, T (*ReduceOp)(const T&, const T&), ReducerMode M = ReducerMode::PerCore >
   class ReducerImpl {
+    template< ReducerMode Mode > using ModeTag = std::integral_constant<ReducerMode,Mode>;
+    
   protected:
     T local_value;
+    
+    /// (Locale mode) this locale's shared value, found on first use
+    T * shared;
+    
+    /// last value read by stale_value(), and whether a read is in flight
+    T cached_value;
+    bool refreshing;
+    
+    T * slot() {
+      if (!shared) {
+        // Reducers are globals, so have the same address on every core of the locale
+        char name[64];
+        snprintf(name, sizeof(name), "Reducer@%p", (void*)this);
+        shared = static_cast<T*>( impl::locale_shared_memory.find_or_create_named(name, sizeof(T)) );
+      }
+      return shared;
+    }
+    
+    T load() { return load(ModeTag<M>()); }
+    T load(ModeTag<ReducerMode::PerCore>) { return local_value; }
+    T load(ModeTag<ReducerMode::Locale>) {
+      T v;
+      __atomic_load(slot(), &v, __ATOMIC_RELAXED);
+      return v;
+    }
+    
+    void store(const T& v) { store(v, ModeTag<M>()); }
+    void store(const T& v, ModeTag<ReducerMode::PerCore>) { local_value = v; }
+    void store(const T& v, ModeTag<ReducerMode::Locale>) {
+      T tmp = v;
+      __atomic_store(slot(), &tmp, __ATOMIC_RELAXED);
+    }
+    
+    /// Apply `f(value, v)` to this core's (or locale's) value.
+    template< typename F >
+    void update(const T& v, F f) { update(v, f, ModeTag<M>()); }
+    template< typename F >
+    void update(const T& v, F f, ModeTag<ReducerMode::PerCore>) { f(local_value, v); }
+    template< typename F >
+    void update(const T& v, F f, ModeTag<ReducerMode::Locale>) {
+      static_assert(std::is_trivially_copyable<T>::value &&
+                    (sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8),
+                    "locale-combined Reducers need a type that fits in a machine word");
+      T * p = slot();
+      T old, upd;
+      __atomic_load(p, &old, __ATOMIC_RELAXED);
+      do {
+        upd = old;
+        f(upd, v);
+      } while (!__atomic_compare_exchange(p, &old, &upd, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    }
+    
+    /// Add `v`; a single fetch-and-add for integers in Locale mode.
+    void add(const T& v) {
+      add(v, std::integral_constant<bool, M == ReducerMode::Locale && std::is_integral<T>::value
+                                          && !std::is_same<T,bool>::value>());
+    }
+    void add(const T& v, std::true_type) { __atomic_fetch_add(slot(), v, __ATOMIC_RELAXED); }
+    void add(const T& v, std::false_type) { update(v, [](T& x, const T& v){ x += v; }); }
+    
+    T reduce_all() const { return reduce_all(ModeTag<M>()); }
+    T reduce_all(ModeTag<ReducerMode::PerCore>) const {
+      return reduce<T,ReduceOp>(&this->local_value);
+    }
+    /// Reduce the shared values of each locale: ours is read directly, and only the
+    /// first core of each other locale is asked for its locale's value.
+    T reduce_all(ModeTag<ReducerMode::Locale>) const {
+      auto self = const_cast<ReducerImpl*>(this);
+      T total = self->load();
+      Core origin = mycore();
+      CompletionEvent ce(locales()-1);
+      
+      for (Core c = 0; c < cores(); c++) {
+        bool first_of_locale = (c == 0) || (locale_of(c) != locale_of(c-1));
+        if (!first_of_locale || locale_of(c) == mylocale()) continue;
+        send_heap_message(c, [self, &ce, &total, origin]{
+          T val = self->load();
+          send_heap_message(origin, [val, &ce, &total]{
+            total = ReduceOp(total, val);
+            ce.complete();
+          });
+        });
+      }
+      ce.wait();
+      return total;
+    }
+    
   public:
-    ReducerImpl(): local_value() {}
+    ReducerImpl(): local_value(), shared(nullptr), cached_value(), refreshing(false) {}
     
     /// Read out value; does expensive global reduce.
     /// 
     /// Called implicitly when the Reducer is used as the underlying type, 
     /// or by an explicit cast operation.
-    operator T () const { return reduce<T,ReduceOp>(&this->local_value); }
+    operator T () const { return reduce_all(); }
     
     /// Globally set the value; expensive global synchronization.
-    void operator=(const T& v){ reset(); local_value = v; }
+    void operator=(const T& v){ reset(); store(v); }
     
     /// Globally reset to default value for the type.
-    void reset() { call_on_all_cores([this]{ this->local_value = T(); }); }
+    void reset() { call_on_all_cores([this]{ this->store(T()); }); }
+    
+    /// Non-blocking read: returns the value from the last read started by this call
+    /// on this core (`T()` before the first one finishes), and starts a new one in the
+    /// background if none is running. For polling progress without waiting on a
+    /// global reduction each time.
+    T stale_value() {
+      if (!refreshing) {
+        refreshing = true;
+        spawn([this]{
+          this->cached_value = this->reduce_all();
+          this->refreshing = false;
+        });
+      }
+      return cached_value;
+    }
   };
   
 #define Super(...) \
@@ -293,22 +412,27 @@ namespace Grappa {
   ///   Grappa::finalize();
   /// }
   /// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-  template< typename T, ReducerType R >
-  class Reducer : public ReducerImpl<T,collective_add> {};
+  /// The third template parameter picks how updates are combined (see ReducerMode):
+  /// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+  /// // read every iteration, so fold updates per locale
+  /// Reducer<int64_t,ReducerType::Add,ReducerMode::Locale> frontier_size;
+  /// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+  template< typename T, ReducerType R, ReducerMode M = ReducerMode::PerCore >
+  class Reducer : public ReducerImpl<T,collective_add,M> {};
   
   /// Reducer for sum (+), useful for global accumulators.
   /// Provides cheap operators for increment and decrement 
   /// (`++`, `+=`, `--`, `-=`).
-  template< typename T >
-  class Reducer<T,ReducerType::Add> : public ReducerImpl<T,collective_add> {
+  template< typename T, ReducerMode M >
+  class Reducer<T,ReducerType::Add,M> : public ReducerImpl<T,collective_add,M> {
   public:
-    Super(ReducerImpl<T,collective_add>);
-    void operator+=(const T& v){ this->local_value += v; }
-    void operator++(){ this->local_value++; }
-    void operator++(int){ this->local_value++; }
-    void operator-=(const T& v){ this->local_value -= v; }
-    void operator--(){ this->local_value--; }
-    void operator--(int){ this->local_value--; }
+    Super(ReducerImpl<T,collective_add,M>);
+    void operator+=(const T& v){ this->add(v); }
+    void operator++(){ this->add(1); }
+    void operator++(int){ this->add(1); }
+    void operator-=(const T& v){ this->add(-v); }
+    void operator--(){ this->add(-1); }
+    void operator--(int){ this->add(-1); }
   };
 
   /// Reducer for "or" (`operator|`).
@@ -328,11 +452,11 @@ namespace Grappa {
   /// });
   /// LOG(INFO) << ( any_nonzero ? "some" : "no" ) << " nonzeroes.";
   /// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-  template< typename T >
-  class Reducer<T,ReducerType::Or> : public ReducerImpl<T,collective_or> {
+  template< typename T, ReducerMode M >
+  class Reducer<T,ReducerType::Or,M> : public ReducerImpl<T,collective_or,M> {
   public:
-    Super(ReducerImpl<T,collective_or>);
-    void operator|=(const T& v){ this->local_value |= v; }
+    Super(ReducerImpl<T,collective_or,M>);
+    void operator|=(const T& v){ this->update(v, [](T& x, const T& v){ x |= v; }); }
   };
 
   /// Reducer for "and" (`operator&`). 
@@ -350,11 +474,11 @@ namespace Grappa {
   /// });
   /// LOG(INFO) << ( all_zero ? "" : "not " ) << "all zero.";
   /// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-  template< typename T >
-  class Reducer<T,ReducerType::And> : public ReducerImpl<T,collective_and> {
+  template< typename T, ReducerMode M >
+  class Reducer<T,ReducerType::And,M> : public ReducerImpl<T,collective_and,M> {
   public:
-    Super(ReducerImpl<T,collective_and>);
-    void operator&=(const T& v){ this->local_value &= v; }
+    Super(ReducerImpl<T,collective_and,M>);
+    void operator&=(const T& v){ this->update(v, [](T& x, const T& v){ x &= v; }); }
   };
   
   /// Reducer for finding the maximum of many values.
@@ -371,14 +495,12 @@ namespace Grappa {
   /// });
   /// LOG(INFO) << "maximum value: " << max_val;
   /// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-  template< typename T >
-  class Reducer<T,ReducerType::Max> : public ReducerImpl<T,collective_max> {
+  template< typename T, ReducerMode M >
+  class Reducer<T,ReducerType::Max,M> : public ReducerImpl<T,collective_max,M> {
   public:
-    Super(ReducerImpl<T,collective_max>);
+    Super(ReducerImpl<T,collective_max,M>);
     void operator<<(const T& v){
-      if (v > this->local_value) {
-        this->local_value = v;
-      }
+      this->update(v, [](T& x, const T& v){ if (v > x) x = v; });
     }
   };
   
@@ -396,14 +518,12 @@ namespace Grappa {
   /// });
   /// LOG(INFO) << "minimum value: " << min_val;
   /// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-  template< typename T >
-  class Reducer<T,ReducerType::Min> : public ReducerImpl<T,collective_min> {
+  template< typename T, ReducerMode M >
+  class Reducer<T,ReducerType::Min,M> : public ReducerImpl<T,collective_min,M> {
   public:
-    Super(ReducerImpl<T,collective_min>);
+    Super(ReducerImpl<T,collective_min,M>);
     void operator<<(const T& v){
-      if (v < this->local_value) {
-        this->local_value = v;
-      }
+      this->update(v, [](T& x, const T& v){ if (v < x) x = v; });
     }
   };
   
@@ -132,6 +132,10 @@ Reducer<bool,ReducerType::Or> active;
 using C = CmpElement<int,double>;
 Reducer<C,ReducerType::Max> best;
 
+Reducer<int64_t,ReducerType::Add,ReducerMode::Locale> locale_count;
+Reducer<int64_t,ReducerType::Max,ReducerMode::Locale> locale_max;
+Reducer<bool,ReducerType::Or,ReducerMode::Locale> locale_active;
+
 BOOST_AUTO_TEST_CASE( test1 ) {
   Grappa::init( GRAPPA_TEST_ARGS );
   Grappa::run([]{
@@ -183,6 +187,30 @@ BOOST_AUTO_TEST_CASE( test1 ) {
     BOOST_MESSAGE("## Test Reducer<T,Max>");
     on_all_cores([]{ best << C(mycore(), 3.0*mycore()); });
     BOOST_CHECK_EQUAL(static_cast<C>(best).idx(), cores()-1);
+    
+    BOOST_MESSAGE("## Test locale-combined Reducers");
+    BOOST_CHECK_EQUAL(locale_count, 0);
+    locale_count = 3;
+    on_all_cores([]{ for (int i=0; i<10; i++) locale_count++; });
+    BOOST_CHECK_EQUAL(locale_count, 3 + 10*cores());
+    
+    on_all_cores([]{ locale_max << static_cast<int64_t>(mycore()); });
+    BOOST_CHECK_EQUAL(locale_max, cores()-1);
+    
+    BOOST_CHECK(!locale_active);
+    on_all_cores([]{ if (mycore() == cores()-1) locale_active |= true; });
+    BOOST_CHECK(locale_active);
+    
+    BOOST_MESSAGE("## Test stale_value()");
+    count = 0;
+    on_all_cores([]{ count += 2; });
+    // doesn't block, so may lag behind the updates, but eventually catches up
+    auto seen = count.stale_value();
+    for (int i = 0; i < (1<<20) && seen != 2*cores(); i++) {
+      Grappa::yield();
+      seen = count.stale_value();
+    }
+    BOOST_CHECK_EQUAL(seen, 2*cores());
   });
   Grappa::finalize();
 }
@@ -0,0 +1,247 @@
+////////////////////////////////////////////////////////////////////////
+// This file is part of Grappa, a system for scaling irregular
+// applications on commodity clusters. 
+
+// Copyright (C) 2010-2014 University of Washington and Battelle
+// Memorial Institute. University of Washington authorizes use of this
+// Grappa software.
+
+// Grappa is free software: you can redistribute it and/or modify it
+// under the terms of the Affero General Public License as published
+// by Affero, Inc., either version 1 of the License, or (at your
+// option) any later version.
+
+// Grappa is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero General Public License for more details.
+
+// You should have received a copy of the Affero General Public
+// License along with this program. If not, you may obtain one from
+// http://www.affero.org/oagpl.html.
+////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include "Communicator.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <utility>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace Grappa {
+namespace impl {
+
+/// Finalizer from MurmurHash3, so identity hashes (std::hash of integers)
+/// spread across both the owner core and the slot within the shard.
+inline uint64_t hash_mix(uint64_t h) {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb3fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+/// Pick the core owning a (mixed) hash. Uses the high 32 bits, so the owner
+/// is independent of the low bits used for probing within the shard.
+inline Core hash_owner(uint64_t h, Core ncores) {
+  return static_cast<Core>(((h >> 32) * static_cast<uint64_t>(ncores)) >> 32);
+}
+
+template< typename K, typename V >
+struct SwissSlot {
+  K key;
+  V val;
+  SwissSlot(const K& key): key(key), val() {}
+};
+
+template< typename K >
+struct SwissSlot<K,void> {
+  K key;
+  SwissSlot(const K& key): key(key) {}
+};
+
+/// One group of 16 control bytes, compared against a tag all at once.
+struct SwissGroup {
+  static const size_t WIDTH = 16;
+#ifdef __SSE2__
+  __m128i ctrl;
+  explicit SwissGroup(const int8_t * p): ctrl(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))) {}
+  /// Bitmask of the positions whose control byte equals `tag`.
+  uint32_t match(int8_t tag) const {
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(tag), ctrl));
+  }
+#else
+  const int8_t * ctrl;
+  explicit SwissGroup(const int8_t * p): ctrl(p) {}
+  uint32_t match(int8_t tag) const {
+    uint32_t m = 0;
+    for (size_t i = 0; i < WIDTH; i++) if (ctrl[i] == tag) m |= 1u << i;
+    return m;
+  }
+#endif
+};
+
+/// Core-local open-addressing hash table in the style of Abseil's Swiss
+/// tables: keys and values are stored inline in one slot array, with a
+/// separate array of one-byte control tags (7 bits of the hash, or EMPTY).
+/// Lookups compare a whole group of 16 tags with one SIMD compare and only
+/// touch slots whose tag matches, so a probe is usually one cache line of
+/// tags and one slot. Grows by doubling at 7/8 load; there is no erase, only
+/// `clear()`, which keeps the allocation for reuse.
+///
+/// Not thread-safe; each instance belongs to a single core. Pointers to
+/// slots are invalidated by inserts that grow the table.
+///
+/// @tparam V value type, or `void` for a set.
+template< typename K, typename V = void, typename H = std::hash<K> >
+class SwissTable {
+public:
+  using Slot = SwissSlot<K,V>;
+  static const int8_t EMPTY = -128;
+  
+private:
+  int8_t * ctrl;
+  Slot * slots;
+  size_t cap;    // power of 2, multiple of SwissGroup::WIDTH
+  size_t count;
+  
+  static uint64_t hash(const K& key) { return hash_mix(H()(key)); }
+  static int8_t tag(uint64_t h) { return static_cast<int8_t>(h & 0x7f); }
+  
+  void allocate(size_t n) {
+    cap = n;
+    ctrl = new int8_t[cap];
+    memset(ctrl, EMPTY, cap);
+    slots = static_cast<Slot*>(::operator new(cap * sizeof(Slot)));
+  }
+  
+  void release() {
+    if (ctrl == nullptr) return;
+    clear();
+    delete [] ctrl;
+    ::operator delete(slots);
+    ctrl = nullptr; slots = nullptr; cap = 0;
+  }
+  
+  /// Visit groups in triangular order (0, 1, 3, 6, ...), which reaches every
+  /// group of a power-of-two table. `f(base, group)` returns true to stop.
+  template< typename F >
+  void probe(uint64_t h, F f) const {
+    size_t mask = cap / SwissGroup::WIDTH - 1;
+    size_t g = (h >> 7) & mask;
+    for (size_t i = 1; ; i++) {
+      size_t base = g * SwissGroup::WIDTH;
+      if (f(base, SwissGroup(ctrl + base))) return;
+      g = (g + i) & mask;
+    }
+  }
+  
+  /// Place a key known to be absent; returns its slot (unconstructed).
+  size_t find_empty(uint64_t h) const {
+    size_t pos = 0;
+    probe(h, [&pos](size_t base, const SwissGroup& grp){
+      uint32_t m = grp.match(EMPTY);
+      if (m == 0) return false;
+      pos = base + __builtin_ctz(m);
+      return true;
+    });
+    return pos;
+  }
+  
+  void grow() {
+    int8_t * old_ctrl = ctrl;
+    Slot * old_slots = slots;
+    size_t old_cap = cap;
+    allocate(old_cap * 2);
+    for (size_t i = 0; i < old_cap; i++) {
+      if (old_ctrl[i] == EMPTY) continue;
+      uint64_t h = hash(old_slots[i].key);
+      size_t pos = find_empty(h);
+      ctrl[pos] = tag(h);
+      new (&slots[pos]) Slot(std::move(old_slots[i]));
+      old_slots[i].~Slot();
+    }
+    delete [] old_ctrl;
+    ::operator delete(old_slots);
+  }
+  
+public:
+  explicit SwissTable(size_t expected = 0): ctrl(nullptr), slots(nullptr), cap(0), count(0) {
+    size_t n = SwissGroup::WIDTH;
+    while (n * 7 / 8 < expected) n *= 2;
+    allocate(n);
+  }
+  ~SwissTable() { release(); }
+  
+  SwissTable(const SwissTable&) = delete;
+  SwissTable& operator=(const SwissTable&) = delete;
+  
+  size_t size() const { return count; }
+  size_t capacity() const { return cap; }
+  
+  /// Bytes held by the table (control bytes plus slots).
+  size_t bytes() const { return cap * (sizeof(Slot) + 1); }
+  
+  Slot * find(const K& key) const {
+    uint64_t h = hash(key);
+    int8_t t = tag(h);
+    Slot * result = nullptr;
+    probe(h, [&](size_t base, const SwissGroup& grp){
+      for (uint32_t m = grp.match(t); m != 0; m &= m - 1) {
+        size_t i = base + __builtin_ctz(m);
+        if (slots[i].key == key) { result = &slots[i]; return true; }
+      }
+      // an empty tag in the group means the key was never placed past it
+      return grp.match(EMPTY) != 0;
+    });
+    return result;
+  }
+  
+  /// Find `key`, inserting a value-initialized entry if it is absent.
+  /// @return the slot, and whether it was newly inserted
+  std::pair<Slot*,bool> insert(const K& key) {
+    Slot * s = find(key);
+    if (s) return std::make_pair(s, false);
+    if ((count + 1) > cap / 8 * 7) grow();
+    uint64_t h = hash(key);
+    size_t pos = find_empty(h);
+    ctrl[pos] = tag(h);
+    new (&slots[pos]) Slot(key);
+    count++;
+    return std::make_pair(&slots[pos], true);
+  }
+  
+  /// Destroy all entries but keep the allocation.
+  void clear() {
+    if (count > 0) {
+      for (size_t i = 0; i < cap; i++) {
+        if (ctrl[i] != EMPTY) slots[i].~Slot();
+      }
+      memset(ctrl, EMPTY, cap);
+      count = 0;
+    }
+  }
+  
+  /// Visit the occupied slots among positions [start, start+n), for
+  /// splitting iteration across tasks.
+  template< typename F >
+  void for_each(size_t start, size_t n, F f) {
+    size_t end = std::min(start + n, cap);
+    for (size_t i = start; i < end; i++) {
+      if (ctrl[i] != EMPTY) f(slots[i]);
+    }
+  }
+  
+  template< typename F >
+  void for_each(F f) { for_each(0, cap, f); }
+};
+
+} // namespace impl
+} // namespace Grappa
@@ -29,6 +29,7 @@
 #include "tasks/TaskingScheduler.hpp"
 #include "StateTimer.hpp"
 #include "Communicator.hpp"
+#include "LocaleSharedMemory.hpp"
 
 #include <boost/type_traits/remove_pointer.hpp>
 #include <boost/typeof/typeof.hpp>
@@ -119,6 +120,7 @@ namespace Grappa {
   /// @endcode
   template < typename TF >
   void privateTask( TF tf ) {
+    memory_backpressure();
     tasks_created++;
     if( sizeof( tf ) > 24 ) { // if it's too big to fit in a task queue entry
       DVLOG(4) << "Heap allocated task of size " << sizeof(tf);
@@ -148,6 +150,7 @@ namespace Grappa {
   /// @see Grappa::spawn for usage.
   template < typename TF >
   void publicTask( TF tf ) {
+    memory_backpressure();
     tasks_created++;
     // TODO: implement automatic heap allocation and caching to handle larger functors
     CHECK_LE( sizeof(tf), 24) << "Functor argument to publicTask too large to be automatically coerced.";
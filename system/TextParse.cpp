@@ -0,0 +1,130 @@
+////////////////////////////////////////////////////////////////////////
+// This file is part of Grappa, a system for scaling irregular
+// applications on commodity clusters. 
+
+// Copyright (C) 2010-2014 University of Washington and Battelle
+// Memorial Institute. University of Washington authorizes use of this
+// Grappa software.
+
+// Grappa is free software: you can redistribute it and/or modify it
+// under the terms of the Affero General Public License as published
+// by Affero, Inc., either version 1 of the License, or (at your
+// option) any later version.
+
+// Grappa is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero General Public License for more details.
+
+// You should have received a copy of the Affero General Public
+// License along with this program. If not, you may obtain one from
+// http://www.affero.org/oagpl.html.
+////////////////////////////////////////////////////////////////////////
+
+#include "TextParse.hpp"
+#include "Communicator.hpp"
+#include "IOEngine.hpp"
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Grappa {
+namespace impl {
+
+LineReader::LineReader( const char * fname, size_t chunk_bytes )
+  : chunk( chunk_bytes )
+  , skip_first( false )
+  , done( false )
+  , carry_from( 0 )
+  , carry_len( 0 )
+{
+  fd = io_open( fname, O_RDONLY );
+  PCHECK( fd >= 0 ) << "Error opening " << fname;
+  struct stat st;
+  PCHECK( fstat( fd, &st ) == 0 ) << "Error getting size of " << fname;
+  size = st.st_size;
+  
+  range_t r = blockDist( 0, size, mycore(), cores() );
+  end = r.end;
+  if( r.start == r.end ) {
+    done = true;
+  } else if( r.start > 0 ) {
+    // start at the byte before our range: a line starts in our range iff
+    // it follows a newline at or after that byte
+    pos = r.start - 1;
+    skip_first = true;
+  } else {
+    pos = 0;
+  }
+}
+
+LineReader::~LineReader() {
+  close( fd );
+}
+
+bool LineReader::next( const char ** begin, const char ** line_end ) {
+  while( !done ) {
+    // keep the unfinished line from the last chunk at the front of the buffer
+    if( carry_len > 0 && carry_from > 0 ) memmove( &buf[0], &buf[carry_from], carry_len );
+    size_t carry = carry_len;
+    carry_from = carry_len = 0;
+    
+    if( buf.size() < carry + chunk ) buf.resize( carry + chunk );
+    ssize_t n = pos < size ? io_read( fd, &buf[carry], chunk, pos ) : 0;
+    CHECK_GE( n, 0 ) << "Error reading text: " << strerror( -n );
+    size_t buf_offset = pos - carry;   // file offset of buf[0]
+    pos += n;
+    bool eof = pos >= size;
+    
+    const char * b = &buf[0];
+    const char * e = b + carry + n;
+    
+    if( skip_first ) {
+      auto nl = static_cast< const char * >( memchr( b, '\n', e - b ) );
+      if( !nl ) {
+        if( eof ) done = true;
+        continue; // still inside the previous core's line
+      }
+      skip_first = false;
+      b = nl + 1;
+    }
+    
+    size_t b_offset = buf_offset + (b - &buf[0]);
+    if( b_offset >= end ) { done = true; return false; }
+    
+    // lines starting at or after `end` belong to the next core
+    if( end < buf_offset + (e - &buf[0]) ) {
+      const char * last = &buf[0] + (end - buf_offset) - 1;
+      auto nl = static_cast< const char * >( memchr( last, '\n', e - last ) );
+      if( nl ) {
+        done = true;
+        *begin = b; *line_end = nl + 1;
+        return true;
+      }
+    }
+    
+    if( eof ) {
+      done = true;
+      if( b == e ) return false;
+      *begin = b; *line_end = e;
+      return true;
+    }
+    
+    auto nl = static_cast< const char * >( memrchr( b, '\n', e - b ) );
+    if( !nl ) {
+      // line longer than the chunk so far: keep all of it and read more
+      carry_from = b - &buf[0];
+      carry_len = e - b;
+      continue;
+    }
+    carry_from = (nl + 1) - &buf[0];
+    carry_len = e - (nl + 1);
+    *begin = b; *line_end = nl + 1;
+    return true;
+  }
+  return false;
+}
+
+} // namespace impl
+} // namespace Grappa
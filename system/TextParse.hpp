@@ -0,0 +1,158 @@
+////////////////////////////////////////////////////////////////////////
+// This file is part of Grappa, a system for scaling irregular
+// applications on commodity clusters. 
+
+// Copyright (C) 2010-2014 University of Washington and Battelle
+// Memorial Institute. University of Washington authorizes use of this
+// Grappa software.
+
+// Grappa is free software: you can redistribute it and/or modify it
+// under the terms of the Affero General Public License as published
+// by Affero, Inc., either version 1 of the License, or (at your
+// option) any later version.
+
+// Grappa is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero General Public License for more details.
+
+// You should have received a copy of the Affero General Public
+// License along with this program. If not, you may obtain one from
+// http://www.affero.org/oagpl.html.
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace Grappa {
+  
+  /// @addtogroup Utility
+  /// @{
+  
+  namespace impl {
+    
+    /// Skip spaces, tabs and commas (not newlines).
+    inline const char * skip_blanks( const char * p, const char * end ) {
+      while( p < end && (*p == ' ' || *p == '\t' || *p == ',') ) p++;
+      return p;
+    }
+    
+    /// Pointer past the next newline (or `end`).
+    inline const char * next_line( const char * p, const char * end ) {
+      auto nl = static_cast< const char * >( ::memchr( p, '\n', end - p ) );
+      return nl ? nl + 1 : end;
+    }
+    
+    /// Are all 8 bytes of `w` ASCII digits?
+    inline bool eight_digits( uint64_t w ) {
+      return ( (w & 0xF0F0F0F0F0F0F0F0ULL)
+               | (((w + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4) )
+             == 0x3333333333333333ULL;
+    }
+    
+    /// Value of 8 ASCII digits packed little-endian in `w` (SWAR: three
+    /// multiplies instead of eight multiply-adds).
+    inline uint64_t eight_digits_value( uint64_t w ) {
+      w -= 0x3030303030303030ULL;
+      w = (w * 10) + (w >> 8);
+      return ( ((w & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32)))
+               + (((w >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32))) ) >> 32;
+    }
+    
+    /// Parse a decimal integer (optionally negative) at `p`, eight digits at
+    /// a time where possible.
+    /// @return pointer past the number, or `p` itself if there was none
+    inline const char * parse_int( const char * p, const char * end, int64_t * out ) {
+      const char * start = p;
+      bool neg = (p < end && *p == '-');
+      if( neg ) p++;
+      const char * digits = p;
+      uint64_t v = 0;
+      while( end - p >= 8 ) {
+        uint64_t w;
+        ::memcpy( &w, p, sizeof(w) );
+        if( !eight_digits( w ) ) break;
+        v = v * 100000000ULL + eight_digits_value( w );
+        p += 8;
+      }
+      while( p < end && static_cast< unsigned >( *p - '0' ) < 10 ) {
+        v = v * 10 + (*p - '0');
+        p++;
+      }
+      if( p == digits ) return start;
+      *out = neg ? -static_cast< int64_t >( v ) : static_cast< int64_t >( v );
+      return p;
+    }
+    
+    /// Reads this core's share of a text file in large chunks of whole
+    /// lines. The file is split evenly by bytes; a line belongs to the core
+    /// whose range holds its first byte, so every line is seen exactly once.
+    class LineReader {
+      int fd;
+      size_t size;       ///< file size
+      size_t end;        ///< end of this core's range
+      size_t pos;        ///< next file offset to read
+      size_t chunk;      ///< bytes per read
+      bool skip_first;   ///< first (partial) line belongs to the previous core
+      bool done;
+      
+      std::vector< char > buf;
+      size_t carry_from, carry_len; ///< unfinished line to keep for the next chunk
+      
+    public:
+      /// Open `fname` and find this core's byte range.
+      LineReader( const char * fname, size_t chunk_bytes );
+      ~LineReader();
+      
+      /// Get the next run of complete lines, [*begin, *end). The last line
+      /// of the file may lack a newline.
+      /// @return false when this core's lines are exhausted
+      bool next( const char ** begin, const char ** end );
+    };
+    
+  } // namespace impl
+  
+  /// Called from SPMD context. Parse this core's share of the lines of a
+  /// text file of integers (separated by spaces, tabs or commas), calling
+  /// `f(const int64_t * fields, int nfields)` for each line with at least
+  /// one number. Lines starting with '#' or '%' are skipped, as is anything
+  /// after the first `MaxFields` numbers or a non-numeric token.
+  ///
+  /// @b Example:
+  /// @code
+  ///   on_all_cores([]{
+  ///     parse_int_lines_local<2>("edges.tsv", [](const int64_t * v, int n){
+  ///       if (n == 2) local_edges.push_back({v[0], v[1]});
+  ///     });
+  ///   });
+  /// @endcode
+  template< int MaxFields, typename F >
+  void parse_int_lines_local( const char * fname, F f, size_t chunk_bytes = 8L << 20 ) {
+    impl::LineReader in( fname, chunk_bytes );
+    const char * p;
+    const char * end;
+    int64_t fields[ MaxFields ];
+    while( in.next( &p, &end ) ) {
+      while( p < end ) {
+        p = impl::skip_blanks( p, end );
+        int n = 0;
+        if( p < end && *p != '#' && *p != '%' ) {
+          while( n < MaxFields ) {
+            const char * q = impl::parse_int( p, end, &fields[n] );
+            if( q == p ) break;
+            n++;
+            p = impl::skip_blanks( q, end );
+          }
+        }
+        if( n > 0 ) f( fields, n );
+        p = impl::next_line( p, end );
+      }
+    }
+  }
+  
+  /// @}
+  
+} // namespace Grappa
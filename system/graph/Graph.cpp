@@ -22,4 +22,81 @@
 ////////////////////////////////////////////////////////////////////////
 
 #include "Graph.hpp"
+#include "IOEngine.hpp"
 
+#include <cstring>
+
+DEFINE_bool( graph_create_alltoall, true, "In Graph::create, exchange edges with bulk all-to-all and sort locally, rather than placing each edge with async delegates" );
+DEFINE_bool( graph_in_edges, false, "In Graph::create and Graph::load, also build the index of incoming edges used by in_adj()" );
+DEFINE_double( graph_compact_fraction, 0.25, "After a batch of edge updates, repack a core's adjacencies once this fraction of them have moved out of the packed buffer" );
+DEFINE_string( graph_partition, "cyclic", "Vertex placement for graph apps (see Graph::partition_by_flag), and the default for Graph::partition: cyclic, hash, degree, ldg or fennel" );
+DEFINE_int64( graph_partition_rounds, 8, "Number of slices each core places between exchanges of placements, for ldg and fennel" );
+DEFINE_double( graph_partition_slack, 0.05, "Fraction by which ldg and fennel may exceed an even share of vertices per core" );
+
+GRAPPA_DEFINE_METRIC(SimpleMetric<double>, graph_count_time, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<double>, graph_scatter_time, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<double>, graph_sort_time, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<double>, graph_partition_time, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<double>, graph_in_edges_time, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<double>, graph_update_time, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<int64_t>, graph_compactions, 0);
+// -1 until measured by Graph::report_placement()
+GRAPPA_DEFINE_METRIC(SimpleMetric<int64_t>, graph_edge_cut, -1);
+GRAPPA_DEFINE_METRIC(SimpleMetric<double>, graph_remote_fraction, -1);
+GRAPPA_DEFINE_METRIC(SimpleMetric<double>, graph_edge_imbalance, -1);
+
+namespace Grappa {
+  
+  GraphPartition graph_partition_policy(const std::string& name) {
+    if (name == "cyclic") return GraphPartition::Cyclic;
+    if (name == "hash")   return GraphPartition::Hash;
+    if (name == "degree") return GraphPartition::Degree;
+    if (name == "ldg")    return GraphPartition::LDG;
+    if (name == "fennel") return GraphPartition::Fennel;
+    LOG(FATAL) << "unknown graph partitioning policy: " << name;
+    return GraphPartition::Cyclic;
+  }
+  
+  std::ostream& operator<<(std::ostream& o, GraphPartition p) {
+    static const char * names[] = { "cyclic", "hash", "degree", "ldg", "fennel" };
+    return o << names[static_cast<int>(p)];
+  }
+  
+  namespace impl {
+    
+    std::vector<std::vector<GraphEdgePair>> graph_edge_buckets;
+    std::vector<GraphEdgePair> graph_edges_in;
+    GraphPartitionState graph_partition_state;
+    
+    int graph_file_open(const char * path, int flags) {
+      int fd = io_open(path, flags);
+      PCHECK(fd >= 0) << "Error opening graph file " << path;
+      return fd;
+    }
+    
+    void graph_file_read(int fd, void * buf, size_t n, size_t offset) {
+      if (n == 0) return;
+      auto r = io_read(fd, buf, n, offset);
+      CHECK_EQ(r, n) << "Error reading graph file at offset " << offset
+                     << (r < 0 ? ": " + std::string(strerror(-r)) : std::string(" (file truncated?)"));
+    }
+    
+    void graph_file_write(int fd, const void * buf, size_t n, size_t offset) {
+      if (n == 0) return;
+      auto r = io_write(fd, buf, n, offset);
+      CHECK_EQ(r, n) << "Error writing graph file at offset " << offset
+                     << (r < 0 ? ": " + std::string(strerror(-r)) : std::string());
+    }
+    
+    GraphFileHeader graph_file_header(const char * path) {
+      GraphFileHeader h;
+      int fd = graph_file_open(path, O_RDONLY);
+      graph_file_read(fd, &h, sizeof(h), 0);
+      close(fd);
+      CHECK(memcmp(h.magic, "GRPGRAPH", sizeof(h.magic)) == 0) << path << " is not a Grappa graph file";
+      CHECK_EQ(h.version, graph_file_version) << "unsupported graph file version in " << path;
+      return h;
+    }
+    
+  } // namespace impl
+} // namespace Grappa
@@ -31,10 +31,17 @@
 #include <Delegate.hpp>
 #include <AsyncDelegate.hpp>
 #include <Array.hpp>
+#include <AllToAll.hpp>
+#include <Metrics.hpp>
 #include "TupleGraph.hpp"
 
 #include <algorithm>
+#include <numeric>
 #include <iomanip>
+#include <fcntl.h>
+#include <unistd.h>
+#include <type_traits>
+#include <vector>
 
 // #define USE_MPI3_COLLECTIVES
 #undef USE_MPI3_COLLECTIVES
@@ -42,6 +49,24 @@
 #include <mpi.h>
 #endif
 
+DECLARE_bool( graph_create_alltoall );
+DECLARE_bool( graph_in_edges );
+DECLARE_double( graph_compact_fraction );
+DECLARE_string( graph_partition );
+DECLARE_int64( graph_partition_rounds );
+DECLARE_double( graph_partition_slack );
+
+GRAPPA_DECLARE_METRIC(SimpleMetric<double>, graph_count_time);
+GRAPPA_DECLARE_METRIC(SimpleMetric<double>, graph_scatter_time);
+GRAPPA_DECLARE_METRIC(SimpleMetric<double>, graph_sort_time);
+GRAPPA_DECLARE_METRIC(SimpleMetric<double>, graph_partition_time);
+GRAPPA_DECLARE_METRIC(SimpleMetric<double>, graph_in_edges_time);
+GRAPPA_DECLARE_METRIC(SimpleMetric<double>, graph_update_time);
+GRAPPA_DECLARE_METRIC(SimpleMetric<int64_t>, graph_compactions);
+GRAPPA_DECLARE_METRIC(SimpleMetric<int64_t>, graph_edge_cut);
+GRAPPA_DECLARE_METRIC(SimpleMetric<double>, graph_remote_fraction);
+GRAPPA_DECLARE_METRIC(SimpleMetric<double>, graph_edge_imbalance);
+
 namespace Grappa {
   /// @addtogroup Graph
   /// @{
@@ -52,13 +77,31 @@ namespace Grappa {
   /// Empty struct, for specifying lack of either Vertex or Edge data in @ref Graph.
   struct Empty {};
   
+  /// Vertex placement policies for Graph::partition (the default is set by
+  /// `--graph_partition`).
+  enum class GraphPartition {
+    Cyclic,   ///< vertex i on core i % cores() (plain global_alloc; no relabeling)
+    Hash,     ///< vertices hashed to cores
+    Degree,   ///< contiguous ranges of ids, balanced by out-degree + 1
+    LDG,      ///< streaming greedy: linear deterministic greedy
+    Fennel    ///< streaming greedy: Fennel objective (gamma = 1.5)
+  };
+  
+  /// Parse a policy name ("cyclic", "hash", "degree", "ldg" or "fennel").
+  GraphPartition graph_partition_policy(const std::string& name);
+  
+  std::ostream& operator<<(std::ostream& o, GraphPartition p);
+  
   namespace impl {
     
     struct VertexBase {
       bool valid; // vertices with no connections (in/out) are marked invalid TODO: eliminate these from the representation entirely
-      VertexID * local_adj; // adjacencies that are local
+      union {
+        VertexID * local_adj;   // adjacencies that are local
+        uint8_t * local_cadj;   // ...or their encoding, once Graph::compress()ed (see decode_adj_chunk)
+      };
       int64_t nadj;        // number of adjacencies
-      int64_t local_sz;    // size of local allocation (regardless of how full it is)
+      int64_t local_sz;    // size of local allocation (regardless of how full it is; bytes if compressed)
       
       VertexBase(): valid(true), local_adj(nullptr), nadj(0), local_sz(0) {}
       
@@ -125,6 +168,217 @@ namespace Grappa {
       static constexpr size_t size() { return locale_heap_size() + global_heap_size(); }
       
     } GRAPPA_BLOCK_ALIGNED;
+    
+    /// @name Compressed adjacencies (Graph::compress)
+    ///
+    /// A vertex's sorted adjacency list is cut into chunks of `adj_chunk`
+    /// edges. Each chunk is the first neighbor as a varint, then the gaps to
+    /// the following neighbors as varints, so chunks decode independently.
+    /// The stream starts with the byte offsets (uint32, from the end of this
+    /// table) of chunks 1..nchunks-1.
+    /// @{
+    
+    const int64_t adj_chunk = 64;
+    
+    inline int64_t adj_nchunks(int64_t nadj) { return (nadj + adj_chunk - 1) / adj_chunk; }
+    
+    inline size_t varint_size(uint64_t x) {
+      size_t n = 1;
+      while (x >= 0x80) { x >>= 7; n++; }
+      return n;
+    }
+    
+    inline uint8_t * put_varint(uint8_t * p, uint64_t x) {
+      while (x >= 0x80) { *p++ = static_cast<uint8_t>(x) | 0x80; x >>= 7; }
+      *p++ = static_cast<uint8_t>(x);
+      return p;
+    }
+    
+    inline const uint8_t * get_varint(const uint8_t * p, uint64_t * x) {
+      uint64_t v = *p & 0x7f;
+      int shift = 7;
+      while (*p++ & 0x80) { v |= static_cast<uint64_t>(*p & 0x7f) << shift; shift += 7; }
+      *x = v;
+      return p;
+    }
+    
+    /// Bytes to encode a sorted adjacency list.
+    inline size_t encoded_adj_size(const VertexID * adj, int64_t nadj) {
+      size_t n = sizeof(uint32_t) * std::max<int64_t>(adj_nchunks(nadj) - 1, 0);
+      for (int64_t i = 0; i < nadj; i++) {
+        n += varint_size(i % adj_chunk == 0 ? adj[i] : adj[i] - adj[i-1]);
+      }
+      return n;
+    }
+    
+    /// Encode a sorted adjacency list at `out`; returns the end of the encoding.
+    inline uint8_t * encode_adj(const VertexID * adj, int64_t nadj, uint8_t * out) {
+      auto offsets = out;
+      auto data = out + sizeof(uint32_t) * std::max<int64_t>(adj_nchunks(nadj) - 1, 0);
+      auto p = data;
+      for (int64_t i = 0; i < nadj; i++) {
+        if (i % adj_chunk == 0) {
+          if (i > 0) {
+            uint32_t off = p - data;
+            ::memcpy(offsets + sizeof(uint32_t)*(i/adj_chunk - 1), &off, sizeof(off));
+          }
+          p = put_varint(p, adj[i]);
+        } else {
+          CHECK_GE(adj[i], adj[i-1]) << "adjacency list not sorted";
+          p = put_varint(p, adj[i] - adj[i-1]);
+        }
+      }
+      return p;
+    }
+    
+    /// Call `f(i, j)` for each edge index `i` and neighbor `j` in chunk `c`.
+    template< typename F >
+    void decode_adj_chunk(const uint8_t * cadj, int64_t nadj, int64_t c, F f) {
+      int64_t nchunks = adj_nchunks(nadj);
+      auto data = cadj + sizeof(uint32_t) * (nchunks - 1);
+      auto p = data;
+      if (c > 0) {
+        uint32_t off;
+        ::memcpy(&off, cadj + sizeof(uint32_t)*(c-1), sizeof(off));
+        p += off;
+      }
+      int64_t end = std::min(nadj, (c+1) * adj_chunk);
+      uint64_t j = 0;
+      for (int64_t i = c * adj_chunk; i < end; i++) {
+        uint64_t x;
+        p = get_varint(p, &x);
+        j += x;
+        f(i, static_cast<VertexID>(j));
+      }
+    }
+    
+    /// @}
+    
+    struct GraphEdgePair { VertexID v0, v1; };
+    
+    /// Per-core staging for Graph::build_by_exchange.
+    extern std::vector<std::vector<GraphEdgePair>> graph_edge_buckets;
+    extern std::vector<GraphEdgePair> graph_edges_in;
+    
+    /// Per-core state for Graph::partition, indexed by local vertex.
+    struct GraphPartitionState {
+      std::vector<int32_t> part;        ///< core each local vertex is assigned to
+      std::vector<VertexID> new_id;     ///< id of each local vertex after relabeling
+      std::vector<GraphEdgePair> edges; ///< relabeled adjacencies to build from
+      int64_t block;                    ///< vertices per core after relabeling
+    };
+    extern GraphPartitionState graph_partition_state;
+    
+    /// Per-core bookkeeping for edge updates (Graph::insert_edges /
+    /// Graph::delete_edges), indexed by local vertex.
+    struct GraphUpdateLog {
+      std::vector<bool> moved;      ///< adjacencies moved out of adj_buf into their own arrays
+      int64_t moved_size;           ///< total capacity of those arrays
+      int64_t buf_size;             ///< entries in adj_buf/edge_storage
+      std::vector<int64_t> touched; ///< vertices updated since Graph::clear_updated()
+      
+      GraphUpdateLog(int64_t nlocal, int64_t buf_size)
+        : moved(nlocal, false), moved_size(0), buf_size(buf_size) {}
+    };
+    
+    inline Core graph_hash_core(VertexID v) {
+      uint64_t h = static_cast<uint64_t>(v) * 0x9E3779B97F4A7C15UL;
+      return (h ^ (h >> 29)) % cores();
+    }
+    
+    /// Edge source over the relabeled adjacencies in graph_partition_state.
+    struct RelabeledEdges {
+      template< typename F >
+      void forall_edges(F f) {
+        impl::forall_local([]{ return static_cast<int64_t>(graph_partition_state.edges.size()); },
+                           [f](int64_t s, int64_t n){
+          auto e = graph_partition_state.edges.data();
+          for (int64_t i = s; i < s+n; i++) f(e[i].v0, e[i].v1);
+        });
+      }
+    };
+    
+    /// @name Binary graph files (Graph::save / Graph::load)
+    ///
+    /// A header, then a table with one GraphFileSegment per core, then each
+    /// core's segment starting on a page boundary. A segment holds the
+    /// vertices `first, first+stride, first+2*stride, ...`: stride is the
+    /// number of cores for the default cyclic layout, and 1 for a
+    /// partitioned graph (see GraphPartition), whose distribution is saved
+    /// in the header.
+    /// @{
+    
+    struct GraphFileHeader {
+      char magic[8];
+      int64_t version;
+      int64_t nv, nadj;
+      int64_t ncores;
+      int64_t edge_bytes;   ///< sizeof(E) for saved edge state, 0 if none
+      int64_t dist_bits;    ///< Distribution::bits() of the vertex array
+      int64_t nv_orig;      ///< Graph::nv_orig if not nv, else 0
+    };
+    
+    const int64_t graph_file_version = 2;
+    
+    /// One core's part: degree[nv_local], valid[nv_local] (padded to 8 bytes),
+    /// adj[nadj_local], edge state[nadj_local].
+    struct GraphFileSegment {
+      int64_t first;        ///< id of the first vertex, or -1 if none
+      int64_t stride;       ///< distance between successive vertex ids
+      int64_t nv_local, nadj_local;
+      int64_t offset;       ///< file offset of this segment
+      
+      size_t valid_offset() const { return offset + sizeof(int64_t)*nv_local; }
+      size_t adj_offset() const { return valid_offset() + (nv_local+7)/8*8; }
+      size_t edge_offset() const { return adj_offset() + sizeof(VertexID)*nadj_local; }
+      size_t bytes(size_t edge_bytes) const {
+        return (edge_offset() - offset + edge_bytes*nadj_local + 4095) / 4096 * 4096;
+      }
+    };
+    
+    const size_t graph_file_max_path = 1024;
+    
+    inline size_t graph_file_data_offset(int64_t ncores) {
+      return (sizeof(GraphFileHeader) + sizeof(GraphFileSegment)*ncores + 4095) / 4096 * 4096;
+    }
+    
+    int graph_file_open(const char * path, int flags);
+    void graph_file_read(int fd, void * buf, size_t n, size_t offset);
+    void graph_file_write(int fd, const void * buf, size_t n, size_t offset);
+    GraphFileHeader graph_file_header(const char * path);
+    
+    /// Edge source over a graph file saved with a different number of cores.
+    struct GraphFileEdges {
+      char path[graph_file_max_path];
+      int64_t ncores;
+      
+      template< typename F >
+      void forall_edges(F f) {
+        auto self = *this;
+        int64_t ncores = this->ncores;
+        // this core reads segments mycore(), mycore()+cores(), ...
+        impl::forall_local([ncores]{ return (ncores - mycore() + cores() - 1) / cores(); },
+        [self,f](int64_t s, int64_t n){
+          int fd = graph_file_open(self.path, O_RDONLY);
+          for (int64_t p = mycore() + s*cores(); p < mycore() + (s+n)*cores(); p += cores()) {
+            GraphFileSegment seg;
+            graph_file_read(fd, &seg, sizeof(seg), sizeof(GraphFileHeader) + p*sizeof(seg));
+            std::vector<int64_t> degree(seg.nv_local);
+            std::vector<VertexID> adj(seg.nadj_local);
+            graph_file_read(fd, degree.data(), sizeof(int64_t)*seg.nv_local, seg.offset);
+            graph_file_read(fd, adj.data(), sizeof(VertexID)*seg.nadj_local, seg.adj_offset());
+            int64_t k = 0;
+            for (int64_t j = 0; j < seg.nv_local; j++) {
+              VertexID v = seg.first + j*seg.stride;
+              for (int64_t e = 0; e < degree[j]; e++, k++) f(v, adj[k]);
+            }
+          }
+          close(fd);
+        });
+      }
+    };
+    
+    /// @}
   
   }
   
@@ -170,13 +424,20 @@ namespace Grappa {
   /// ----------------
   /// 
   /// This Graph structure is constructed from a TupleGraph (a simple list
-  /// of edge tuples -- source & dest) using Graph::create().
+  /// of edge tuples -- source & dest) using Graph::create(). A built graph
+  /// can be written with save() and read back with Graph::load(), which is
+  /// much faster than constructing it again.
   /// 
-  /// Vertices are randomly distributed among cores (using a simple global
-  /// heap allocation). Edges are placed on the core of their *source* vertex.
-  /// Therefore, iterating over outgoing edges is very efficient, but a 
-  /// vertex's incoming edges must be found the hard way (in practice, 
-  /// we just avoid doing it entirely if using this graph structure).
+  /// Vertices are distributed cyclically among cores (using a simple global
+  /// heap allocation). partition() builds a copy with the vertices placed
+  /// by a partitioner instead, relabeled so each core owns a contiguous
+  /// range of ids; it keeps the mapping to the original ids. Edges are
+  /// placed on the core of their *source* vertex.
+  /// Therefore, iterating over outgoing edges is very efficient. Incoming
+  /// edges are only available after build_in_edges() (or with
+  /// `--graph_in_edges`), which keeps a transposed copy of the adjacencies
+  /// (sources of each vertex's in-edges, sorted) on the core of each
+  /// destination vertex, to be iterated with `in_adj(g,v)`.
   /// 
   /// Parallel Iterators
   /// -------------------
@@ -234,6 +495,11 @@ namespace Grappa {
   ///   forall<async>(adj(g,v), [&v](int64_t ei, Edge& e){
   ///     LOG(INFO) << "v.adj[" << ei << "] = " << e.id;
   ///   });
+  ///
+  ///   // incoming edges (after build_in_edges()), without edge state
+  ///   forall<async>(in_adj(g,v), [&v](InEdge& e){
+  ///     LOG(INFO) << e.id << " -> " << v.id;
+  ///   });
   /// 
   /// });
   /// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -253,6 +519,12 @@ namespace Grappa {
       const EdgeState* operator->() const { return &data; }
     };
     
+    /// Incoming edge, seen from its destination (see in_adj()).
+    struct InEdge {
+      VertexID id; ///< Global index of the source vertex
+      GlobalAddress<Vertex> ga; ///< Global address of the source vertex
+    };
+    
     static_assert(block_size % sizeof(Vertex) == 0, "V size not evenly divisible into blocks!");
     
     // using Vertex = V;
@@ -264,10 +536,23 @@ namespace Grappa {
     // Fields
     GlobalAddress<Vertex> vs;
     int64_t nv, nadj, nadj_local;
+    
+    /// After partition(): the number of vertices in the graph it was built
+    /// from (`nv` also counts the invalid padding), the original id of each
+    /// vertex (-1 for padding), and the new id of each original vertex. Otherwise `nv_orig == nv` and the maps are null.
+    int64_t nv_orig;
+    GlobalAddress<VertexID> orig_id, new_id;
   
     // Internal fields
     VertexID * adj_buf;
     EdgeState * edge_storage;
+    uint8_t * cadj_buf;     ///< encoded adjacencies, after compress()
+    size_t cadj_bytes;
+    bool compressed;
+    int64_t * in_offsets;   ///< per local vertex, start of its in-edges (after build_in_edges())
+    VertexID * in_adj_buf;
+    int64_t nin_local;
+    impl::GraphUpdateLog * updates;  ///< allocated by the first edge update
     
     // Temporary internal state
     void* scratch;
@@ -280,11 +565,32 @@ namespace Grappa {
       , nv(nv)
       , nadj(0)
       , nadj_local(0)
+      , nv_orig(nv)
+      , orig_id()
+      , new_id()
       , adj_buf(nullptr)
+      , cadj_buf(nullptr)
+      , cadj_bytes(0)
+      , compressed(false)
+      , in_offsets(nullptr)
+      , in_adj_buf(nullptr)
+      , nin_local(0)
+      , updates(nullptr)
       , scratch(nullptr)
     { }
   
     ~Graph() {
+      if (updates) {
+        auto base = vs.localize();
+        for (size_t k = 0; k < updates->moved.size(); k++) {
+          if (updates->moved[k]) {
+            locale_free(base[k].local_adj);
+            locale_free(base[k].local_edge_state);
+          }
+        }
+        nadj_local = updates->buf_size;
+        delete updates;
+      }
       for (Vertex& v : iterate_local(vs, nv)) { v.~Vertex(); }
       if (edge_storage) {
         for (int64_t i=0; i<nadj_local; i++) {
@@ -293,22 +599,138 @@ namespace Grappa {
         locale_free(edge_storage);
       }
       if (adj_buf) locale_free(adj_buf);
+      if (cadj_buf) locale_free(cadj_buf);
+      if (in_offsets) locale_free(in_offsets);
+      if (in_adj_buf) locale_free(in_adj_buf);
     }
   
     void destroy() {
       auto self = this->self;
       global_free(this->vs);
+      if (is_relabeled()) {
+        global_free(this->orig_id);
+        global_free(this->new_id);
+      }
       call_on_all_cores([self]{ self->~Graph(); });
       global_free(self);
     }
+    
+    bool is_relabeled() const { return orig_id.raw_bits() != 0; }
+    
+    /// Id in this graph of vertex `v` of the graph partition() was called on
+    /// (`v` itself if this graph wasn't relabeled).
+    VertexID renamed(VertexID v) {
+      return is_relabeled() ? delegate::read(new_id + v) : v;
+    }
+    
+    /// Rename the endpoints of `tg`'s edges from the original ids to this
+    /// graph's (see renamed()), e.g. before passing them to insert_edges().
+    void relabel_edges(TupleGraph& tg);
+    
+    /// Write the built graph to `path` in Grappa's binary graph format, each
+    /// core writing its own vertices' adjacencies (and edge state, which is
+    /// copied as raw bytes) in parallel. Vertex data and the maps to
+    /// original ids of a partitioned graph are not saved.
+    void save(std::string path);
+    
+    /// Load a graph written by save(). With the same number of cores, each
+    /// core reads its segment straight into place, skipping the scatter and
+    /// sort of create(); otherwise the saved edges are rebuilt with
+    /// create() (edge state is then default-initialized).
+    static GlobalAddress<Graph> load(std::string path);
+    
+    /// Re-encode all adjacency lists with delta + varint coding (see
+    /// impl::encode_adj), typically 2-4x smaller than VertexIDs for sorted
+    /// lists. Iteration with forall(adj(g,v)), serial_for, or for_each_adj
+    /// decodes transparently; direct use of `local_adj` or edge() is no
+    /// longer allowed. Call from a task, like create().
+    void compress();
+    
+    /// Build the in-edge index: for each vertex, the sorted ids of the
+    /// vertices with an edge to it, stored on the vertex's core. Costs one
+    /// all-to-all exchange of all adjacencies, and a VertexID per edge.
+    void build_in_edges();
+    
+    bool has_in_edges() const { return in_offsets != nullptr; }
+    
+    /// Number of incoming edges of local vertex `v`.
+    int64_t in_degree(Vertex& v) {
+      DCHECK(has_in_edges()) << "build_in_edges() first";
+      auto k = &v - vs.localize();
+      return in_offsets[k+1] - in_offsets[k];
+    }
+    
+    /// Sources of the incoming edges of local vertex `v` (in_degree(v) of them).
+    VertexID * local_in_adj(Vertex& v) { return in_adj_buf + in_offsets[&v - vs.localize()]; }
+    
+    /// @name Edge updates
+    ///
+    /// Batches of edges can be inserted or deleted after create(); the set
+    /// of vertices stays the same. Each batch is sent to the cores owning
+    /// the source vertices with one all-to-all exchange, and applied to the
+    /// sorted adjacency lists in place. Deleting leaves slack at the end of
+    /// a vertex's list. A vertex with no slack left moves its list out to
+    /// its own array, and doubles the array's size when it fills up. Once
+    /// `--graph_compact_fraction` of a core's adjacencies have moved, they
+    /// are packed back into one buffer (see compact()).
+    ///
+    /// Afterwards, forall_updated() visits the endpoints of every updated
+    /// edge, to seed an incremental recomputation (e.g. re-activate them in
+    /// a GraphLab engine that keeps its previous result). Updates need
+    /// trivially-copyable edge state and an uncompressed graph. An in-edge
+    /// index is rebuilt after each batch.
+    /// @{
+    
+    /// Insert edges `v0 -> v1` (and `v1 -> v0`, unless `directed`), which
+    /// marks both endpoints valid. Existing edges are left as they are;
+    /// new ones get default edge state.
+    void insert_edges(const TupleGraph& batch, bool directed = false);
+    
+    /// Delete edges `v0 -> v1` (and `v1 -> v0`, unless `directed`), if they
+    /// exist. Vertices that are left without edges stay valid.
+    void delete_edges(const TupleGraph& batch, bool directed = false);
+    
+    /// Insert or delete the edges of any edge source (see create_from()).
+    template< typename EdgeSource >
+    void update_edges(EdgeSource edges, bool insert, bool directed);
+    
+    /// Pack every core's adjacencies back into one buffer, dropping slack.
+    void compact();
+    
+    /// Call `f(Vertex&)` in parallel on each vertex that was an endpoint of
+    /// an edge inserted or deleted since the last clear_updated(). `f` may
+    /// issue async delegates; they are done before this returns.
+    template< typename F >
+    void forall_updated(F f);
+    
+    void clear_updated();
+    
+    void insert_local(Vertex& v, VertexID j);
+    void delete_local(Vertex& v, VertexID j);
+    void compact_local();
+    
+    /// @}
+    
+    /// Call `f(int64_t i, VertexID j)` for each adjacency of local vertex
+    /// `v` in order, whether or not the graph is compressed.
+    template< typename F >
+    void for_each_adj(Vertex& v, F f) {
+      if (compressed) {
+        for (int64_t c = 0; c < impl::adj_nchunks(v.nadj); c++) {
+          impl::decode_adj_chunk(v.local_cadj, v.nadj, c, f);
+        }
+      } else {
+        for (int64_t i = 0; i < v.nadj; i++) f(i, v.local_adj[i]);
+      }
+    }
   
     template< int LEVEL = 0 >
     static void dump(GlobalAddress<Graph> g) {
       for (int64_t i=0; i<g->nv; i++) {
-        delegate::call(g->vs+i, [i](Vertex& v){
+        delegate::call(g->vs+i, [g,i](Vertex& v){
           std::stringstream ss;
           ss << "<" << i << ">";
-          for (int64_t i=0; i<v.nadj; i++) ss << " " << v.local_adj[i];
+          g->for_each_adj(v, [&ss](int64_t, VertexID j){ ss << " " << j; });
           VLOG(LEVEL) << ss.str();
         });
       }
@@ -316,12 +738,13 @@ namespace Grappa {
     
     template< int LEVEL = 0, typename F = nullptr_t >
     void dump(F print_vertex) {
+      auto g = self;
       for (int64_t i=0; i<nv; i++) {
-        delegate::call(vs+i, [i,print_vertex](Vertex& v){
+        delegate::call(vs+i, [g,i,print_vertex](Vertex& v){
           std::stringstream ss;
           ss << "<" << std::setw(2) << i << ">";
           print_vertex(ss, v);
-          for (int64_t i=0; i<v.nadj; i++) ss << " " << v.local_adj[i];
+          g->for_each_adj(v, [&ss](int64_t, VertexID j){ ss << " " << j; });
           if (VLOG_IS_ON(LEVEL)) std::cerr << ss.str() << "\n";
         });
       }
@@ -358,14 +781,70 @@ namespace Grappa {
     // Constructor
     static GlobalAddress<Graph> create(const TupleGraph& tg, bool directed = false, bool solo_invalid = true);
     
+    /// Construct from bintsv4 edges mapped in place (see MappedTupleGraph),
+    /// without going through a 64-bit TupleGraph.
+    static GlobalAddress<Graph> create(GlobalAddress<MappedTupleGraph> tg, bool directed = false, bool solo_invalid = true);
+    
+    /// Construct from any edge source providing `forall_edges(f)`, which
+    /// calls `f(int64_t v0, int64_t v1)` on every edge in parallel and blocks
+    /// until those calls (and async delegates they issue) are done.
+    ///
+    /// By default the number of vertices is found from the edges, and
+    /// vertices are placed cyclically. Passing `nv` and a non-default `dist`
+    /// lays the vertices out as given instead.
+    template< typename EdgeSource >
+    static GlobalAddress<Graph> create_from(EdgeSource edges, bool directed, bool solo_invalid,
+                                            int64_t nv = 0, Distribution dist = Distribution());
+    
+    template< typename EdgeSource >
+    static void build_by_delegates(GlobalAddress<Graph> g, EdgeSource& edges, bool directed);
+    template< typename EdgeSource >
+    static void build_by_exchange(GlobalAddress<Graph> g, EdgeSource& edges, bool directed);
+    
+    /// Build a copy of `g` with its vertices placed by `policy` and relabeled
+    /// so that each core owns one contiguous range of ids: core `c` holds
+    /// ids `[c*B, (c+1)*B)` of a Block-distributed vertex array, where `B`
+    /// is the largest part, rounded up to a representable block size. The
+    /// padding vertices are invalid, and the validity of the rest is kept.
+    /// Vertex data and edge state are default-initialized, as in create().
+    /// `g` is left unchanged. Ids from `g` (or the TupleGraph it was built
+    /// from) can be translated with renamed(), relabel_edges() or `new_id`,
+    /// and back with `orig_id`.
+    static GlobalAddress<Graph> partition(GlobalAddress<Graph> g,
+        GraphPartition policy = graph_partition_policy(FLAGS_graph_partition));
+    
+    /// For apps that let users pick a placement: unless `--graph_partition`
+    /// is the default cyclic one, returns partition(g) and destroys `g`.
+    /// Callers then translate ids they bring from outside (roots, edges to
+    /// verify or insert) with renamed() or relabel_edges(), and use
+    /// `nv_orig` where they mean the number of vertices.
+    static GlobalAddress<Graph> partition_by_flag(GlobalAddress<Graph> g) {
+      if (graph_partition_policy(FLAGS_graph_partition) == GraphPartition::Cyclic) return g;
+      auto gp = partition(g);
+      g->destroy();
+      return gp;
+    }
+    
+    static void place_by_degree(GlobalAddress<Graph> g);
+    static void place_by_streaming(GlobalAddress<Graph> g, GraphPartition policy);
+    
+    /// Count adjacencies whose endpoints are on different cores (each is a
+    /// remote message in a push-style traversal), and set the
+    /// graph_edge_cut, graph_remote_fraction and graph_edge_imbalance
+    /// (largest over mean adjacencies per core) metrics, which are -1 until
+    /// measured; logged with `--v=1`. partition() always does this; create()
+    /// doesn't, since it is a pass over all edges.
+    void report_placement();
+    
     static GlobalAddress<Graph> Undirected(const TupleGraph& tg) { return create(tg, false); }
     static GlobalAddress<Graph> Directed(const TupleGraph& tg) { return create(tg, true); }
       
     VertexID id(Vertex& v) {
-      return make_linear(&v) - vs;
+      return make_linear(&v, vs.distribution()) - vs;
     }
     
     Edge edge(Vertex& v, size_t i) {
+      DCHECK(!compressed) << "no random access to compressed adjacencies";
       auto j = v.local_adj[i];
       return Edge{ j, vs+j, v.local_edge_state[i] };
     }
@@ -385,7 +864,7 @@ namespace Grappa {
   /// Iterator over adjacent vertices. Used with Grappa::forall().
   template< typename G >
   AdjIterator<G> adj(GlobalAddress<G> g, typename G::Vertex& v) {
-    return AdjIterator<G>(g, make_linear(&v) - g->vs);
+    return AdjIterator<G>(g, g->id(v));
   }
   
   template< typename G >
@@ -396,36 +875,42 @@ namespace Grappa {
   template< typename G >
   AdjIterator<G> adj(GlobalAddress<G> g, VertexID i) { return AdjIterator<G>(g, i); }  
   
+  template< typename G >
+  struct InAdjIterator {
+    GlobalAddress<G> g;
+    VertexID i;
+    InAdjIterator(GlobalAddress<G> g, VertexID i): g(g), i(i) {}
+  };
+  
+  /// Iterator over the sources of a vertex's incoming edges (requires
+  /// Graph::build_in_edges()). Used with Grappa::forall().
+  template< typename G >
+  InAdjIterator<G> in_adj(GlobalAddress<G> g, typename G::Vertex& v) {
+    return InAdjIterator<G>(g, g->id(v));
+  }
+  
+  template< typename G >
+  InAdjIterator<G> in_adj(GlobalAddress<G> g, GlobalAddress<typename G::Vertex> v) {
+    return InAdjIterator<G>(g, v - g->vs);
+  }
+  
+  template< typename G >
+  InAdjIterator<G> in_adj(GlobalAddress<G> g, VertexID i) { return InAdjIterator<G>(g, i); }
+  
   namespace impl {
-    template< SyncMode S, GlobalCompletionEvent * C, int64_t Threshold, typename G, typename F >
-    void forall(AdjIterator<G> a, F body,
-                void (F::*mf)(int64_t,typename G::Edge&) const)
-    {
-      if (C) C->enroll();
-      auto origin = mycore();
-      
-      auto loop = [a,origin,body]{
-        auto vs = a.g->vs;
-        auto v = (vs+a.i).pointer();
-        Grappa::forall_here<S,C,Threshold>(0, v->nadj, [body,v,vs](int64_t i){
-          auto j = v->local_adj[i];
-          typename G::Edge e = { j, vs+j, v->local_edge_state[i] };
-          body(i, e);
-        });
-        if (C) C->send_completion(origin);
-      };
-      
-      auto v = a.g->vs+a.i;
-      
-      if (v.core() == mycore()) {
+    /// Run `loop` on core `c`: inline if that is this core, otherwise in a
+    /// task there, waiting for it unless `S` is async.
+    template< SyncMode S, typename F >
+    void run_on_core(Core c, F loop) {
+      if (c == mycore()) {
         loop();
       } else {
         if (S == SyncMode::Async) {
-          spawnRemote<nullptr>(v.core(), [loop]{ loop(); });
+          spawnRemote<nullptr>(c, [loop]{ loop(); });
         } else {
           CompletionEvent ce(1);
           auto ce_a = make_global(&ce);
-          spawnRemote<nullptr>(v.core(), [loop,ce_a]{
+          spawnRemote<nullptr>(c, [loop,ce_a]{
             loop();
             complete(ce_a);
           });
@@ -433,6 +918,36 @@ namespace Grappa {
         }
       }
     }
+    
+    template< SyncMode S, GlobalCompletionEvent * C, int64_t Threshold, typename G, typename F >
+    void forall(AdjIterator<G> a, F body,
+                void (F::*mf)(int64_t,typename G::Edge&) const)
+    {
+      if (C != nullptr) C->enroll();
+      auto origin = mycore();
+      
+      auto loop = [a,origin,body]{
+        auto vs = a.g->vs;
+        auto v = (vs+a.i).pointer();
+        if (a.g->compressed) {
+          // parallel over chunks, which decode independently
+          Grappa::forall_here<S,C,Threshold>(0, impl::adj_nchunks(v->nadj), [body,v,vs](int64_t c){
+            impl::decode_adj_chunk(v->local_cadj, v->nadj, c, [body,v,vs](int64_t i, VertexID j){
+              typename G::Edge e = { j, vs+j, v->local_edge_state[i] };
+              body(i, e);
+            });
+          });
+        } else {
+          Grappa::forall_here<S,C,Threshold>(0, v->nadj, [body,v,vs](int64_t i){
+            auto j = v->local_adj[i];
+            typename G::Edge e = { j, vs+j, v->local_edge_state[i] };
+            body(i, e);
+          });
+        }
+        if (C != nullptr) C->send_completion(origin);
+      };
+      run_on_core<S>((a.g->vs+a.i).core(), loop);
+    }
     template< SyncMode S, GlobalCompletionEvent * C, int64_t Threshold, typename G, typename F >
     void forall(AdjIterator<G> a, F body, void (F::*mf)(int64_t) const) {
       auto f = [body](int64_t i, typename G::Edge& e){ body(i); };
@@ -443,18 +958,60 @@ namespace Grappa {
       auto f = [body](int64_t i, typename G::Edge& e){ body(e); };
       impl::forall<S,C,Threshold>(a, f, &decltype(f)::operator());
     }
+    
+    template< SyncMode S, GlobalCompletionEvent * C, int64_t Threshold, typename G, typename F >
+    void forall(InAdjIterator<G> a, F body,
+                void (F::*mf)(int64_t,typename G::InEdge&) const)
+    {
+      CHECK(a.g->has_in_edges()) << "in_adj() needs Graph::build_in_edges()";
+      if (C != nullptr) C->enroll();
+      auto origin = mycore();
+      
+      auto loop = [a,origin,body]{
+        auto vs = a.g->vs;
+        auto& v = *(vs+a.i).pointer();
+        auto in = a.g->local_in_adj(v);
+        Grappa::forall_here<S,C,Threshold>(0, a.g->in_degree(v), [body,in,vs](int64_t i){
+          typename G::InEdge e = { in[i], vs+in[i] };
+          body(i, e);
+        });
+        if (C != nullptr) C->send_completion(origin);
+      };
+      run_on_core<S>((a.g->vs+a.i).core(), loop);
+    }
+    template< SyncMode S, GlobalCompletionEvent * C, int64_t Threshold, typename G, typename F >
+    void forall(InAdjIterator<G> a, F body, void (F::*mf)(int64_t) const) {
+      auto f = [body](int64_t i, typename G::InEdge& e){ body(i); };
+      impl::forall<S,C,Threshold>(a, f, &decltype(f)::operator());
+    }
+    template< SyncMode S, GlobalCompletionEvent * C, int64_t Threshold, typename G, typename F >
+    void forall(InAdjIterator<G> a, F body, void (F::*mf)(typename G::InEdge&) const) {
+      auto f = [body](int64_t i, typename G::InEdge& e){ body(e); };
+      impl::forall<S,C,Threshold>(a, f, &decltype(f)::operator());
+    }
   }
   
-#define OVERLOAD(...) \
+#define OVERLOAD(Iterator, ...) \
   template< __VA_ARGS__, typename G = nullptr_t, typename F = nullptr_t > \
-  void forall(AdjIterator<G> a, F body) { \
+  void forall(Iterator<G> a, F body) { \
     impl::forall<S,C,Threshold>(a, body, &F::operator()); \
   }
   /// Parallel loop over adjacent vertices. Use adj() to construct iterator
-  OVERLOAD( SyncMode S = SyncMode::Blocking,
+  OVERLOAD( AdjIterator,
+            SyncMode S = SyncMode::Blocking,
+            GlobalCompletionEvent * C = &impl::local_gce,
+            int64_t Threshold = impl::USE_LOOP_THRESHOLD_FLAG );
+  OVERLOAD( AdjIterator,
+            GlobalCompletionEvent * C,
+            SyncMode S = SyncMode::Blocking,
+            int64_t Threshold = impl::USE_LOOP_THRESHOLD_FLAG );
+  /// Parallel loop over sources of incoming edges. Use in_adj() to construct iterator
+  OVERLOAD( InAdjIterator,
+            SyncMode S = SyncMode::Blocking,
             GlobalCompletionEvent * C = &impl::local_gce,
             int64_t Threshold = impl::USE_LOOP_THRESHOLD_FLAG );
-  OVERLOAD( GlobalCompletionEvent * C,
+  OVERLOAD( InAdjIterator,
+            GlobalCompletionEvent * C,
             SyncMode S = SyncMode::Blocking,
             int64_t Threshold = impl::USE_LOOP_THRESHOLD_FLAG );
 #undef OVERLOAD
@@ -464,10 +1021,21 @@ namespace Grappa {
     auto vs = a.g->vs;
     auto v = (vs+a.i).pointer();
     CHECK((vs+a.i).core() == mycore());
-    for (int64_t i = 0; i < v->nadj; i++) {
-      auto j = v->local_adj[i];
+    a.g->for_each_adj(*v, [body,v,vs](int64_t i, VertexID j){
       typename G::Edge e = { j, vs+j, v->local_edge_state[i] };
       body(e);
+    });
+  }
+  
+  template< typename G = nullptr_t, typename F = nullptr_t >
+  void serial_for(InAdjIterator<G> a, F body) {
+    auto vs = a.g->vs;
+    auto v = (vs+a.i).pointer();
+    CHECK((vs+a.i).core() == mycore());
+    auto in = a.g->local_in_adj(*v);
+    for (int64_t i = 0; i < a.g->in_degree(*v); i++) {
+      typename G::InEdge e = { in[i], vs+in[i] };
+      body(e);
     }
   }
   
@@ -537,7 +1105,7 @@ namespace Grappa {
     void forall(GlobalAddress<G> g, F loop_body,
                 void (F::*mf)(GlobalAddress<typename G::Vertex> src, GlobalAddress<typename G::Vertex> dst) const) {
       Grappa::forall<C,Threshold>(g, [g,loop_body](VertexID i, typename G::Vertex& v){
-        auto vi = make_linear(&v);
+        auto vi = make_linear(&v, g->vs.distribution());
         Grappa::forall<SyncMode::Async,C,Threshold>(adj(g,v), [loop_body,vi](typename G::Edge& e){
           loop_body(vi, e.ga);
         });
@@ -595,6 +1163,26 @@ namespace Grappa {
   // });
   //
   
+  namespace impl {
+    
+    /// Edge source over a TupleGraph's (64-bit) edge array.
+    struct TupleGraphEdges {
+      const TupleGraph& tg;
+      template< typename F >
+      void forall_edges(F f) {
+        Grappa::forall(tg.edges, tg.nedge, [f](TupleGraph::Edge& e){ f(e.v0, e.v1); });
+      }
+    };
+    
+    /// Edge source over mapped 32-bit bintsv4 edges.
+    struct MappedEdges {
+      GlobalAddress<MappedTupleGraph> tg;
+      template< typename F >
+      void forall_edges(F f) { tg->forall_edges(f); }
+    };
+    
+  } // namespace impl
+  
   /// @brief Construct a distributed adjacency-list Graph.
   /// 
   /// @return The symmetric address to the 'proxy' allocated on each core,
@@ -608,22 +1196,39 @@ namespace Grappa {
   template< typename V, typename E >
   GlobalAddress<Graph<V,E>> Graph<V,E>::create(const TupleGraph& tg,
       bool directed, bool solo_invalid) {
+    return create_from(impl::TupleGraphEdges{tg}, directed, solo_invalid);
+  }
+  
+  template< typename V, typename E >
+  GlobalAddress<Graph<V,E>> Graph<V,E>::create(GlobalAddress<MappedTupleGraph> tg,
+      bool directed, bool solo_invalid) {
+    return create_from(impl::MappedEdges{tg}, directed, solo_invalid);
+  }
+  
+  template< typename V, typename E >
+  template< typename EdgeSource >
+  GlobalAddress<Graph<V,E>> Graph<V,E>::create_from(EdgeSource edges,
+      bool directed, bool solo_invalid, int64_t nv, Distribution dist) {
     VLOG(1) << "Graph: " << (directed ? "directed" : "undirected");
     double t;
     auto g = symmetric_global_alloc<Graph>();
     
-    // find nv
-        t = walltime();
-    forall(tg.edges, tg.nedge, [g](TupleGraph::Edge& e){
-      if (e.v0 > g->nv) { g->nv = e.v0; }
-      if (e.v1 > g->nv) { g->nv = e.v1; }
-    });
-    on_all_cores([g]{
-      g->nv = Grappa::allreduce<int64_t,collective_max>(g->nv) + 1;
-    });
-        VLOG(2) << "find_nv_time: " << walltime() - t;
+    if (nv > 0) {
+      call_on_all_cores([g,nv]{ g->nv = nv; });
+    } else {
+      // find nv
+          t = walltime();
+      edges.forall_edges([g](int64_t v0, int64_t v1){
+        if (v0 > g->nv) { g->nv = v0; }
+        if (v1 > g->nv) { g->nv = v1; }
+      });
+      on_all_cores([g]{
+        g->nv = Grappa::allreduce<int64_t,collective_max>(g->nv) + 1;
+      });
+          VLOG(2) << "find_nv_time: " << walltime() - t;
+    }
 
-    auto vs = global_alloc<Vertex>(g->nv);
+    auto vs = global_alloc<Vertex>(g->nv, dist);
     auto self = g;
     on_all_cores([g,vs]{
       new (g.localize()) Graph(g, vs, g->nv);
@@ -643,24 +1248,62 @@ namespace Grappa {
       VLOG(0) << "locale = " << mylocale() << ", scratch = " << g->scratch;
   #endif
     });
+    
+    if (FLAGS_graph_create_alltoall) {
+      build_by_exchange(g, edges, directed);
+    } else {
+      build_by_delegates(g, edges, directed);
+    }
+    
+    if (solo_invalid) {
+      // (note: this isn't necessary if we don't create vertices for those with no edges)
+      // find which are actually active (first, those with outgoing edges)
+      forall(g, [](Vertex& v){ v.valid = (v.nadj > 0); });
+      // then those with only incoming edges (reachable from at least one active vertex)
+      forall(g, [](Edge& e, Vertex& ve){ ve.valid = true; });
+    }    
+    VLOG(1) << "-- vertices: " << g->nv;
+    
+    if (FLAGS_graph_in_edges) g->build_in_edges();
+    
+    auto gsz = Vertex::global_heap_size()*g->nv
+                          + sizeof(Graph) * cores();
+    auto lsz = Vertex::locale_heap_size()*g->nv
+                          + (sizeof(VertexID)+sizeof(EdgeState))*g->nadj;
+    if (g->has_in_edges()) lsz += sizeof(VertexID)*g->nadj + sizeof(int64_t)*g->nv;
+    auto GB = [](size_t v){ return static_cast<double>(v) / (1L<<30); };
+    LOG(INFO) << "\nGraph memory breakdown:"
+              << "\n  locale_heap_size: " << GB(lsz) << " GB"
+              << "\n  global_heap_size: " << GB(gsz) << " GB"
+              << "\n  graph_total_size: " << GB(lsz+gsz) << " GB";
+    return g;
+  }
+  
+  /// Build adjacencies with async delegates: one to count each edge endpoint
+  /// at its vertex, then one to place it.
+  template< typename V, typename E >
+  template< typename EdgeSource >
+  void Graph<V,E>::build_by_delegates(GlobalAddress<Graph> g, EdgeSource& edges, bool directed) {
+    double t;
                                                               t = walltime();
     // count the outgoing/undirected edges per vertex
-    forall(tg.edges, tg.nedge, [g,directed](TupleGraph::Edge& e){
-      CHECK_LT(e.v0, g->nv); CHECK_LT(e.v1, g->nv);
+    edges.forall_edges([g,directed](int64_t v0, int64_t v1){
+      CHECK_LT(v0, g->nv); CHECK_LT(v1, g->nv);
   #ifdef SMALL_GRAPH
-      // g->scratch[e.v0]++;
-      // if (!directed) g->scratch[e.v1]++;
-      __sync_fetch_and_add(g->scratch+e.v0, 1);
-      if (!directed) __sync_fetch_and_add(g->scratch+e.v1, 1);
+      // g->scratch[v0]++;
+      // if (!directed) g->scratch[v1]++;
+      __sync_fetch_and_add(g->scratch+v0, 1);
+      if (!directed) __sync_fetch_and_add(g->scratch+v1, 1);
   #else    
       auto count = [](GlobalAddress<Vertex> v){
         delegate::call<SyncMode::Async>(v.core(), [v]{ v->local_sz++; });
       };
-      count(g->vs+e.v0);
-      if (!directed) count(g->vs+e.v1);
+      count(g->vs+v0);
+      if (!directed) count(g->vs+v1);
   #endif
     });
-    VLOG(2) << "count_time: " << walltime() - t;
+    graph_count_time = walltime() - t;
+    VLOG(2) << "count_time: " << graph_count_time;
 
   #ifdef SMALL_GRAPH
     t = walltime();  
@@ -693,7 +1336,8 @@ namespace Grappa {
     VLOG(3) << "after adj allocs";
 
     // scatter
-    forall(tg.edges, tg.nedge, [g,directed](TupleGraph::Edge& e){
+    t = walltime();
+    edges.forall_edges([g,directed](int64_t v0, int64_t v1){
       auto scatter = [g](int64_t vi, int64_t adj) {
         auto vaddr = g->vs+vi;
         delegate::call<SyncMode::Async>(vaddr.core(), [vaddr,adj]{
@@ -701,12 +1345,14 @@ namespace Grappa {
           v.local_adj[v.nadj++] = adj;
         });
       };
-      scatter(e.v0, e.v1);
-      if (!directed) scatter(e.v1, e.v0);
+      scatter(v0, v1);
+      if (!directed) scatter(v1, v0);
     });
+    graph_scatter_time = walltime() - t;
     VLOG(3) << "after scatter, nv = " << g->nv;
 
     // sort & de-dup
+    t = walltime();
     forall(g->vs, g->nv, [g](int64_t vi, Vertex& v){
       CHECK_EQ(v.nadj, v.local_sz);
       std::sort(v.local_adj, v.local_adj+v.nadj);
@@ -720,6 +1366,7 @@ namespace Grappa {
       // VLOG(0) << "<" << vi << ">" << util::array_str("", v.local_adj, v.nadj);
       g->nadj_local += v.nadj;
     });
+    graph_sort_time = walltime() - t;
     VLOG(3) << "after sort";
 
     // compact
@@ -755,25 +1402,757 @@ namespace Grappa {
       }
       CHECK_EQ(offset, g->nadj_local);
     });
+  }
+  
+  /// Build adjacencies in bulk: bucket edges by the core owning their source
+  /// vertex, exchange the buckets with one alltoallv, then lay out each core's
+  /// adjacencies with a local counting sort.
+  template< typename V, typename E >
+  template< typename EdgeSource >
+  void Graph<V,E>::build_by_exchange(GlobalAddress<Graph> g, EdgeSource& edges, bool directed) {
+    using impl::GraphEdgePair;
+    double t = walltime();
+    on_all_cores([]{ impl::graph_edge_buckets.resize(cores()); });
+    edges.forall_edges([g,directed](int64_t v0, int64_t v1){
+      CHECK_LT(v0, g->nv); CHECK_LT(v1, g->nv);
+      auto& out = impl::graph_edge_buckets;
+      out[(g->vs+v0).core()].push_back(GraphEdgePair{v0, v1});
+      if (!directed) out[(g->vs+v1).core()].push_back(GraphEdgePair{v1, v0});
+    });
+    graph_count_time = walltime() - t;
     
-    if (solo_invalid) {
-      // (note: this isn't necessary if we don't create vertices for those with no edges)
-      // find which are actually active (first, those with outgoing edges)
-      forall(g, [](Vertex& v){ v.valid = (v.nadj > 0); });
-      // then those with only incoming edges (reachable from at least one active vertex)
-      forall(g, [](Edge& e, Vertex& ve){ ve.valid = true; });
-    }    
-    VLOG(1) << "-- vertices: " << g->nv;
+    t = walltime();
+    on_all_cores([]{
+      impl::graph_edges_in = alltoallv(impl::graph_edge_buckets);
+      std::vector<std::vector<GraphEdgePair>>().swap(impl::graph_edge_buckets);
+    });
+    graph_scatter_time = walltime() - t;
     
-    auto gsz = Vertex::global_heap_size()*g->nv
-                          + sizeof(Graph) * cores();
-    auto lsz = Vertex::locale_heap_size()*g->nv
-                          + (sizeof(VertexID)+sizeof(EdgeState))*g->nadj;
-    auto GB = [](size_t v){ return static_cast<double>(v) / (1L<<30); };
-    LOG(INFO) << "\nGraph memory breakdown:"
-              << "\n  locale_heap_size: " << GB(lsz) << " GB"
-              << "\n  global_heap_size: " << GB(gsz) << " GB"
-              << "\n  graph_total_size: " << GB(lsz+gsz) << " GB";
+    t = walltime();
+    on_all_cores([g]{
+  #ifdef SMALL_GRAPH
+      if (locale_mycore() == 0) locale_free(g->scratch);
+  #endif
+      auto& in = impl::graph_edges_in;
+      auto local = iterate_local(g->vs, g->nv);
+      Vertex * base = local.begin();
+      int64_t n = local.size();
+      auto index = [g,base](VertexID v){ return (g->vs+v).localize() - base; };
+      
+      // counting sort by source vertex
+      std::vector<int64_t> start(n+1, 0);
+      for (auto& e : in) start[index(e.v0)+1]++;
+      std::partial_sum(start.begin(), start.end(), start.begin());
+      std::vector<VertexID> csr(in.size());
+      {
+        std::vector<int64_t> pos(start.begin(), start.end()-1);
+        for (auto& e : in) csr[pos[index(e.v0)]++] = e.v1;
+      }
+      std::vector<GraphEdgePair>().swap(in);
+      
+      // sort & de-dup each vertex's run, compacting in place
+      int64_t tail = 0;
+      for (int64_t i = 0; i < n; i++) {
+        auto b = csr.begin() + start[i], e = csr.begin() + start[i+1];
+        std::sort(b, e);
+        auto first = tail;
+        for (auto it = b; it != e; ++it) {
+          if (tail == first || csr[tail-1] != *it) csr[tail++] = *it;
+        }
+        base[i].nadj = base[i].local_sz = tail - first;
+      }
+      
+      g->nadj_local = tail;
+      g->adj_buf = locale_alloc<VertexID>(g->nadj_local);
+      g->edge_storage = locale_alloc<EdgeState>(g->nadj_local);
+      Grappa::memcpy(g->adj_buf, csr.data(), g->nadj_local);
+      for (int64_t i=0; i<g->nadj_local; i++) {
+        new (g->edge_storage+i) EdgeState();
+      }
+      g->nadj = allreduce<int64_t,collective_add>(g->nadj_local);
+      
+      size_t offset = 0;
+      for (Vertex& v : local) {
+        v.local_adj = g->adj_buf + offset;
+        v.local_edge_state = g->edge_storage + offset;
+        offset += v.nadj;
+      }
+    });
+    graph_sort_time = walltime() - t;
+  }
+  
+  template< typename V, typename E >
+  GlobalAddress<Graph<V,E>> Graph<V,E>::partition(GlobalAddress<Graph> g, GraphPartition policy) {
+    using impl::GraphEdgePair;
+    double t = walltime();
+    
+    // choose a core for each vertex
+    switch (policy) {
+      case GraphPartition::Cyclic:
+      case GraphPartition::Hash:
+        on_all_cores([g,policy]{
+          auto& st = impl::graph_partition_state;
+          st.part.clear();
+          for (Vertex& v : iterate_local(g->vs, g->nv)) {
+            auto i = g->id(v);
+            st.part.push_back(policy == GraphPartition::Hash ? impl::graph_hash_core(i) : i % cores());
+          }
+        });
+        break;
+      case GraphPartition::Degree:
+        place_by_degree(g);
+        break;
+      default:
+        place_by_streaming(g, policy);
+    }
+    
+    // relabel: each core's part becomes a contiguous range of ids (keeping
+    // the old order within a core), then the adjacencies are renamed
+    on_all_cores([g]{
+      auto& st = impl::graph_partition_state;
+      std::vector<int64_t> offset(cores(), 0), totals(cores());
+      for (auto p : st.part) offset[p]++;
+      exclusive_scan_inplace<int64_t,collective_add>(offset.data(), cores(), totals.data());
+      int64_t most = std::max<int64_t>(*std::max_element(totals.begin(), totals.end()), 1);
+      st.block = Distribution::block().sized_for(most*cores(), sizeof(Vertex)).block_bytes()
+                 / sizeof(Vertex);
+      st.new_id.resize(st.part.size());
+      for (size_t j = 0; j < st.part.size(); j++) {
+        auto p = st.part[j];
+        st.new_id[j] = p * st.block + offset[p]++;
+      }
+      
+      // send each adjacency (v,u) to u's core, which knows u's new id
+      auto local = iterate_local(g->vs, g->nv);
+      Vertex * base = local.begin();
+      std::vector<std::vector<GraphEdgePair>> out(cores());
+      int64_t j = 0;
+      for (Vertex& v : local) {
+        auto vnew = st.new_id[j++];
+        g->for_each_adj(v, [g,&out,vnew](int64_t, VertexID u){
+          out[(g->vs+u).core()].push_back(GraphEdgePair{u, vnew});
+        });
+      }
+      auto in = alltoallv(out);
+      std::vector<std::vector<GraphEdgePair>>().swap(out);
+      
+      st.edges.resize(in.size());
+      for (size_t i = 0; i < in.size(); i++) {
+        auto u = (g->vs+in[i].v0).localize() - base;
+        st.edges[i] = GraphEdgePair{ in[i].v1, st.new_id[u] };
+      }
+    });
+    
+    int64_t block = impl::graph_partition_state.block;
+    auto gp = create_from(impl::RelabeledEdges(), true, false, block*cores(), Distribution::block());
+    
+    auto orig_id = global_alloc<VertexID>(gp->nv);
+    auto new_id = global_alloc<VertexID>(g->nv);
+    
+    // carry over validity and record the relabeling; padding vertices are
+    // invalid and have no original id
+    on_all_cores([g,gp,block,orig_id,new_id]{
+      auto& st = impl::graph_partition_state;
+      std::vector<GraphEdgePair>().swap(st.edges);
+      CHECK_EQ((gp->vs + block*mycore()).core(), mycore()) << "relabeled vertices not contiguous per core";
+      gp->nv_orig = g->nv_orig;
+      gp->orig_id = orig_id;
+      gp->new_id = new_id;
+      
+      struct Relabeled { VertexID i, orig; bool valid; };
+      std::vector<std::vector<Relabeled>> out(cores());
+      std::vector<std::vector<GraphEdgePair>> out_new(cores());
+      int64_t j = 0;
+      for (Vertex& v : iterate_local(g->vs, g->nv)) {
+        auto i = st.new_id[j++];
+        auto orig = g->id(v);
+        out[i / block].push_back(Relabeled{i, orig, v.valid});
+        out_new[(new_id+orig).core()].push_back(GraphEdgePair{orig, i});
+      }
+      for (Vertex& v : iterate_local(gp->vs, gp->nv)) v.valid = false;
+      for (auto& o : iterate_local(orig_id, gp->nv)) o = -1;
+      for (auto& e : alltoallv(out)) {
+        (gp->vs + e.i).localize()->valid = e.valid;
+        *(orig_id + e.i).localize() = e.orig;
+      }
+      for (auto& e : alltoallv(out_new)) *(new_id + e.v0).localize() = e.v1;
+      
+      std::vector<int32_t>().swap(st.part);
+      std::vector<VertexID>().swap(st.new_id);
+    });
+    graph_partition_time = walltime() - t;
+    VLOG(1) << "graph_partition_time: " << graph_partition_time;
+    gp->report_placement();
+    return gp;
+  }
+  
+  /// 1D partitioning: split the ids into ranges (about 1024 per core), weigh
+  /// each by its vertices' out-degree + 1, and give each core a run of
+  /// consecutive ranges of about equal total weight.
+  template< typename V, typename E >
+  void Graph<V,E>::place_by_degree(GlobalAddress<Graph> g) {
+    on_all_cores([g]{
+      auto local = iterate_local(g->vs, g->nv);
+      int64_t width = std::max<int64_t>(1, (g->nv + cores()*1024 - 1) / (cores()*1024));
+      int64_t nranges = (g->nv + width - 1) / width;
+      
+      // (reduced straight from the buffer, so it must be in the locale heap)
+      auto weight = locale_alloc<int64_t>(nranges);
+      std::fill(weight, weight+nranges, 0);
+      for (Vertex& v : local) weight[g->id(v) / width] += v.nadj + 1;
+      allreduce_inplace<int64_t,collective_add>(weight, nranges);
+      
+      int64_t total = std::accumulate(weight, weight+nranges, int64_t(0));
+      std::vector<int32_t> owner(nranges);
+      int64_t before = 0;
+      for (int64_t r = 0; r < nranges; r++) {
+        owner[r] = std::min<int64_t>(cores()-1, (before + weight[r]/2) * cores() / total);
+        before += weight[r];
+      }
+      locale_free(weight);
+      
+      auto& st = impl::graph_partition_state;
+      st.part.clear();
+      for (Vertex& v : local) st.part.push_back(owner[g->id(v) / width]);
+    });
+  }
+  
+  /// Streaming greedy partitioning (LDG or Fennel). Each core places its
+  /// vertices in `--graph_partition_rounds` slices; a vertex goes to the core
+  /// scoring best given where its neighbors already went. Between slices,
+  /// cores tell the owners of remote neighbors where their vertices went and
+  /// combine part sizes.
+  template< typename V, typename E >
+  void Graph<V,E>::place_by_streaming(GlobalAddress<Graph> g, GraphPartition policy) {
+    using impl::GraphEdgePair;
+    on_all_cores([g,policy]{
+      auto& st = impl::graph_partition_state;
+      auto local = iterate_local(g->vs, g->nv);
+      Vertex * base = local.begin();
+      int64_t n = local.size();
+      int64_t nc = cores();
+      
+      st.part.assign(n, -1);
+      // parts of remote neighbors, heard from their owners
+      std::vector<std::vector<int32_t>> heard(n);
+      // part sizes as of the last round, and this core's additions since
+      std::vector<int64_t> size(nc, 0), added(nc, 0);
+      std::vector<int64_t> hits(nc, 0);
+      std::vector<int32_t> touched;
+      auto added_all = locale_alloc<int64_t>(nc);
+      
+      // other cores are placing vertices too; assume as many as this one
+      auto load = [&](int32_t p) -> double { return size[p] + added[p]*nc; };
+      const double capacity = (1.0 + FLAGS_graph_partition_slack) * g->nv / nc;
+      const double gamma = 1.5;
+      const double alpha = std::sqrt(nc) * g->nadj / std::pow(std::max<int64_t>(g->nv, 1), gamma);
+      auto score = [&](int32_t p) -> double {
+        return policy == GraphPartition::LDG
+               ? hits[p] * (1.0 - load(p) / capacity)
+               : hits[p] - alpha * gamma * std::sqrt(load(p));
+      };
+      auto lightest = [&]() -> int32_t {
+        int32_t best = 0;
+        for (int32_t p = 1; p < nc; p++) if (load(p) < load(best)) best = p;
+        return best;
+      };
+      
+      int64_t rounds = std::max<int64_t>(FLAGS_graph_partition_rounds, 1);
+      for (int64_t r = 0; r < rounds; r++) {
+        int64_t lo = n*r/rounds, hi = n*(r+1)/rounds;
+        int32_t light = lightest();
+        
+        for (int64_t j = lo; j < hi; j++) {
+          auto tally = [&](int32_t p){ if (hits[p]++ == 0) touched.push_back(p); };
+          g->for_each_adj(base[j], [&](int64_t, VertexID u){
+            auto ua = g->vs+u;
+            if (ua.core() == mycore()) {
+              auto p = st.part[ua.localize() - base];
+              if (p >= 0) tally(p);
+            }
+          });
+          for (auto p : heard[j]) tally(p);
+          std::vector<int32_t>().swap(heard[j]);
+          
+          // the lightest part is the best of those with no neighbors
+          int32_t best = light;
+          double best_score = score(light);
+          for (auto p : touched) {
+            if (load(p) + nc > capacity) continue;
+            double s = score(p);
+            if (s > best_score || (s == best_score && load(p) < load(best))) {
+              best = p;
+              best_score = s;
+            }
+          }
+          for (auto p : touched) hits[p] = 0;
+          touched.clear();
+          
+          st.part[j] = best;
+          added[best]++;
+          if (best == light) light = lightest();
+        }
+        
+        std::vector<std::vector<GraphEdgePair>> out(nc);
+        for (int64_t j = lo; j < hi; j++) {
+          g->for_each_adj(base[j], [&](int64_t, VertexID u){
+            auto c = (g->vs+u).core();
+            if (c != mycore()) out[c].push_back(GraphEdgePair{u, st.part[j]});
+          });
+        }
+        for (auto& e : alltoallv(out)) {
+          auto i = (g->vs+e.v0).localize() - base;
+          if (st.part[i] < 0) heard[i].push_back(e.v1);
+        }
+        
+        std::copy(added.begin(), added.end(), added_all);
+        allreduce_inplace<int64_t,collective_add>(added_all, nc);
+        for (int64_t p = 0; p < nc; p++) {
+          size[p] += added_all[p];
+          added[p] = 0;
+        }
+      }
+      locale_free(added_all);
+    });
+  }
+  
+  template< typename V, typename E >
+  void Graph<V,E>::relabel_edges(TupleGraph& tg) {
+    if (!is_relabeled()) return;
+    auto new_id = this->new_id;
+    forall(tg.edges, tg.nedge, [new_id](TupleGraph::Edge& e){
+      e.v0 = delegate::read(new_id + e.v0);
+      e.v1 = delegate::read(new_id + e.v1);
+    });
+  }
+  
+  template< typename V, typename E >
+  void Graph<V,E>::report_placement() {
+    auto g = self;
+    int64_t cut = sum_all_cores([g]{
+      int64_t remote = 0;
+      for (Vertex& v : iterate_local(g->vs, g->nv)) {
+        g->for_each_adj(v, [g,&remote](int64_t, VertexID j){
+          if ((g->vs+j).core() != mycore()) remote++;
+        });
+      }
+      return remote;
+    });
+    int64_t most = reduce<int64_t,collective_max>(&g->nadj_local);
+    
+    graph_edge_cut = cut;
+    graph_remote_fraction = nadj > 0 ? static_cast<double>(cut) / nadj : 0.0;
+    graph_edge_imbalance = nadj > 0 ? static_cast<double>(most) * cores() / nadj : 1.0;
+    VLOG(1) << "Graph placement: " << cut << " of " << nadj << " adjacencies remote"
+              << " (fraction " << graph_remote_fraction.value() << ")"
+              << ", edge imbalance " << graph_edge_imbalance.value();
+  }
+  
+  template< typename V, typename E >
+  void Graph<V,E>::build_in_edges() {
+    using impl::GraphEdgePair;
+    CHECK(!has_in_edges()) << "in-edges already built";
+    double t = walltime();
+    auto g = self;
+    on_all_cores([g]{
+      auto local = iterate_local(g->vs, g->nv);
+      Vertex * base = local.begin();
+      int64_t n = local.size();
+      
+      // send each adjacency (i,j) to j's core
+      std::vector<std::vector<GraphEdgePair>> out(cores());
+      for (Vertex& v : local) {
+        auto i = g->id(v);
+        g->for_each_adj(v, [g,&out,i](int64_t, VertexID j){
+          out[(g->vs+j).core()].push_back(GraphEdgePair{j, i});
+        });
+      }
+      auto in = alltoallv(out);
+      std::vector<std::vector<GraphEdgePair>>().swap(out);
+      
+      // counting sort by destination vertex
+      g->in_offsets = locale_alloc<int64_t>(n+1);
+      std::fill(g->in_offsets, g->in_offsets+n+1, 0);
+      for (auto& e : in) g->in_offsets[(g->vs+e.v0).localize() - base + 1]++;
+      std::partial_sum(g->in_offsets, g->in_offsets+n+1, g->in_offsets);
+      
+      g->nin_local = in.size();
+      g->in_adj_buf = locale_alloc<VertexID>(g->nin_local);
+      std::vector<int64_t> pos(g->in_offsets, g->in_offsets+n);
+      for (auto& e : in) g->in_adj_buf[pos[(g->vs+e.v0).localize() - base]++] = e.v1;
+      for (int64_t k = 0; k < n; k++) {
+        std::sort(g->in_adj_buf + g->in_offsets[k], g->in_adj_buf + g->in_offsets[k+1]);
+      }
+    });
+    graph_in_edges_time = walltime() - t;
+    VLOG(1) << "graph_in_edges_time: " << graph_in_edges_time;
+  }
+  
+  template< typename V, typename E >
+  void Graph<V,E>::insert_edges(const TupleGraph& batch, bool directed) {
+    update_edges(impl::TupleGraphEdges{batch}, true, directed);
+  }
+  
+  template< typename V, typename E >
+  void Graph<V,E>::delete_edges(const TupleGraph& batch, bool directed) {
+    update_edges(impl::TupleGraphEdges{batch}, false, directed);
+  }
+  
+  template< typename V, typename E >
+  template< typename EdgeSource >
+  void Graph<V,E>::update_edges(EdgeSource edges, bool insert, bool directed) {
+    static_assert(std::is_trivially_copyable<E>::value, "edge state is moved as raw bytes by edge updates");
+    using impl::GraphEdgePair;
+    CHECK(!compressed) << "can't update a compressed graph";
+    double t = walltime();
+    auto g = self;
+    
+    // an edge goes to its source's core; for directed edges the destination
+    // just gets a note (-1) that it was touched
+    on_all_cores([]{ impl::graph_edge_buckets.resize(cores()); });
+    edges.forall_edges([g,directed](int64_t v0, int64_t v1){
+      CHECK_LT(v0, g->nv) << "edge updates can't add vertices";
+      CHECK_LT(v1, g->nv) << "edge updates can't add vertices";
+      auto& out = impl::graph_edge_buckets;
+      out[(g->vs+v0).core()].push_back(GraphEdgePair{v0, v1});
+      out[(g->vs+v1).core()].push_back(GraphEdgePair{v1, directed ? -1 : v0});
+    });
+    
+    on_all_cores([g,insert]{
+      auto in = alltoallv(impl::graph_edge_buckets);
+      std::vector<std::vector<GraphEdgePair>>().swap(impl::graph_edge_buckets);
+      
+      auto local = iterate_local(g->vs, g->nv);
+      Vertex * base = local.begin();
+      if (!g->updates) g->updates = new impl::GraphUpdateLog(local.size(), g->nadj_local);
+      auto& log = *g->updates;
+      
+      for (auto& e : in) {
+        auto k = (g->vs+e.v0).localize() - base;
+        auto& v = base[k];
+        log.touched.push_back(k);
+        if (insert) v.valid = true;
+        if (e.v1 < 0) continue;
+        if (insert) g->insert_local(v, e.v1);
+        else g->delete_local(v, e.v1);
+      }
+      std::sort(log.touched.begin(), log.touched.end());
+      log.touched.erase(std::unique(log.touched.begin(), log.touched.end()), log.touched.end());
+      
+      if (log.moved_size > FLAGS_graph_compact_fraction * g->nadj_local) g->compact_local();
+      g->nadj = allreduce<int64_t,collective_add>(g->nadj_local);
+    });
+    
+    if (has_in_edges()) {
+      call_on_all_cores([g]{
+        locale_free(g->in_offsets);
+        locale_free(g->in_adj_buf);
+        g->in_offsets = nullptr;
+        g->in_adj_buf = nullptr;
+      });
+      build_in_edges();
+    }
+    graph_update_time = walltime() - t;
+    VLOG(1) << "graph_update_time: " << graph_update_time;
+  }
+  
+  template< typename V, typename E >
+  void Graph<V,E>::insert_local(Vertex& v, VertexID j) {
+    auto pos = std::lower_bound(v.local_adj, v.local_adj + v.nadj, j) - v.local_adj;
+    if (pos < v.nadj && v.local_adj[pos] == j) return;
+    
+    if (v.nadj == v.local_sz) {
+      // out of slack: move to an array of twice the size
+      int64_t sz = std::max<int64_t>(2*v.nadj, 4);
+      auto adj = locale_alloc<VertexID>(sz);
+      auto state = locale_alloc<EdgeState>(sz);
+      ::memcpy(adj, v.local_adj, sizeof(VertexID)*v.nadj);
+      ::memcpy(state, v.local_edge_state, sizeof(EdgeState)*v.nadj);
+      auto k = &v - vs.localize();
+      if (updates->moved[k]) {
+        locale_free(v.local_adj);
+        locale_free(v.local_edge_state);
+        updates->moved_size -= v.local_sz;
+      }
+      updates->moved[k] = true;
+      updates->moved_size += sz;
+      v.local_adj = adj;
+      v.local_edge_state = state;
+      v.local_sz = sz;
+    }
+    
+    ::memmove(v.local_adj+pos+1, v.local_adj+pos, sizeof(VertexID)*(v.nadj-pos));
+    ::memmove(v.local_edge_state+pos+1, v.local_edge_state+pos, sizeof(EdgeState)*(v.nadj-pos));
+    v.local_adj[pos] = j;
+    new (v.local_edge_state+pos) EdgeState();
+    v.nadj++;
+    nadj_local++;
+  }
+  
+  template< typename V, typename E >
+  void Graph<V,E>::delete_local(Vertex& v, VertexID j) {
+    auto pos = std::lower_bound(v.local_adj, v.local_adj + v.nadj, j) - v.local_adj;
+    if (pos == v.nadj || v.local_adj[pos] != j) return;
+    ::memmove(v.local_adj+pos, v.local_adj+pos+1, sizeof(VertexID)*(v.nadj-pos-1));
+    ::memmove(v.local_edge_state+pos, v.local_edge_state+pos+1, sizeof(EdgeState)*(v.nadj-pos-1));
+    v.nadj--;
+    nadj_local--;
+  }
+  
+  template< typename V, typename E >
+  void Graph<V,E>::compact_local() {
+    auto& log = *updates;
+    auto adj = locale_alloc<VertexID>(nadj_local);
+    auto state = locale_alloc<EdgeState>(nadj_local);
+    int64_t offset = 0, k = 0;
+    for (Vertex& v : iterate_local(vs, nv)) {
+      ::memcpy(adj + offset, v.local_adj, sizeof(VertexID)*v.nadj);
+      ::memcpy(state + offset, v.local_edge_state, sizeof(EdgeState)*v.nadj);
+      if (log.moved[k]) {
+        locale_free(v.local_adj);
+        locale_free(v.local_edge_state);
+        log.moved[k] = false;
+      }
+      v.local_adj = adj + offset;
+      v.local_edge_state = state + offset;
+      v.local_sz = v.nadj;
+      offset += v.nadj;
+      k++;
+    }
+    CHECK_EQ(offset, nadj_local);
+    if (adj_buf) locale_free(adj_buf);
+    if (edge_storage) locale_free(edge_storage);
+    adj_buf = adj;
+    edge_storage = state;
+    log.moved_size = 0;
+    log.buf_size = nadj_local;
+    graph_compactions++;
+  }
+  
+  template< typename V, typename E >
+  void Graph<V,E>::compact() {
+    auto g = self;
+    call_on_all_cores([g]{ if (g->updates) g->compact_local(); });
+  }
+  
+  template< typename V, typename E >
+  template< typename F >
+  void Graph<V,E>::forall_updated(F f) {
+    auto g = self;
+    impl::forall_local([g]{
+      return g->updates ? static_cast<int64_t>(g->updates->touched.size()) : int64_t(0);
+    }, [g,f](int64_t s, int64_t n){
+      auto base = g->vs.localize();
+      for (int64_t i = s; i < s+n; i++) f(base[g->updates->touched[i]]);
+    });
+  }
+  
+  template< typename V, typename E >
+  void Graph<V,E>::clear_updated() {
+    auto g = self;
+    call_on_all_cores([g]{ if (g->updates) g->updates->touched.clear(); });
+  }
+  
+  template< typename V, typename E >
+  void Graph<V,E>::compress() {
+    CHECK(!compressed) << "already compressed";
+    auto g = self;
+    on_all_cores([g]{
+      if (g->updates) g->compact_local();
+      auto local = iterate_local(g->vs, g->nv);
+      size_t bytes = 0;
+      for (Vertex& v : local) bytes += impl::encoded_adj_size(v.local_adj, v.nadj);
+      
+      g->cadj_buf = locale_alloc<uint8_t>(std::max<size_t>(bytes, 1));
+      g->cadj_bytes = bytes;
+      auto p = g->cadj_buf;
+      for (Vertex& v : local) {
+        auto end = impl::encode_adj(v.local_adj, v.nadj, p);
+        v.local_cadj = p;
+        v.local_sz = end - p;
+        p = end;
+      }
+      CHECK_EQ(p - g->cadj_buf, bytes);
+      
+      if (g->adj_buf) locale_free(g->adj_buf);
+      g->adj_buf = nullptr;
+      g->compressed = true;
+    });
+    VLOG(1) << "compressed adjacencies: " << sum_all_cores([g]{ return g->cadj_bytes; })
+            << " bytes, from " << sizeof(VertexID) * nadj;
+  }
+  
+  template< typename V, typename E >
+  void Graph<V,E>::save(std::string path) {
+    using namespace impl;
+    CHECK_LT(path.size(), graph_file_max_path) << "path too long";
+    char fname[graph_file_max_path];
+    strncpy(fname, path.c_str(), graph_file_max_path);
+    
+    double t = walltime();
+    close(graph_file_open(fname, O_WRONLY | O_CREAT | O_TRUNC));
+    
+    auto g = self;
+    on_all_cores([g,fname]{
+      const size_t edge_bytes = std::is_same<E,Empty>::value ? 0 : sizeof(E);
+      auto local = iterate_local(g->vs, g->nv);
+      
+      GraphFileSegment seg;
+      seg.nv_local = local.size();
+      seg.first = seg.nv_local > 0 ? g->id(*local.begin()) : -1;
+      seg.stride = seg.nv_local > 1 ? g->id(*(local.begin()+1)) - seg.first : 1;
+      seg.nadj_local = 0;
+      int64_t j = 0;
+      for (Vertex& v : local) {
+        seg.nadj_local += v.nadj;
+        CHECK_EQ(g->id(v), seg.first + j*seg.stride) << "local vertex ids not evenly spaced";
+        j++;
+      }
+      
+      seg.offset = graph_file_data_offset(cores())
+                   + exclusive_scan<int64_t,collective_add>(seg.bytes(edge_bytes));
+      
+      // gather (adjacencies need not be contiguous in adj_buf)
+      std::vector<int64_t> degree(seg.nv_local);
+      std::vector<uint8_t> valid(seg.nv_local);
+      std::vector<VertexID> adj(seg.nadj_local);
+      std::vector<char> edges(edge_bytes * seg.nadj_local);
+      int64_t k = 0;
+      j = 0;
+      for (Vertex& v : local) {
+        degree[j] = v.nadj;
+        valid[j] = v.valid;
+        g->for_each_adj(v, [&adj,k](int64_t i, VertexID j){ adj[k+i] = j; });
+        if (edge_bytes) ::memcpy(&edges[k*edge_bytes], v.local_edge_state, v.nadj*edge_bytes);
+        j++; k += v.nadj;
+      }
+      
+      int fd = graph_file_open(fname, O_WRONLY);
+      graph_file_write(fd, &seg, sizeof(seg), sizeof(GraphFileHeader) + mycore()*sizeof(seg));
+      graph_file_write(fd, degree.data(), sizeof(int64_t)*seg.nv_local, seg.offset);
+      graph_file_write(fd, valid.data(), seg.nv_local, seg.valid_offset());
+      graph_file_write(fd, adj.data(), sizeof(VertexID)*seg.nadj_local, seg.adj_offset());
+      graph_file_write(fd, edges.data(), edges.size(), seg.edge_offset());
+      
+      if (mycore() == 0) {
+        GraphFileHeader h;
+        ::memset(&h, 0, sizeof(h));
+        ::memcpy(h.magic, "GRPGRAPH", sizeof(h.magic));
+        h.version = graph_file_version;
+        h.nv = g->nv;
+        h.nadj = g->nadj;
+        h.ncores = cores();
+        h.edge_bytes = edge_bytes;
+        h.dist_bits = g->vs.distribution().bits();
+        h.nv_orig = g->nv_orig != g->nv ? g->nv_orig : 0;
+        graph_file_write(fd, &h, sizeof(h), 0);
+      }
+      close(fd);
+    });
+    VLOG(1) << "graph_save_time: " << walltime() - t;
+  }
+  
+  template< typename V, typename E >
+  GlobalAddress<Graph<V,E>> Graph<V,E>::load(std::string path) {
+    using namespace impl;
+    CHECK_LT(path.size(), graph_file_max_path) << "path too long";
+    
+    double t = walltime();
+    auto h = graph_file_header(path.c_str());
+    const int64_t edge_bytes = std::is_same<E,Empty>::value ? 0 : sizeof(E);
+    CHECK_EQ(h.edge_bytes, edge_bytes) << "edge state in " << path << " doesn't match this Graph type";
+    
+    if (h.ncores != cores()) {
+      LOG(WARNING) << path << " was saved from " << h.ncores << " cores, rebuilding with create()";
+      GraphFileEdges edges;
+      strncpy(edges.path, path.c_str(), graph_file_max_path);
+      edges.ncores = h.ncores;
+      auto g = create_from(edges, true, false, h.nv, Distribution::from_bits(h.dist_bits));
+      
+      // restore the saved validity: each core reads the same segments as
+      // for the edges and sends each flag to its vertex's core
+      int64_t ncores = h.ncores, nv_orig = h.nv_orig ? h.nv_orig : h.nv;
+      char fname[graph_file_max_path];
+      strncpy(fname, path.c_str(), graph_file_max_path);
+      on_all_cores([g,ncores,nv_orig,fname]{
+        g->nv_orig = nv_orig;
+        std::vector<std::vector<GraphEdgePair>> out(cores());
+        int fd = graph_file_open(fname, O_RDONLY);
+        for (int64_t p = mycore(); p < ncores; p += cores()) {
+          GraphFileSegment seg;
+          graph_file_read(fd, &seg, sizeof(seg), sizeof(GraphFileHeader) + p*sizeof(seg));
+          std::vector<uint8_t> valid(seg.nv_local);
+          graph_file_read(fd, valid.data(), seg.nv_local, seg.valid_offset());
+          for (int64_t j = 0; j < seg.nv_local; j++) {
+            VertexID v = seg.first + j*seg.stride;
+            out[(g->vs+v).core()].push_back(GraphEdgePair{v, valid[j]});
+          }
+        }
+        close(fd);
+        for (auto& e : alltoallv(out)) (g->vs + e.v0).localize()->valid = e.v1;
+      });
+      return g;
+    }
+    
+    char fname[graph_file_max_path];
+    strncpy(fname, path.c_str(), graph_file_max_path);
+    auto g = symmetric_global_alloc<Graph>();
+    auto vs = global_alloc<Vertex>(h.nv, Distribution::from_bits(h.dist_bits));
+    int64_t nv = h.nv, nadj = h.nadj;
+    int64_t nv_orig = h.nv_orig ? h.nv_orig : h.nv;
+    
+    on_all_cores([g,vs,nv,nv_orig,nadj,fname]{
+      new (g.localize()) Graph(g, vs, nv);
+      g->nv_orig = nv_orig;
+      auto local = iterate_local(g->vs, g->nv);
+      
+      // find the segment holding this core's vertices (the same core as at
+      // save time, unless vertex 0 landed on a different core)
+      int fd = graph_file_open(fname, O_RDONLY);
+      std::vector<GraphFileSegment> table(cores());
+      graph_file_read(fd, table.data(), sizeof(GraphFileSegment)*cores(), sizeof(GraphFileHeader));
+      GraphFileSegment seg = {-1, 1, 0, 0, 0};
+      if (local.size() > 0) {
+        auto first = g->id(*local.begin());
+        auto it = std::find_if(table.begin(), table.end(),
+                               [first](const GraphFileSegment& s){ return s.first == first; });
+        CHECK(it != table.end()) << "no segment for vertex " << first << " in " << fname;
+        seg = *it;
+      }
+      CHECK_EQ(seg.nv_local, local.size());
+      
+      std::vector<int64_t> degree(seg.nv_local);
+      std::vector<uint8_t> valid(seg.nv_local);
+      graph_file_read(fd, degree.data(), sizeof(int64_t)*seg.nv_local, seg.offset);
+      graph_file_read(fd, valid.data(), seg.nv_local, seg.valid_offset());
+      
+      // adjacencies and edge state go directly into their final storage
+      g->nadj = nadj;
+      g->nadj_local = seg.nadj_local;
+      g->adj_buf = locale_alloc<VertexID>(seg.nadj_local);
+      g->edge_storage = locale_alloc<EdgeState>(seg.nadj_local);
+      graph_file_read(fd, g->adj_buf, sizeof(VertexID)*seg.nadj_local, seg.adj_offset());
+      if (std::is_same<E,Empty>::value) {
+        for (int64_t i = 0; i < seg.nadj_local; i++) new (g->edge_storage+i) EdgeState();
+      } else {
+        graph_file_read(fd, g->edge_storage, sizeof(EdgeState)*seg.nadj_local, seg.edge_offset());
+      }
+      close(fd);
+      
+      int64_t j = 0, offset = 0;
+      for (Vertex& v : local) {
+        new (&v) Vertex();
+        v.nadj = v.local_sz = degree[j];
+        v.valid = valid[j];
+        v.local_adj = g->adj_buf + offset;
+        v.local_edge_state = g->edge_storage + offset;
+        offset += degree[j];
+        j++;
+      }
+      CHECK_EQ(offset, seg.nadj_local);
+    });
+    VLOG(1) << "graph_load_time: " << walltime() - t;
+    if (FLAGS_graph_in_edges) g->build_in_edges();
     return g;
   }
   
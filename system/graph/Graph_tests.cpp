@@ -25,6 +25,10 @@
 #include <Grappa.hpp>
 #include <graph/Graph.hpp>
 #include <GlobalVector.hpp>
+#include <boost/filesystem.hpp>
+#include <fstream>
+
+namespace fs = boost::filesystem;
 
 BOOST_AUTO_TEST_SUITE( Graph_tests );
 
@@ -50,6 +54,27 @@ DEFINE_int32(scale, 10, "Log2 number of vertices.");
 GRAPPA_DEFINE_METRIC(SummarizingMetric<int64_t>, degree, 0);
 GRAPPA_DEFINE_METRIC(SummarizingMetric<double>, edge_weight, 0);
 
+/// Check that every vertex of `g1` has the same validity and adjacency list
+/// (in order) as in `g2`. `g1` may be compressed; `g2` must not be.
+void check_same_adjacency(GlobalAddress<MyGraph> g1, GlobalAddress<MyGraph> g2) {
+  BOOST_CHECK_EQUAL(g1->nv, g2->nv);
+  BOOST_CHECK_EQUAL(g1->nadj, g2->nadj);
+  forall(g1, [g1,g2](VertexID i, MyGraph::Vertex& v){
+    struct Adj { int64_t nadj; bool valid; };
+    auto u = delegate::call(g2->vs+i, [](MyGraph::Vertex& u){ return Adj{u.nadj, u.valid}; });
+    CHECK_EQ(u.valid, v.valid);
+    CHECK_EQ(u.nadj, v.nadj);
+    g1->for_each_adj(v, [g2,i](int64_t k, VertexID j){
+      CHECK_EQ(delegate::call(g2->vs+i, [k](MyGraph::Vertex& u){ return u.local_adj[k]; }), j);
+    });
+  });
+}
+
+/// A fresh path in the temp directory, so concurrent runs don't collide.
+std::string temp_path(const std::string& suffix) {
+  return (fs::temp_directory_path() / fs::unique_path("graph_tests_%%%%-%%%%-%%%%" + suffix)).string();
+}
+
 BOOST_AUTO_TEST_CASE( test1 ) {
   init( GRAPPA_TEST_ARGS );
   run([]{
@@ -165,6 +190,353 @@ BOOST_AUTO_TEST_CASE( test1 ) {
       count += (total > 0);
     });
     
+    ////////////////////////////////////////////////////////////
+    // all-to-all and delegate construction give the same graph
+    {
+      call_on_all_cores([]{ FLAGS_graph_create_alltoall = false; });
+      auto gd = MyGraph::create(tg);
+      call_on_all_cores([]{ FLAGS_graph_create_alltoall = true; });
+      check_same_adjacency(gd, g);
+      gd->destroy();
+    }
+    
+    ///////////////////////////////////////////////////
+    // build from mapped bintsv4 edges, compare adjacencies
+    {
+      std::string path = temp_path(".bintsv4");
+      tg.save(path, "bintsv4");
+      auto mtg = MappedTupleGraph::Map(path);
+      BOOST_CHECK_EQUAL(mtg->nedge, tg.nedge);
+      
+      auto gm = MyGraph::create(mtg);
+      check_same_adjacency(gm, g);
+      
+      gm->destroy();
+      mtg->destroy();
+      unlink(path.c_str());
+    }
+    
+    ///////////////////////////////////////////////
+    // save/load binary graph, compare adjacencies
+    {
+      std::string path = temp_path(".grappa_graph");
+      forall(g, [](MyGraph::Vertex& v, MyGraph::Edge& e){ e->weight = 0.5 * e.id; });
+      g->save(path);
+      
+      auto gl = MyGraph::load(path);
+      check_same_adjacency(gl, g);
+      forall(gl, [](MyGraph::Vertex& v, MyGraph::Edge& e){
+        CHECK_EQ(e->weight, 0.5 * e.id);
+      });
+      
+      gl->destroy();
+      unlink(path.c_str());
+    }
+    
+    ////////////////////////////////////////////////////////////////////
+    // a file from a different number of cores is rebuilt, keeping nv
+    // (an isolated last vertex) and the saved validity
+    {
+      std::string path = temp_path(".grappa_graph");
+      auto gi = MyGraph::create_from(impl::TupleGraphEdges{tg}, false, true, g->nv + 1);
+      // (vertices left without edges by delete_edges stay valid)
+      delegate::call(gi->vs + g->nv, [](MyGraph::Vertex& v){ v.valid = true; });
+      gi->save(path);
+      
+      // pretend there was one more core, which had no vertices
+      auto h = impl::graph_file_header(path.c_str());
+      BOOST_REQUIRE_LE(sizeof(h) + (h.ncores+1)*sizeof(impl::GraphFileSegment),
+                       impl::graph_file_data_offset(h.ncores));
+      impl::GraphFileSegment empty = {-1, 1, 0, 0, 0};
+      int fd = impl::graph_file_open(path.c_str(), O_WRONLY);
+      impl::graph_file_write(fd, &empty, sizeof(empty), sizeof(h) + h.ncores*sizeof(empty));
+      h.ncores++;
+      impl::graph_file_write(fd, &h, sizeof(h), 0);
+      close(fd);
+      
+      auto gl = MyGraph::load(path);
+      BOOST_CHECK(gl->vs.distribution() == gi->vs.distribution());
+      check_same_adjacency(gl, gi);
+      BOOST_CHECK(delegate::call(gl->vs + g->nv, [](MyGraph::Vertex& v){ return v.valid; }));
+      
+      gl->destroy();
+      gi->destroy();
+      unlink(path.c_str());
+    }
+    
+    //////////////////////////////////////////////////////////////
+    // compressed adjacencies: same edges, plus memory & traversal
+    {
+      auto gc = MyGraph::create(tg);
+      auto traverse = [](GlobalAddress<MyGraph> g){
+        call_on_all_cores([]{ count = 0; });
+        double t = walltime();
+        forall(g, [](MyGraph::Vertex& v, MyGraph::Edge& e){ count += e.id; });
+        t = walltime() - t;
+        return std::make_pair(reduce<int64_t,collective_add>(&count), t);
+      };
+      auto raw = traverse(gc);
+      gc->compress();
+      auto packed = traverse(gc);
+      BOOST_CHECK_EQUAL(packed.first, raw.first);
+      
+      // same order, through both decoders
+      check_same_adjacency(gc, g);
+      forall(gc, [gc](MyGraph::Vertex& v){
+        int64_t n = 0;
+        serial_for(adj(gc,v), [&n](MyGraph::Edge& e){ n++; });
+        CHECK_EQ(n, v.nadj);
+      });
+      
+      auto bytes = sum_all_cores([gc]{ return gc->cadj_bytes; });
+      LOG(INFO) << "compressed adjacencies: " << static_cast<double>(bytes) / gc->nadj
+                << " bytes/edge (vs " << sizeof(VertexID) << "), traversal "
+                << gc->nadj / raw.second << " -> " << gc->nadj / packed.second << " edges/s";
+      gc->destroy();
+    }
+    
+    /////////////////////////////////////////////////////////////////////
+    // edge updates: build from half the edges, insert the rest, compare
+    {
+      TupleGraph first, rest;
+      first.edges = tg.edges;
+      first.nedge = tg.nedge / 2;
+      rest.edges = tg.edges + first.nedge;
+      rest.nedge = tg.nedge - first.nedge;
+      
+      auto gu = MyGraph::create_from(impl::TupleGraphEdges{first}, false, true, g->nv);
+      forall(gu, [](MyGraph::Vertex& v){ v->parent = 0; });
+      gu->insert_edges(rest);
+      check_same_adjacency(gu, g);
+      
+      // endpoints of the batch are what forall_updated() visits
+      gu->forall_updated([](MyGraph::Vertex& v){ v->parent = 1; });
+      forall(rest.edges, rest.nedge, [gu](TupleGraph::Edge& e){
+        for (auto j : {e.v0, e.v1}) {
+          CHECK_EQ(delegate::call(gu->vs+j, [](MyGraph::Vertex& v){ return v->parent; }), 1);
+        }
+      });
+      
+      gu->compact();
+      check_same_adjacency(gu, g);
+      
+      // re-inserting is a no-op; deleting removes both directions
+      gu->clear_updated();
+      gu->insert_edges(rest);
+      check_same_adjacency(gu, g);
+      gu->delete_edges(rest);
+      forall(rest.edges, rest.nedge, [gu](TupleGraph::Edge& e){
+        for (auto p : { std::make_pair(e.v0, e.v1), std::make_pair(e.v1, e.v0) }) {
+          auto j = p.second;
+          CHECK(!delegate::call(gu->vs+p.first, [j](MyGraph::Vertex& v){
+            return std::binary_search(v.local_adj, v.local_adj + v.nadj, j);
+          })) << p.first << " -> " << j << " not deleted";
+        }
+      });
+      total = sum_all_cores([gu]{
+        int64_t n = 0;
+        for (auto& v : iterate_local(gu->vs, gu->nv)) n += v.nadj;
+        return n;
+      });
+      BOOST_CHECK_EQUAL(total, gu->nadj);
+      
+      gu->insert_edges(rest);
+      check_same_adjacency(gu, g);
+      LOG(INFO) << "edge updates: " << rest.nedge / graph_update_time << " edges/s";
+      gu->destroy();
+    }
+    
+    ////////////////////////////////////////////////////////////////
+    // in-edge index: transposes the adjacencies of a directed graph
+    {
+      auto gdir = MyGraph::create(tg, /*directed=*/true);
+      gdir->build_in_edges();
+      
+      call_on_all_cores([]{ count = 0; });
+      forall(gdir, [gdir](MyGraph::Vertex& v){
+        auto n = gdir->in_degree(v);
+        forall<async>(in_adj(gdir,v), [n](int64_t i, MyGraph::InEdge& e){
+          CHECK_LT(i, n);
+          count++;
+        });
+      });
+      total = reduce<int64_t,collective_add>(&count);
+      BOOST_CHECK_EQUAL(total, gdir->nadj);
+      
+      // every in-edge (j -> i) is an out-edge of j
+      forall(gdir, [gdir](VertexID i, MyGraph::Vertex& v){
+        serial_for(in_adj(gdir,v), [i](MyGraph::InEdge& e){
+          CHECK(delegate::call(e.ga, [i](MyGraph::Vertex& u){
+            return std::binary_search(u.local_adj, u.local_adj + u.nadj, i);
+          })) << e.id << " -> " << i << " missing";
+        });
+      });
+      gdir->destroy();
+      
+      // undirected: in-edges are the adjacencies
+      call_on_all_cores([]{ FLAGS_graph_in_edges = true; });
+      auto gu = MyGraph::create(tg);
+      call_on_all_cores([]{ FLAGS_graph_in_edges = false; });
+      BOOST_CHECK(gu->has_in_edges());
+      forall(gu, [gu](MyGraph::Vertex& v){
+        CHECK_EQ(gu->in_degree(v), v.nadj);
+        auto in = gu->local_in_adj(v);
+        CHECK(std::equal(v.local_adj, v.local_adj + v.nadj, in));
+      });
+      gu->destroy();
+    }
+    
+    //////////////////////////////////////////////////////////////////
+    // partitioners: same graph up to relabeling, contiguous local ids
+    {
+      auto signature = [](GlobalAddress<MyGraph> g){
+        struct Sig { int64_t valid, nadj2, deg2; } s = {0, 0, 0};
+        s.valid = sum_all_cores([g]{
+          int64_t n = 0;
+          for (auto& v : iterate_local(g->vs, g->nv)) n += v.valid;
+          return n;
+        });
+        call_on_all_cores([]{ count = 0; });
+        forall(g, [](MyGraph::Vertex& v){ count += v.nadj * v.nadj; });
+        s.nadj2 = reduce<int64_t,collective_add>(&count);
+        // sum over edges of the product of endpoint degrees
+        call_on_all_cores([]{ count = 0; });
+        forall(g, [](MyGraph::Vertex& v, MyGraph::Edge& e){
+          count += v.nadj * delegate::call(e.ga, [](MyGraph::Vertex& u){ return u.nadj; });
+        });
+        s.deg2 = reduce<int64_t,collective_add>(&count);
+        return s;
+      };
+      auto expected = signature(g);
+      g->report_placement();
+      LOG(INFO) << "placement (cyclic): remote fraction " << graph_remote_fraction.value()
+                << ", edge imbalance " << graph_edge_imbalance.value();
+      
+      for (auto policy : { GraphPartition::Hash, GraphPartition::Degree,
+                           GraphPartition::LDG, GraphPartition::Fennel }) {
+        auto gp = MyGraph::partition(g, policy);
+        LOG(INFO) << "placement (" << policy << "): remote fraction " << graph_remote_fraction.value()
+                  << ", edge imbalance " << graph_edge_imbalance.value()
+                  << ", " << gp->nv << " vertex slots for " << g->nv;
+        BOOST_CHECK_GE(graph_edge_cut.value(), 0);  // measured, whatever the log level
+        
+        BOOST_CHECK_EQUAL(gp->nadj, g->nadj);
+        auto s = signature(gp);
+        BOOST_CHECK_EQUAL(s.valid, expected.valid);
+        BOOST_CHECK_EQUAL(s.nadj2, expected.nadj2);
+        BOOST_CHECK_EQUAL(s.deg2, expected.deg2);
+        
+        int64_t block = gp->vs.block_bytes() / sizeof(MyGraph::Vertex);
+        forall(gp, [block](VertexID i, MyGraph::Vertex& v){ CHECK_EQ(i / block, mycore()); });
+        
+        // the relabeling is kept, and maps vertices to ones of the same degree
+        BOOST_CHECK(gp->is_relabeled());
+        BOOST_CHECK_EQUAL(gp->nv_orig, g->nv);
+        BOOST_CHECK_EQUAL(gp->renamed(0), delegate::read(gp->new_id));
+        forall(g, [gp](VertexID i, MyGraph::Vertex& v){
+          auto j = delegate::read(gp->new_id + i);
+          CHECK_EQ(delegate::read(gp->orig_id + j), i);
+          CHECK_EQ(delegate::call(gp->vs + j, [](MyGraph::Vertex& u){ return u.nadj; }), v.nadj);
+        });
+        
+        if (policy == GraphPartition::Degree) {
+          // edges in original ids can be renamed for the partitioned graph
+          TupleGraph tr;
+          tr.edges = global_alloc<TupleGraph::Edge>(tg.nedge);
+          tr.nedge = tg.nedge;
+          Grappa::memcpy(tr.edges, tg.edges, tg.nedge);
+          gp->relabel_edges(tr);
+          auto orig = tg.edges;
+          auto new_id = gp->new_id;
+          forall(tr.edges, tr.nedge, [orig,new_id](int64_t i, TupleGraph::Edge& e){
+            auto o = delegate::read(orig + i);
+            CHECK_EQ(e.v0, delegate::read(new_id + o.v0));
+            CHECK_EQ(e.v1, delegate::read(new_id + o.v1));
+          });
+          tr.destroy();
+        }
+        
+        if (policy == GraphPartition::LDG) {
+          // save/load keeps the partitioned layout
+          std::string path = temp_path(".grappa_graph");
+          gp->save(path);
+          auto gl = MyGraph::load(path);
+          BOOST_CHECK(gl->vs.distribution() == gp->vs.distribution());
+          check_same_adjacency(gl, gp);
+          gl->destroy();
+          unlink(path.c_str());
+        }
+        gp->destroy();
+      }
+      
+      // the flag picks partition()'s default policy, but create() never
+      // relabels
+      call_on_all_cores([]{ FLAGS_graph_partition = "degree"; });
+      auto gc = MyGraph::create(tg);
+      BOOST_CHECK(!gc->is_relabeled());
+      BOOST_CHECK_EQUAL(gc->nv, g->nv);
+      gc->destroy();
+      auto gd = MyGraph::partition(g);
+      call_on_all_cores([]{ FLAGS_graph_partition = "cyclic"; });
+      BOOST_CHECK(gd->vs.distribution().policy() == Distribution::Policy::Block);
+      BOOST_CHECK(gd->is_relabeled());
+      BOOST_CHECK_EQUAL(signature(gd).deg2, expected.deg2);
+      gd->destroy();
+    }
+    
+    ///////////////////////////////////////////////////////////
+    // TSV parsers agree; time the chunked scanner vs istreams
+    {
+      std::string path = temp_path(".tsv");
+      tg.save(path, "tsv");
+      double mb = static_cast<double>(fs::file_size(path)) / (1L<<20);
+      
+      auto checksum = [](TupleGraph& t){
+        call_on_all_cores([]{ count = 0; });
+        forall(t.edges, t.nedge, [](TupleGraph::Edge& e){ count += e.v0 * 1000003 + e.v1; });
+        return reduce<int64_t,collective_add>(&count);
+      };
+      auto expected = checksum(tg);
+      
+      for (bool fast : {true, false}) {
+        call_on_all_cores([fast]{ FLAGS_tsv_fast_parse = fast; });
+        double t = walltime();
+        auto tl = TupleGraph::Load(path, "tsv");
+        t = walltime() - t;
+        BOOST_CHECK_EQUAL(tl.nedge, tg.nedge);
+        BOOST_CHECK_EQUAL(checksum(tl), expected);
+        LOG(INFO) << "load_tsv (" << (fast ? "scanner" : "istream") << "): "
+                  << mb / t << " MB/s, " << tl.nedge / t << " edges/s";
+        tl.destroy();
+      }
+      call_on_all_cores([]{ FLAGS_tsv_fast_parse = true; });
+      unlink(path.c_str());
+    }
+    
+    //////////////////////////////////////////////////////////////
+    // MatrixMarket: skips the header and size line, keeps weights
+    {
+      std::string path = temp_path(".mm");
+      const int64_t n = 1000;
+      {
+        std::ofstream out(path);
+        out << "%%MatrixMarket matrix coordinate real general\n"
+            << "% edge i -> i+1 has weight i - 0.5\n"
+            << n+1 << " " << n+1 << " " << n << "\n";
+        for (int64_t i = 1; i <= n; i++) out << i << " " << i+1 << " " << i - 0.5 << "\n";
+      }
+      auto tm = TupleGraph::Load(path, "mm");
+      BOOST_CHECK_EQUAL(tm.nedge, n);
+      forall(tm.edges, tm.nedge, [](TupleGraph::Edge& e){
+        double w;
+        memcpy(&w, &e.data, sizeof(w));
+        CHECK_EQ(e.v1, e.v0 + 1);
+        CHECK_EQ(w, e.v0 - 0.5);
+      });
+      tm.destroy();
+      unlink(path.c_str());
+    }
+    
     LOG(INFO) << degree;
     Metrics::merge_and_dump_to_file();
     
@@ -27,11 +27,16 @@
 #include "ParallelLoop.hpp"
 #include "FileIO.hpp"
 #include "Delegate.hpp"
+#include "IOEngine.hpp"
+#include "TextParse.hpp"
 
 #include <fstream>
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <vector>
 
 DEFINE_bool( use_mpi_io, false, "Use MPI IO optimizations" );
+DEFINE_bool( tsv_fast_parse, true, "Parse TSV edge lists in large chunks with the integer scanner in TextParse.hpp, rather than with istreams" );
 
 /// for now, limit path lengths to this
 const size_t max_path_length = 1024;
@@ -89,8 +94,9 @@ void local_load_bintsv4( const char * filename,
   size_t local_count = local_end - local_ptr;
   
   if( !FLAGS_use_mpi_io ) {
-    // use standard C++/POSIX IO
-    std::ifstream infile( filename, std::ios_base::in | std::ios_base::binary );
+    // use POSIX IO, through the io_uring engine if it's enabled
+    int fd = impl::io_open( filename, O_RDONLY );
+    CHECK( fd != -1 ) << "Error opening file for read only: " << filename;
 
     // TODO: fix this with scan
     local_offset = 0; // do on all cores
@@ -99,9 +105,9 @@ void local_load_bintsv4( const char * filename,
                                               local_count );
     Grappa::barrier();
 
-    infile.seekg( offset * sizeof(Int32Edge) );
-
-    infile.read( (char*) local_ptr, local_count * sizeof(Int32Edge) );
+    ssize_t nread = impl::io_read( fd, local_ptr, local_count * sizeof(Int32Edge), offset * sizeof(Int32Edge) );
+    CHECK_EQ( nread, (ssize_t)(local_count * sizeof(Int32Edge)) ) << "Error reading " << filename;
+    close( fd );
   } else {
     // load int32's into local chunk
     impl::read_unordered_shared( filename, local_ptr, local_count * sizeof(Int32Edge) );
@@ -139,6 +145,16 @@ TupleGraph TupleGraph::load_tsv( std::string path ) {
 
   // read into temporary buffer
   on_all_cores( [=] {
+      if( FLAGS_tsv_fast_parse ) {
+        // each core scans the lines starting in its share of the file
+        Grappa::parse_int_lines_local<2>( filename, [] ( const int64_t * v, int n ) {
+            if( n == 2 ) read_edges.push_back( Edge{ v[0], v[1], 0 } );
+          }, FLAGS_io_blocksize_mb << 20 );
+        local_offset = read_edges.size();
+        DVLOG(7) << "Read " << local_offset << " edges";
+        return;
+      }
+      
       // use standard C++/POSIX IO
 
       // make one core take any data remaining after truncation
@@ -676,6 +692,59 @@ void local_save_tsv( const char * filename,
 
 
 
+GlobalAddress<MappedTupleGraph> MappedTupleGraph::Map( std::string path ) {
+  CHECK( fs::exists( path ) ) << "File not found.";
+  CHECK( fs::is_regular_file( path ) ) << "File is not a regular file.";
+  
+  int64_t nedge = fs::file_size( path ) / sizeof(Edge);
+  
+  size_t path_length = path.size() + 1; // include space for terminator
+  CHECK_LT( path_length, max_path_length )
+    << "Sorry, filename exceeds preset limit. Please change max_path_length constant in this file and rerun.";
+  char filename[ max_path_length ];
+  strncpy( &filename[0], path.c_str(), max_path_length );
+  
+  auto self = symmetric_global_alloc<MappedTupleGraph>();
+  on_all_cores( [=] {
+      auto tg = self.localize();
+      tg->self = self;
+      tg->nedge = nedge;
+      
+      range_t r = blockDist( 0, nedge, Grappa::mycore(), Grappa::cores() );
+      tg->local_nedge = r.end - r.start;
+      tg->local = nullptr;
+      tg->map_base = nullptr;
+      tg->map_bytes = 0;
+      if( tg->local_nedge == 0 ) return;
+      
+      // mappings must start on a page boundary
+      size_t page = sysconf( _SC_PAGESIZE );
+      size_t start = r.start * sizeof(Edge);
+      size_t map_start = start / page * page;
+      tg->map_bytes = r.end * sizeof(Edge) - map_start;
+      
+      int fd = open( filename, O_RDONLY );
+      CHECK( fd != -1 ) << "Error opening file for read only: " << filename;
+      tg->map_base = mmap( nullptr, tg->map_bytes, PROT_READ, MAP_SHARED, fd, map_start );
+      PCHECK( tg->map_base != MAP_FAILED ) << "Error mapping " << filename;
+      close( fd );
+      madvise( tg->map_base, tg->map_bytes, MADV_SEQUENTIAL );
+      
+      tg->local = reinterpret_cast< const Edge * >( static_cast< char * >( tg->map_base ) + (start - map_start) );
+    } );
+  return self;
+}
+
+void MappedTupleGraph::destroy() {
+  auto self = this->self;
+  call_on_all_cores( [self] {
+      if( self->map_base ) munmap( self->map_base, self->map_bytes );
+      self->map_base = nullptr;
+    } );
+  global_free( self );
+}
+
+
 /// TupleGraph constructor that loads from a file, dispatching on file format
 TupleGraph TupleGraph::Load( std::string path, std::string format ) {
   if( format == "bintsv4" ) {
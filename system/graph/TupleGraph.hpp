@@ -25,6 +25,9 @@
 
 #include <Addressing.hpp>
 #include <GlobalAllocator.hpp>
+#include <ParallelLoop.hpp>
+
+DECLARE_bool( tsv_fast_parse );
 
 namespace Grappa {
 
@@ -83,4 +86,45 @@ namespace Grappa {
     
   };
 
+  /// Edges of a bintsv4 file (pairs of int32 vertex ids), memory-mapped
+  /// rather than loaded: each core maps its own block of the file and reads
+  /// the edges in place, so there is no 64-bit copy in the global heap. Pass
+  /// to Graph::create in place of a TupleGraph.
+  ///
+  /// @code
+  ///   auto tg = MappedTupleGraph::Map("twitter.bintsv4");
+  ///   auto g = G::create(tg);
+  ///   tg->destroy();
+  /// @endcode
+  class MappedTupleGraph {
+  public:
+    struct Edge { int32_t v0, v1; };
+    
+    GlobalAddress<MappedTupleGraph> self;
+    int64_t nedge;          ///< total edges in the file
+    const Edge * local;     ///< this core's edges (inside the mapping)
+    int64_t local_nedge;
+    
+  private:
+    void * map_base;
+    size_t map_bytes;
+    
+  public:
+    /// Map `path` on all cores. Call from one task, like TupleGraph::Load.
+    static GlobalAddress<MappedTupleGraph> Map( std::string path );
+    
+    /// Unmap on all cores and free the symmetric object.
+    void destroy();
+    
+    /// Call `f(v0, v1)` on every edge, in parallel on the core that mapped it.
+    /// Blocks until done, including async delegates f issues on the default GCE.
+    template< typename F >
+    void forall_edges( F f ) {
+      auto self = this->self;
+      impl::forall_local([self]{ return self->local_nedge; }, [self,f](int64_t s, int64_t n){
+        for (int64_t i = s; i < s+n; i++) f(self->local[i].v0, self->local[i].v1);
+      });
+    }
+  } GRAPPA_BLOCK_ALIGNED;
+
 }
@@ -25,6 +25,7 @@
 
 #include <gflags/gflags.h>
 #include "../PerformanceTools.hpp"
+#include "../LocaleSharedMemory.hpp"
 
 /// TODO: this should be based on some actual time-related metric so behavior is predictable across machines
 DEFINE_int64( periodic_poll_ticks, 20000, "number of ticks to wait before polling periodic queue");
@@ -200,7 +201,9 @@ void TaskingScheduler::createWorkers( uint64_t num ) {
 /// based on some heuristics.
 Worker * TaskingScheduler::maybeSpawnCoroutines( ) {
   // currently only spawn a worker if there are less than some threshold
-  if ( num_workers < BASIC_MAX_WORKERS ) {
+  // (and stack memory is within its budget)
+  if ( num_workers < BASIC_MAX_WORKERS &&
+       !impl::locale_shared_memory.over_budget( impl::MemoryCategory::Stacks ) ) {
     num_workers += 1;
     VLOG(5) << "spawning another worker; now there are " << num_workers;
     return impl::worker_spawn( current_thread, this, workerLoop, work_args ); // current Worker will be coro parent; is this okay?